@@ -8,6 +8,13 @@ PLANS_DIRECTORY="../plans"
 DATA_DIRECTORY="../data/"
 EXECUTABLE="./query_processor"
 
+# --- Batch Mode ---
+# "./run_all_queries.sh --batch [threads]" runs every plan in a single process instead,
+# so the catalog is loaded and each CSV is parsed only once for the whole run.
+if [ "$1" == "--batch" ]; then
+  exec "$EXECUTABLE" --batch "$PLANS_DIRECTORY" "$DATA_DIRECTORY" --threads "${2:-1}"
+fi
+
 # --- Script Body ---
 # Check for dependencies
 if [ ! -d "$PLANS_DIRECTORY" ]; then
@@ -0,0 +1,487 @@
+#pragma once
+
+#include "operator.h"
+#include "hash_table.h" // hashTuple
+#include "serialize.h"
+#include "sketches.h"
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <unistd.h>
+
+/*
+    Hash aggregation (GROUP BY) under a memory budget. A plan node such as
+
+        { "op": "Aggregate", "group_by": ["o.customer_id"],
+          "aggregates": [ { "fn": "count", "as": "orders" },
+                          { "fn": "sum", "expr": { "col": "o.total" }, "as": "spent" } ],
+          "memory_mb": 64, "input": { ... } }
+
+    returns one row per distinct group key: the group_by columns followed by the
+    aggregates. Supported functions are count (without "expr" it counts rows, with one it
+    counts non-NULL values), sum, min, max and avg. NULL inputs are ignored, an aggregate
+    over no values is NULL (count is 0), and NULL group keys form one group.
+
+    There are also two approximate aggregates with a fixed-size state per group (see
+    sketches.h): approx_count_distinct (HyperLogLog) and approx_quantile with a "q" between
+    0 and 1, e.g. { "fn": "approx_quantile", "expr": ..., "q": 0.99, "as": "p99" } (t-digest).
+
+    Groups are kept in an open-addressing table. When its estimated size goes over the
+    budget, every group's partial state is written to one of kFanout spill files chosen by
+    the next 4 bits of the group hash, and the table starts over empty. Once the input is
+    consumed, each spill file is aggregated on its own, in the same way: if a partition still
+    does not fit it is split again by the following hash bits. Partitions are processed one
+    at a time while the results are read, so memory stays bounded by the budget.
+*/
+
+enum class AggFn { COUNT_STAR, COUNT, SUM, MIN, MAX, AVG, APPROX_COUNT_DISTINCT, APPROX_QUANTILE };
+
+struct AggregateSpec {
+    AggFn fn;
+    std::unique_ptr<Expression> expr; // Null for count(*)
+    std::string alias;
+    DataType inputType = DataType::FLOAT; // Best guess at the type of expr's values
+    double quantile = 0.5;                // approx_quantile only
+};
+
+// Partial result of one aggregate for one group. States of the same aggregate can be
+// merged, which is what lets a group be aggregated in pieces (before and after a spill).
+struct AggState {
+    int64_t count = 0; // Values seen (rows for count(*))
+    int64_t intSum = 0;
+    double floatSum = 0.0;
+    Value min = nullValue();
+    Value max = nullValue();
+    std::unique_ptr<HyperLogLog> distinct; // approx_count_distinct, created on first value
+    std::unique_ptr<TDigest> digest;       // approx_quantile, created on first value
+
+    // Memory an aggregate's state may take beyond sizeof(AggState); fixed per function.
+    static size_t sketchBytes(AggFn fn) {
+        if (fn == AggFn::APPROX_COUNT_DISTINCT) return HyperLogLog::memoryBytes();
+        if (fn == AggFn::APPROX_QUANTILE) return TDigest::memoryBytes();
+        return 0;
+    }
+
+    void update(AggFn fn, const Value& val) {
+        if (fn == AggFn::COUNT_STAR) {
+            count++;
+            return;
+        }
+        if (isNull(val)) return; // Aggregates skip NULLs
+        count++;
+        switch (fn) {
+            case AggFn::SUM:
+            case AggFn::AVG:
+                if (auto* i = std::get_if<int>(&val)) intSum += *i;
+                else if (is_numeric(val)) floatSum += to_double(val);
+                else throw std::runtime_error("sum/avg of a non-numeric value.");
+                break;
+            case AggFn::MIN:
+                if (isNull(min) || val < min) min = val;
+                break;
+            case AggFn::MAX:
+                if (isNull(max) || max < val) max = val;
+                break;
+            case AggFn::APPROX_COUNT_DISTINCT:
+                if (!distinct) distinct = std::make_unique<HyperLogLog>();
+                distinct->add(val);
+                break;
+            case AggFn::APPROX_QUANTILE:
+                if (!is_numeric(val)) throw std::runtime_error("approx_quantile of a non-numeric value.");
+                if (!digest) digest = std::make_unique<TDigest>();
+                digest->add(to_double(val));
+                break;
+            default:
+                break;
+        }
+    }
+
+    void merge(const AggState& other) {
+        count += other.count;
+        intSum += other.intSum;
+        floatSum += other.floatSum;
+        if (!isNull(other.min) && (isNull(min) || other.min < min)) min = other.min;
+        if (!isNull(other.max) && (isNull(max) || max < other.max)) max = other.max;
+        if (other.distinct) {
+            if (!distinct) distinct = std::make_unique<HyperLogLog>();
+            distinct->merge(*other.distinct);
+        }
+        if (other.digest) {
+            if (!digest) digest = std::make_unique<TDigest>();
+            digest->merge(*other.digest);
+        }
+    }
+
+    Value result(const AggregateSpec& spec) {
+        switch (spec.fn) {
+            case AggFn::COUNT_STAR:
+            case AggFn::COUNT:
+                return static_cast<int>(count);
+            case AggFn::SUM:
+                if (count == 0) return nullValue();
+                if (spec.inputType == DataType::INT) {
+                    if (intSum > std::numeric_limits<int>::max() || intSum < std::numeric_limits<int>::min()) {
+                        throw std::runtime_error("sum of '" + spec.alias + "' overflows INT.");
+                    }
+                    return static_cast<int>(intSum);
+                }
+                return static_cast<float>(floatSum + static_cast<double>(intSum));
+            case AggFn::AVG:
+                if (count == 0) return nullValue();
+                return static_cast<float>((floatSum + static_cast<double>(intSum)) / static_cast<double>(count));
+            case AggFn::MIN:
+                return min;
+            case AggFn::MAX:
+                return max;
+            case AggFn::APPROX_COUNT_DISTINCT:
+                return distinct ? static_cast<int>(std::min<uint64_t>(distinct->estimate(), std::numeric_limits<int>::max())) : 0;
+            case AggFn::APPROX_QUANTILE:
+                if (!digest || digest->empty()) return nullValue();
+                return static_cast<float>(digest->quantile(spec.quantile));
+        }
+        return nullValue();
+    }
+
+    void write(BinaryWriter& out) const {
+        out.writeU64(static_cast<uint64_t>(count));
+        out.writeU64(static_cast<uint64_t>(intSum));
+        out.writeF64(floatSum);
+        out.writeValue(min);
+        out.writeValue(max);
+        out.writeU8((distinct ? 1 : 0) | (digest ? 2 : 0));
+        if (distinct) distinct->write(out);
+        if (digest) digest->write(out);
+    }
+
+    void read(BinaryReader& in) {
+        count = static_cast<int64_t>(in.readU64());
+        intSum = static_cast<int64_t>(in.readU64());
+        floatSum = in.readF64();
+        min = in.readValue();
+        max = in.readValue();
+        uint8_t sketches = in.readU8();
+        distinct.reset(sketches & 1 ? new HyperLogLog() : nullptr);
+        if (distinct) distinct->read(in);
+        digest.reset(sketches & 2 ? new TDigest() : nullptr);
+        if (digest) digest->read(in);
+    }
+};
+
+// The in-memory groups: open addressing over an array of group indexes, with a running
+// estimate of the memory they use.
+class GroupTable {
+public:
+    struct Group {
+        Tuple key;
+        uint64_t hash;
+        std::vector<AggState> states;
+    };
+
+    // sketchBytes is the fixed extra memory of one group's approximate aggregate states.
+    GroupTable(size_t aggregateCount, size_t sketchBytes)
+        : aggregateCount_(aggregateCount), sketchBytes_(sketchBytes) { clear(); }
+
+    Group& findOrInsert(Tuple&& key, uint64_t hash) {
+        size_t s = hash & mask_;
+        while (slots_[s] != 0) {
+            Group& g = groups_[slots_[s] - 1];
+            if (g.hash == hash && g.key == key) return g;
+            s = (s + 1) & mask_;
+        }
+        bytes_ += groupBytes(key);
+        groups_.push_back({std::move(key), hash, std::vector<AggState>(aggregateCount_)});
+        slots_[s] = static_cast<uint32_t>(groups_.size());
+        if (groups_.size() * 2 > slots_.size()) grow();
+        return groups_.back();
+    }
+
+    std::vector<Group>& groups() { return groups_; }
+    size_t size() const { return groups_.size(); }
+    size_t memoryBytes() const { return bytes_ + groups_.capacity() * sizeof(Group) + slots_.size() * sizeof(uint32_t); }
+
+    void clear() {
+        groups_.clear();
+        slots_.assign(1024, 0);
+        mask_ = slots_.size() - 1;
+        bytes_ = 0;
+    }
+
+private:
+    size_t groupBytes(const Tuple& key) const {
+        size_t bytes = key.size() * sizeof(Value) + aggregateCount_ * sizeof(AggState) + sketchBytes_;
+        for (const auto& val : key) {
+            if (auto* s = std::get_if<std::string>(&val)) bytes += s->size() > 15 ? s->capacity() : 0;
+        }
+        return bytes;
+    }
+
+    void grow() {
+        slots_.assign(slots_.size() * 2, 0);
+        mask_ = slots_.size() - 1;
+        for (size_t i = 0; i < groups_.size(); ++i) {
+            size_t s = groups_[i].hash & mask_;
+            while (slots_[s] != 0) s = (s + 1) & mask_;
+            slots_[s] = static_cast<uint32_t>(i + 1);
+        }
+    }
+
+    size_t aggregateCount_;
+    size_t sketchBytes_;
+    std::vector<Group> groups_;
+    std::vector<uint32_t> slots_; // Group index + 1, 0 when empty
+    size_t mask_ = 0;
+    size_t bytes_ = 0;
+};
+
+class HashAggregateOperator : public Operator {
+public:
+    static constexpr size_t kDefaultMemoryBudget = size_t(256) << 20;
+    static constexpr size_t kFanout = 16;      // Spill partitions per level (4 hash bits)
+    static constexpr int kMaxSpillLevel = 15;  // 60 of the 64 hash bits
+
+    HashAggregateOperator(std::unique_ptr<Operator> input, std::vector<std::string> groupBy,
+                          std::vector<AggregateSpec> aggregates, size_t memoryBudget = kDefaultMemoryBudget)
+        : input_(std::move(input)), groupBy_(std::move(groupBy)), aggregates_(std::move(aggregates)),
+          memoryBudget_(memoryBudget), table_(aggregates_.size(), sketchBytes(aggregates_)) {
+        const Schema& inputSchema = input_->getSchema();
+        for (const auto& name : groupBy_) {
+            const ColumnInfo& col = inputSchema.getColumn(name);
+            groupColumns_.push_back(col.index);
+            outputSchema_.addColumn(col.name, col.type);
+        }
+        for (auto& agg : aggregates_) {
+            if (auto* col = dynamic_cast<const ColumnRefExpression*>(agg.expr.get())) {
+                agg.inputType = inputSchema.getColumn(col->getColumnName()).type;
+            }
+            outputSchema_.addColumn(agg.alias, outputType(agg));
+        }
+    }
+
+    ~HashAggregateOperator() override { removeSpillFiles(); }
+
+    void open() override {
+        beginInput();
+        input_->open();
+        Tuple tuple;
+        while (input_->next(tuple)) addRow(tuple);
+        input_->close();
+        finishInput();
+    }
+
+    // The input side of open(), split up so that the push engine (pipeline.h) can feed
+    // rows itself: beginInput(), addRow() for every input row, then finishInput(). The
+    // results are then read with next() as usual.
+    void beginInput() {
+        removeSpillFiles();
+        table_.clear();
+        pending_.clear();
+        inputPartitions_.clear();
+        spillCount_ = 0;
+        resultPos_ = 0;
+    }
+
+    void addRow(const Tuple& tuple) {
+        Tuple key;
+        key.reserve(groupColumns_.size());
+        for (size_t col : groupColumns_) key.push_back(tuple[col]);
+        uint64_t hash = hashTuple(key);
+        auto& group = table_.findOrInsert(std::move(key), hash);
+        for (size_t a = 0; a < aggregates_.size(); ++a) {
+            const auto& agg = aggregates_[a];
+            group.states[a].update(agg.fn, agg.expr ? agg.expr->evaluate(tuple, input_->getSchema()) : Value());
+        }
+        if (table_.memoryBytes() > memoryBudget_) spill(inputPartitions_, 0);
+    }
+
+    void finishInput() {
+        // If anything went to disk, the rest goes too and every partition is finished
+        // separately, one at a time, as the results are read.
+        if (!inputPartitions_.empty()) {
+            spill(inputPartitions_, 0);
+            queuePartitions(inputPartitions_, 1);
+            inputPartitions_.clear();
+        }
+    }
+
+    bool next(Tuple& tuple) override {
+        while (resultPos_ >= table_.size()) {
+            if (pending_.empty()) return false;
+            PendingPartition part = std::move(pending_.back());
+            pending_.pop_back();
+            aggregatePartition(part);
+        }
+        auto& group = table_.groups()[resultPos_++];
+        tuple = std::move(group.key);
+        for (size_t a = 0; a < aggregates_.size(); ++a) tuple.push_back(group.states[a].result(aggregates_[a]));
+        return true;
+    }
+
+    void close() override {
+        table_.clear();
+        removeSpillFiles();
+    }
+
+    const Schema& getSchema() const override { return outputSchema_; }
+    Operator* getInput() const { return input_.get(); }
+
+private:
+    // Buffered writer for one spill partition. Each record is a 4 byte length followed by
+    // the group key and its aggregate states.
+    struct SpillFile {
+        std::string path;
+        std::ofstream out;
+        std::string buffer;
+        size_t groups = 0;
+
+        void flush() {
+            out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            buffer.clear();
+        }
+    };
+
+    struct PendingPartition {
+        std::string path;
+        int level; // Hash bits used to split this partition further
+    };
+
+    static DataType outputType(const AggregateSpec& agg) {
+        switch (agg.fn) {
+            case AggFn::COUNT_STAR:
+            case AggFn::COUNT: return DataType::INT;
+            case AggFn::AVG:   return DataType::FLOAT;
+            case AggFn::SUM:   return agg.inputType == DataType::INT ? DataType::INT : DataType::FLOAT;
+            case AggFn::MIN:
+            case AggFn::MAX:   return agg.inputType;
+            case AggFn::APPROX_COUNT_DISTINCT: return DataType::INT;
+            case AggFn::APPROX_QUANTILE:       return DataType::FLOAT;
+        }
+        return DataType::FLOAT;
+    }
+
+    static size_t sketchBytes(const std::vector<AggregateSpec>& aggregates) {
+        size_t bytes = 0;
+        for (const auto& agg : aggregates) bytes += AggState::sketchBytes(agg.fn);
+        return bytes;
+    }
+
+    static size_t partitionOf(uint64_t hash, int level) {
+        return (hash >> (60 - 4 * level)) & (kFanout - 1);
+    }
+
+    // Writes every in-memory group to the spill partitions of the given level and empties
+    // the table.
+    void spill(std::vector<SpillFile>& partitions, int level) {
+        if (partitions.empty()) {
+            if (spillCount_ == 0) {
+                std::cout << "[Aggregate] " << table_.size() << " groups exceed the memory budget of "
+                          << memoryBudget_ / 1048576.0 << " MB; spilling partial groups to disk." << std::endl;
+            }
+            partitions.resize(kFanout);
+            for (auto& part : partitions) {
+                part.path = newSpillPath();
+                part.out.open(part.path, std::ios::binary | std::ios::trunc);
+                if (!part.out) throw std::runtime_error("Could not create spill file " + part.path);
+            }
+        }
+        std::string record;
+        for (auto& group : table_.groups()) {
+            SpillFile& part = partitions[partitionOf(group.hash, level)];
+            record.clear();
+            BinaryWriter writer(record);
+            writer.writeTuple(group.key);
+            for (const auto& state : group.states) state.write(writer);
+            BinaryWriter(part.buffer).writeU32(static_cast<uint32_t>(record.size()));
+            part.buffer += record;
+            part.groups++;
+            if (part.buffer.size() >= kSpillBufferBytes) part.flush();
+        }
+        table_.clear();
+    }
+
+    // Closes the spill files of one level and queues them, first partition on top.
+    void queuePartitions(std::vector<SpillFile>& partitions, int nextLevel) {
+        for (auto& part : partitions) {
+            part.flush();
+            part.out.close();
+            if (!part.out) throw std::runtime_error("Could not write spill file " + part.path);
+        }
+        for (size_t p = partitions.size(); p-- > 0;) {
+            if (partitions[p].groups == 0) {
+                std::filesystem::remove(partitions[p].path);
+                continue;
+            }
+            pending_.push_back({partitions[p].path, nextLevel});
+        }
+    }
+
+    // Merges the partial states of one spilled partition into the (empty) table. A
+    // partition that still does not fit is split by the next 4 hash bits.
+    void aggregatePartition(const PendingPartition& part) {
+        table_.clear();
+        resultPos_ = 0;
+        std::ifstream in(part.path, std::ios::binary);
+        if (!in) throw std::runtime_error("Could not open spill file " + part.path);
+        std::vector<SpillFile> partitions;
+        std::string record;
+        uint32_t length;
+        while (in.read(reinterpret_cast<char*>(&length), sizeof(length))) {
+            record.resize(length);
+            if (!in.read(&record[0], length)) throw std::runtime_error("Truncated spill file " + part.path);
+            BinaryReader reader(record);
+            Tuple key;
+            reader.readTuple(key);
+            uint64_t hash = hashTuple(key);
+            auto& group = table_.findOrInsert(std::move(key), hash);
+            AggState state;
+            for (auto& groupState : group.states) {
+                state.read(reader);
+                groupState.merge(state);
+            }
+            if (table_.memoryBytes() > memoryBudget_ && part.level <= kMaxSpillLevel) spill(partitions, part.level);
+        }
+        in.close();
+        std::filesystem::remove(part.path);
+        if (!partitions.empty()) {
+            spill(partitions, part.level);
+            queuePartitions(partitions, part.level + 1);
+        }
+    }
+
+    std::string newSpillPath() {
+        static std::atomic<uint64_t> operatorSeq{0};
+        if (spillPrefix_.empty()) {
+            spillPrefix_ = (std::filesystem::temp_directory_path() /
+                            ("qp_agg_" + std::to_string(::getpid()) + "_" + std::to_string(operatorSeq++) + "_")).string();
+        }
+        std::string path = spillPrefix_ + std::to_string(spillCount_++) + ".spill";
+        spillPaths_.push_back(path);
+        return path;
+    }
+
+    void removeSpillFiles() {
+        std::error_code ec;
+        for (const auto& path : spillPaths_) std::filesystem::remove(path, ec);
+        spillPaths_.clear();
+        pending_.clear();
+    }
+
+    static constexpr size_t kSpillBufferBytes = size_t(1) << 20;
+
+    std::unique_ptr<Operator> input_;
+    std::vector<std::string> groupBy_;
+    std::vector<size_t> groupColumns_;
+    std::vector<AggregateSpec> aggregates_;
+    size_t memoryBudget_;
+    Schema outputSchema_;
+
+    GroupTable table_;
+    size_t resultPos_ = 0; // Next group of table_ to return
+    std::vector<SpillFile> inputPartitions_; // First-level spill files while reading the input
+
+    // Spilled partitions still to aggregate (processed from the back).
+    std::vector<PendingPartition> pending_;
+    std::string spillPrefix_;
+    size_t spillCount_ = 0;
+    std::vector<std::string> spillPaths_;
+};
@@ -0,0 +1,612 @@
+#pragma once
+
+#if !defined(__cpp_impl_coroutine) || !__has_include(<coroutine>)
+#error "async_exec.h needs C++20 coroutines; it is only built into the query_processor_async target."
+#endif
+
+#include "executor.h"
+#include "thread_pool.h"
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <fcntl.h>
+#include <mutex>
+#include <optional>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+/*
+    Async execution: operators as C++20 coroutines. A Volcano operator that needs file data
+    blocks inside next() until the read returns, and with it the thread running the query.
+    Here every operator's open()/next()/close() is a coroutine instead. A scan issues its
+    reads to a separate I/O pool and suspends until they complete; the completion puts the
+    scan (and with it the chain of operators waiting on it) back on the scheduler's run
+    queue. The scheduler is a small pool of threads that only ever resume ready coroutines,
+    so many queries can be in flight on a few threads, each one computing while the others
+    wait on their reads.
+
+    next() works on batches of up to kPushBatchSize rows, so suspending and resuming costs
+    once per batch rather than once per row. Plans are parsed and planned as usual and the
+    operator tree is then translated:
+
+        Scan of a plain CSV file  -> AsyncScanOperator (reads ahead kAsyncReadDepth blocks)
+        Select                    -> AsyncFilterOperator
+        Project                   -> AsyncProjectOperator (a fused pipeline is unfused again)
+        Limit                     -> AsyncLimitOperator (stops reading once it has enough)
+
+    Anything else (joins, aggregates, sorts, cached or compressed tables...) runs through
+    AsyncAdapterOperator, which pulls the ordinary operator on the scheduler thread, blocking
+    reads included.
+
+    Coroutines need C++20 while the rest of the project is C++17, so this header is only
+    compiled into the separate query_processor_async executable (see CMakeLists.txt).
+*/
+
+template <typename T>
+class AsyncTask;
+
+namespace async_detail {
+
+// Resumes whoever co_awaited the finished task, or nothing for a detached one.
+struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) const noexcept {
+        auto continuation = handle.promise().continuation;
+        return continuation ? continuation : std::noop_coroutine();
+    }
+    void await_resume() const noexcept {}
+};
+
+struct PromiseBase {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr error;
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception() { error = std::current_exception(); }
+    void rethrowIfFailed() const {
+        if (error) std::rethrow_exception(error);
+    }
+};
+
+template <typename T>
+struct Promise : PromiseBase {
+    std::optional<T> value;
+
+    AsyncTask<T> get_return_object();
+    void return_value(T v) { value = std::move(v); }
+    T result() {
+        rethrowIfFailed();
+        return std::move(*value);
+    }
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+    AsyncTask<void> get_return_object();
+    void return_void() {}
+    void result() const { rethrowIfFailed(); }
+};
+
+} // namespace async_detail
+
+// A lazily started coroutine returning a T. It runs when it is co_awaited, on the thread of
+// the awaiting coroutine, and resumes that coroutine directly when it finishes; an
+// exception thrown inside it is rethrown from the co_await.
+template <typename T>
+class [[nodiscard]] AsyncTask {
+public:
+    using promise_type = async_detail::Promise<T>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    explicit AsyncTask(Handle handle) : handle_(handle) {}
+    AsyncTask(AsyncTask&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+    AsyncTask(const AsyncTask&) = delete;
+    AsyncTask& operator=(const AsyncTask&) = delete;
+    ~AsyncTask() {
+        if (handle_) handle_.destroy();
+    }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle_.promise().continuation = awaiting;
+        return handle_;
+    }
+    T await_resume() { return handle_.promise().result(); }
+
+private:
+    Handle handle_;
+};
+
+namespace async_detail {
+
+template <typename T>
+AsyncTask<T> Promise<T>::get_return_object() {
+    return AsyncTask<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline AsyncTask<void> Promise<void>::get_return_object() {
+    return AsyncTask<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+// The root of a spawned task: started by the scheduler, and destroys itself at the end.
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask get_return_object() { return {std::coroutine_handle<promise_type>::from_promise(*this)}; }
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        std::suspend_never final_suspend() const noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); } // Spawned tasks catch their own errors
+    };
+    std::coroutine_handle<promise_type> handle;
+};
+
+inline DetachedTask runDetached(AsyncTask<void> task) { co_await std::move(task); }
+
+} // namespace async_detail
+
+// The run queue: a few threads resuming coroutines that are ready to continue, and a
+// separate pool for the blocking reads they wait on.
+class AsyncScheduler {
+public:
+    AsyncScheduler(size_t threads, size_t ioThreads) : io_(ioThreads) {
+        if (threads == 0) threads = 1;
+        for (size_t i = 0; i < threads; ++i) workers_.emplace_back([this] { workerLoop(); });
+    }
+
+    ~AsyncScheduler() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        ready_.notify_all();
+        for (auto& worker : workers_) worker.join();
+    }
+
+    AsyncScheduler(const AsyncScheduler&) = delete;
+    AsyncScheduler& operator=(const AsyncScheduler&) = delete;
+
+    // Queues a suspended coroutine to be resumed on one of the scheduler threads.
+    void post(std::coroutine_handle<> handle) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(handle);
+        }
+        ready_.notify_one();
+    }
+
+    // Starts a task on the scheduler without waiting for it. The task must not throw.
+    void spawn(AsyncTask<void> task) { post(async_detail::runDetached(std::move(task)).handle); }
+
+    void submitIo(std::function<void()> job) { io_.submit(std::move(job)); }
+
+    size_t threads() const { return workers_.size(); }
+    size_t ioThreads() const { return io_.size(); }
+
+private:
+    void workerLoop() {
+        while (true) {
+            std::coroutine_handle<> handle;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                ready_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+                if (queue_.empty()) return; // Stopping and nothing left to resume.
+                handle = queue_.front();
+                queue_.pop_front();
+            }
+            handle.resume();
+        }
+    }
+
+    ThreadPool io_;
+    std::vector<std::thread> workers_;
+    std::deque<std::coroutine_handle<>> queue_;
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    bool stopping_ = false;
+};
+
+// One pread() on the I/O pool that a coroutine can co_await. Awaiting a read that has
+// already completed does not suspend at all. The buffer is kept across reads.
+class AsyncRead {
+public:
+    AsyncRead() : state_(std::make_shared<State>()) {}
+
+    ~AsyncRead() {
+        // Only reached with a read in flight when a query is torn down without close();
+        // the read still writes into the buffer, so wait for it.
+        if (started_) state_->phase.wait(kPending);
+    }
+
+    AsyncRead(const AsyncRead&) = delete;
+    AsyncRead& operator=(const AsyncRead&) = delete;
+
+    void start(AsyncScheduler& scheduler, int fd, uint64_t offset, size_t length) {
+        if (state_->capacity < length) {
+            state_->buffer.reset(new char[length]);
+            state_->capacity = length;
+        }
+        state_->phase.store(kPending);
+        state_->waiter = nullptr;
+        started_ = true;
+        scheduler.submitIo([state = state_, &scheduler, fd, offset, length] {
+            size_t got = 0;
+            while (got < length) {
+                ssize_t n = pread(fd, state->buffer.get() + got, length - got, static_cast<off_t>(offset + got));
+                if (n < 0 && errno == EINTR) continue;
+                if (n < 0) {
+                    state->error = errno;
+                    break;
+                }
+                if (n == 0) break;
+                got += static_cast<size_t>(n);
+            }
+            state->size = got;
+            if (state->phase.exchange(kDone) == kWaiting) scheduler.post(state->waiter);
+            state->phase.notify_all();
+        });
+    }
+
+    bool inFlight() const { return started_; }
+
+    bool await_ready() const noexcept { return state_->phase.load() == kDone; }
+    // Suspends unless the read completes between await_ready() and here.
+    bool await_suspend(std::coroutine_handle<> handle) noexcept {
+        state_->waiter = handle;
+        int expected = kPending;
+        return state_->phase.compare_exchange_strong(expected, kWaiting);
+    }
+    void await_resume() noexcept { started_ = false; }
+
+    // The bytes read, after the co_await. Throws if the read failed.
+    size_t result(const std::string& path) const {
+        if (state_->error != 0) throw std::runtime_error("Read error in " + path + ": " + std::strerror(state_->error));
+        return state_->size;
+    }
+    const char* data() const { return state_->buffer.get(); }
+
+private:
+    static constexpr int kPending = 0; // Submitted, nobody waiting yet
+    static constexpr int kWaiting = 1; // A coroutine is suspended on it
+    static constexpr int kDone = 2;
+
+    // Shared with the I/O job, which may still be finishing up after the waiter resumed.
+    struct State {
+        std::unique_ptr<char[]> buffer;
+        size_t capacity = 0;
+        size_t size = 0;
+        int error = 0;
+        std::atomic<int> phase{kDone};
+        std::coroutine_handle<> waiter;
+    };
+
+    std::shared_ptr<State> state_;
+    bool started_ = false;
+};
+
+// The coroutine counterpart of Operator. next() replaces the batch with up to
+// kPushBatchSize rows and returns false, with nothing in the batch, at the end.
+class AsyncOperator {
+public:
+    virtual ~AsyncOperator() = default;
+    virtual AsyncTask<void> open() = 0;
+    virtual AsyncTask<bool> next(TupleBatch& batch) = 0;
+    virtual AsyncTask<void> close() = 0;
+    virtual const Schema& getSchema() const = 0;
+    virtual std::string describe() const = 0;
+};
+
+constexpr size_t kAsyncReadBytes = size_t(1) << 20;
+constexpr size_t kAsyncReadDepth = 2; // Reads kept in flight per scan
+
+// Reads a plain CSV file in kAsyncReadBytes blocks, keeping the next reads in flight while
+// it parses the current one. Lines are split the way LineReader splits them, so a record
+// with newlines inside quotes is parsed whole.
+class AsyncScanOperator : public AsyncOperator {
+public:
+    AsyncScanOperator(const ScanOperator& scan, AsyncScheduler& scheduler)
+        : scan_(scan), path_(scan.getTablePath()), scheduler_(scheduler) {}
+
+    AsyncTask<void> open() override {
+        fd_ = ::open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0) throw std::runtime_error("Cannot open data file: " + path_);
+        struct stat st;
+        if (fstat(fd_, &st) != 0) throw std::runtime_error("Cannot stat data file: " + path_);
+        fileSize_ = static_cast<uint64_t>(st.st_size);
+        posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+        nextOffset_ = 0;
+        current_ = 0;
+        data_ = nullptr;
+        pos_ = size_ = 0;
+        line_.clear();
+        lineComplete_ = true;
+        recordLines_ = 0;
+        headerSkipped_ = false;
+        for (auto& read : reads_) issue(read);
+        std::cout << "[Async] Scan(" << scan_.getAlias() << ") reads '" << path_ << "' " << kAsyncReadDepth
+                  << " blocks ahead" << std::endl;
+        co_return;
+    }
+
+    AsyncTask<bool> next(TupleBatch& batch) override {
+        const auto& columns = scan_.getSchema().getColumns();
+        batch.resize(kPushBatchSize);
+        size_t n = 0;
+        while (n < kPushBatchSize) {
+            if (pos_ < size_) {
+                const char* start = data_ + pos_;
+                const void* newline = std::memchr(start, '\n', size_ - pos_);
+                if (!newline) {
+                    line_.append(start, size_ - pos_); // Finished by the next block
+                    lineComplete_ = false;
+                    pos_ = size_;
+                    continue;
+                }
+                size_t length = static_cast<const char*>(newline) - start;
+                line_.append(start, length);
+                pos_ += length + 1;
+                if (csvQuoteOpen(line_)) {
+                    if (++recordLines_ < kMaxCsvRecordLines) {
+                        line_.push_back('\n');
+                        lineComplete_ = true;
+                        continue;
+                    }
+                    warnUnterminatedCsvRecord();
+                } else if (emit(line_, columns, batch[n])) {
+                    n++;
+                }
+                line_.clear();
+                recordLines_ = 0;
+                continue;
+            }
+
+            // The current block is used up: reuse its buffer for the next read and wait
+            // for the block after it.
+            if (data_) {
+                issue(reads_[current_]);
+                current_ = (current_ + 1) % kAsyncReadDepth;
+                data_ = nullptr;
+            }
+            AsyncRead& read = reads_[current_];
+            if (!read.inFlight()) {
+                // End of the file. Like LineReader, a last line inside an open quote keeps
+                // the newline LineReader would have added.
+                if (!line_.empty()) {
+                    if (!lineComplete_ && csvQuoteOpen(line_)) line_.push_back('\n');
+                    if (emit(line_, columns, batch[n])) n++;
+                    line_.clear();
+                }
+                break;
+            }
+            co_await read;
+            size_ = read.result(path_);
+            data_ = read.data();
+            pos_ = 0;
+        }
+        batch.resize(n);
+        co_return n > 0;
+    }
+
+    AsyncTask<void> close() override {
+        for (auto& read : reads_) {
+            if (read.inFlight()) co_await read;
+        }
+        if (fd_ >= 0) ::close(fd_);
+        fd_ = -1;
+    }
+
+    const Schema& getSchema() const override { return scan_.getSchema(); }
+    std::string describe() const override { return "Scan(" + scan_.getAlias() + ")"; }
+
+private:
+    void issue(AsyncRead& read) {
+        if (nextOffset_ >= fileSize_) return;
+        size_t length = static_cast<size_t>(std::min<uint64_t>(kAsyncReadBytes, fileSize_ - nextOffset_));
+        read.start(scheduler_, fd_, nextOffset_, length);
+        nextOffset_ += length;
+    }
+
+    // The first line is the header; every other one is parsed into a row.
+    bool emit(const std::string& line, const std::vector<ColumnInfo>& columns, Tuple& tuple) {
+        if (!headerSkipped_) {
+            headerSkipped_ = true;
+            return false;
+        }
+        return parseCsvLine(line, columns, tuple);
+    }
+
+    const ScanOperator& scan_;
+    std::string path_;
+    AsyncScheduler& scheduler_;
+    int fd_ = -1;
+    uint64_t fileSize_ = 0;
+    uint64_t nextOffset_ = 0; // Where the next read starts
+
+    AsyncRead reads_[kAsyncReadDepth]; // Used in turn, in file order
+    size_t current_ = 0;               // The read holding (or about to hold) the current block
+    const char* data_ = nullptr;       // The current block, once its read completed
+    size_t pos_ = 0;
+    size_t size_ = 0;
+    std::string line_;         // The line being assembled, possibly across blocks
+    bool lineComplete_ = true; // False while line_ ends in the middle of a physical line
+    size_t recordLines_ = 0;   // Lines of line_ so far that ended inside quotes
+    bool headerSkipped_ = false;
+};
+
+class AsyncFilterOperator : public AsyncOperator {
+public:
+    AsyncFilterOperator(const SelectOperator& select, std::unique_ptr<AsyncOperator> input)
+        : select_(select), input_(std::move(input)) {}
+
+    AsyncTask<void> open() override { co_await input_->open(); }
+
+    AsyncTask<bool> next(TupleBatch& batch) override {
+        const Expression& predicate = select_.getPredicate();
+        const Schema& schema = input_->getSchema();
+        while (co_await input_->next(batch)) {
+            size_t kept = 0;
+            for (auto& row : batch) {
+                if (isTrue(predicate.evaluate(row, schema))) {
+                    if (&batch[kept] != &row) batch[kept] = std::move(row);
+                    kept++;
+                }
+            }
+            batch.resize(kept);
+            if (kept > 0) co_return true;
+        }
+        co_return false;
+    }
+
+    AsyncTask<void> close() override { co_await input_->close(); }
+    const Schema& getSchema() const override { return select_.getSchema(); }
+    std::string describe() const override { return "Filter(" + input_->describe() + ")"; }
+
+private:
+    const SelectOperator& select_;
+    std::unique_ptr<AsyncOperator> input_;
+};
+
+class AsyncProjectOperator : public AsyncOperator {
+public:
+    AsyncProjectOperator(const ProjectOperator& project, std::unique_ptr<AsyncOperator> input)
+        : project_(project), input_(std::move(input)) {}
+
+    AsyncTask<void> open() override { co_await input_->open(); }
+
+    AsyncTask<bool> next(TupleBatch& batch) override {
+        bool more = co_await input_->next(input_batch_);
+        if (!more) co_return false;
+        const Schema& inputSchema = input_->getSchema();
+        const auto& exprs = project_.getExpressions();
+        batch.resize(input_batch_.size());
+        for (size_t i = 0; i < input_batch_.size(); ++i) {
+            project_.fetchLateColumns(input_batch_[i]);
+            batch[i].clear();
+            for (const auto& p : exprs) batch[i].push_back(p.expr->evaluate(input_batch_[i], inputSchema));
+        }
+        co_return true;
+    }
+
+    AsyncTask<void> close() override { co_await input_->close(); }
+    const Schema& getSchema() const override { return project_.getSchema(); }
+    std::string describe() const override { return "Project(" + input_->describe() + ")"; }
+
+private:
+    const ProjectOperator& project_;
+    std::unique_ptr<AsyncOperator> input_;
+    TupleBatch input_batch_;
+};
+
+class AsyncLimitOperator : public AsyncOperator {
+public:
+    AsyncLimitOperator(const LimitOperator& limit, std::unique_ptr<AsyncOperator> input)
+        : limit_(limit), input_(std::move(input)) {}
+
+    AsyncTask<void> open() override {
+        remaining_ = static_cast<size_t>(std::max(0, limit_.getLimit()));
+        co_await input_->open();
+    }
+
+    AsyncTask<bool> next(TupleBatch& batch) override {
+        if (remaining_ == 0) co_return false;
+        bool more = co_await input_->next(batch);
+        if (!more) co_return false;
+        if (batch.size() > remaining_) batch.resize(remaining_);
+        remaining_ -= batch.size();
+        co_return true;
+    }
+
+    AsyncTask<void> close() override { co_await input_->close(); }
+    const Schema& getSchema() const override { return limit_.getSchema(); }
+    std::string describe() const override { return "Limit(" + input_->describe() + ")"; }
+
+private:
+    const LimitOperator& limit_;
+    std::unique_ptr<AsyncOperator> input_;
+    size_t remaining_ = 0;
+};
+
+// Runs an ordinary operator subtree inside the async engine. It never suspends: its reads
+// block the scheduler thread like they would block any other thread.
+class AsyncAdapterOperator : public AsyncOperator {
+public:
+    explicit AsyncAdapterOperator(Operator& op) : op_(op) {}
+
+    AsyncTask<void> open() override {
+        op_.open();
+        co_return;
+    }
+
+    AsyncTask<bool> next(TupleBatch& batch) override {
+        batch.resize(kPushBatchSize);
+        size_t n = 0;
+        while (n < kPushBatchSize && op_.next(batch[n])) n++;
+        batch.resize(n);
+        co_return n > 0;
+    }
+
+    AsyncTask<void> close() override {
+        op_.close();
+        co_return;
+    }
+
+    const Schema& getSchema() const override { return op_.getSchema(); }
+    std::string describe() const override { return "Operator"; }
+
+private:
+    Operator& op_;
+};
+
+// Translates a planned operator tree. The async operators refer to the ordinary ones for
+// their schemas and expressions, so the tree must outlive them.
+inline std::unique_ptr<AsyncOperator> makeAsyncOperator(Operator* op, AsyncScheduler& scheduler) {
+    // A fused loop pulls its scan itself; run the projection it was made from instead.
+    if (auto* fused = dynamic_cast<FusedPipelineOperator*>(op)) op = fused->getProject();
+
+    if (auto* scan = dynamic_cast<ScanOperator*>(op)) {
+        if (scan->readsPlainFile()) return std::make_unique<AsyncScanOperator>(*scan, scheduler);
+    }
+    if (auto* select = dynamic_cast<SelectOperator*>(op)) {
+        return std::make_unique<AsyncFilterOperator>(*select, makeAsyncOperator(select->getInput(), scheduler));
+    }
+    if (auto* project = dynamic_cast<ProjectOperator*>(op)) {
+        return std::make_unique<AsyncProjectOperator>(*project, makeAsyncOperator(project->getInput(), scheduler));
+    }
+    if (auto* limit = dynamic_cast<LimitOperator*>(op)) {
+        return std::make_unique<AsyncLimitOperator>(*limit, makeAsyncOperator(limit->getInput(), scheduler));
+    }
+    return std::make_unique<AsyncAdapterOperator>(*op);
+}
+
+// The async counterpart of executePlan(): plans the query, then runs it as coroutines.
+inline AsyncTask<QueryResult> executePlanAsync(json planJson, Catalog& catalog, std::string dataDir,
+                                               AsyncScheduler& scheduler) {
+    auto start = std::chrono::steady_clock::now();
+    auto root = parsePlan(planJson, catalog, dataDir);
+    auto asyncRoot = makeAsyncOperator(root.get(), scheduler);
+    std::cout << "[Async] Running " << asyncRoot->describe() << std::endl;
+
+    QueryResult result;
+    std::exception_ptr error;
+    try {
+        co_await asyncRoot->open();
+        TupleBatch batch;
+        while (co_await asyncRoot->next(batch)) {
+            for (auto& row : batch) result.rows.push_back(std::move(row));
+        }
+    } catch (...) {
+        error = std::current_exception();
+    }
+    // Reads still in flight must finish before their buffers and files go away.
+    co_await asyncRoot->close();
+    if (error) std::rethrow_exception(error);
+
+    result.schema = asyncRoot->getSchema();
+    result.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    co_return result;
+}
@@ -0,0 +1,408 @@
+#pragma once
+
+#include "thread_pool.h"
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define QP_HAVE_IO_URING 1
+#endif
+
+/*
+    Read-ahead for sequential file scans. A ReadAheadFile keeps several large reads of the
+    file in flight at once and hands the blocks out in file order, so while the caller
+    parses one block the next ones are already being read. On a cold page cache (or a
+    network disk) the scan then waits on disk bandwidth instead of on each read's latency.
+
+    Reads go through io_uring when the kernel allows it (set QP_NO_IO_URING=1 to turn it
+    off), otherwise through pread() on a small pool of threads. The io_uring ring is set up
+    with raw system calls so no extra library is needed. The ring and the pool belong to
+    the process (ReadAheadIo), not to each file: a nested-loop join reopens its inner table
+    for every outer row, and a ring or threads per open would cost system calls each time.
+*/
+
+#ifdef QP_HAVE_IO_URING
+// Just enough of io_uring for a handful of reads in flight: one submission per read and
+// one blocking wait per completion.
+class IoUring {
+public:
+    IoUring() = default;
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    ~IoUring() {
+        if (sqes_) munmap(sqes_, sqesBytes_);
+        if (cqRing_ && cqRing_ != sqRing_) munmap(cqRing_, cqRingBytes_);
+        if (sqRing_) munmap(sqRing_, sqRingBytes_);
+        if (fd_ >= 0) close(fd_);
+    }
+
+    // Returns false when io_uring is unavailable (old kernel, seccomp, ...).
+    bool init(unsigned entries) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd_ < 0) return false;
+
+        sqRingBytes_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingBytes_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMmap) sqRingBytes_ = cqRingBytes_ = std::max(sqRingBytes_, cqRingBytes_);
+
+        sqRing_ = mapRing(sqRingBytes_, IORING_OFF_SQ_RING);
+        if (!sqRing_) return false;
+        cqRing_ = singleMmap ? sqRing_ : mapRing(cqRingBytes_, IORING_OFF_CQ_RING);
+        if (!cqRing_) return false;
+        sqesBytes_ = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe*>(mapRing(sqesBytes_, IORING_OFF_SQES));
+        if (!sqes_) return false;
+
+        char* sq = static_cast<char*>(sqRing_);
+        char* cq = static_cast<char*>(cqRing_);
+        sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    bool submitRead(int fd, void* buffer, unsigned length, uint64_t offset, uint64_t userData) {
+        unsigned tail = *sqTail_;
+        unsigned index = tail & sqMask_;
+        io_uring_sqe* sqe = &sqes_[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(buffer);
+        sqe->len = length;
+        sqe->off = offset;
+        sqe->user_data = userData;
+        return submit(tail);
+    }
+
+    // A no-op whose completion carries userData, to wake the thread waiting on the ring.
+    bool submitNop(uint64_t userData) {
+        unsigned tail = *sqTail_;
+        io_uring_sqe* sqe = &sqes_[tail & sqMask_];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_NOP;
+        sqe->user_data = userData;
+        return submit(tail);
+    }
+
+    // Blocks until one read completes. res is the byte count or -errno.
+    bool waitCompletion(uint64_t& userData, int& res) {
+        unsigned head = *cqHead_;
+        while (head == __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) {
+            if (enter(0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) return false;
+        }
+        const io_uring_cqe& cqe = cqes_[head & cqMask_];
+        userData = cqe.user_data;
+        res = cqe.res;
+        __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+private:
+    // Publishes the entry at tail and submits it. If the kernel did not take it, the entry
+    // is taken back: without SQPOLL only io_uring_enter reads the queue, so it can never be
+    // picked up later, after its buffer has been handed to pread instead.
+    bool submit(unsigned tail) {
+        unsigned index = tail & sqMask_;
+        sqArray_[index] = index;
+        __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+        if (enter(1, 0, 0) == 1) return true;
+        __atomic_store_n(sqTail_, tail, __ATOMIC_RELEASE);
+        return false;
+    }
+
+    void* mapRing(size_t bytes, off_t offset) {
+        void* ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, offset);
+        return ptr == MAP_FAILED ? nullptr : ptr;
+    }
+
+    int enter(unsigned toSubmit, unsigned minComplete, unsigned flags) {
+        return static_cast<int>(syscall(__NR_io_uring_enter, fd_, toSubmit, minComplete, flags, nullptr, 0));
+    }
+
+    int fd_ = -1;
+    void* sqRing_ = nullptr;
+    void* cqRing_ = nullptr;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sqRingBytes_ = 0, cqRingBytes_ = 0, sqesBytes_ = 0;
+    unsigned* sqTail_ = nullptr;
+    unsigned* sqArray_ = nullptr;
+    unsigned sqMask_ = 0;
+    unsigned* cqHead_ = nullptr;
+    unsigned* cqTail_ = nullptr;
+    unsigned cqMask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+};
+#endif
+
+// The shared half of read-ahead: one io_uring for the whole process, with a thread that
+// reaps its completions, and one pool of pread threads for when io_uring is unavailable,
+// turned off, full, or refuses a read.
+class ReadAheadIo {
+public:
+    static ReadAheadIo& instance() {
+        static ReadAheadIo io;
+        return io;
+    }
+
+    ReadAheadIo(const ReadAheadIo&) = delete;
+    ReadAheadIo& operator=(const ReadAheadIo&) = delete;
+
+    ~ReadAheadIo() {
+#ifdef QP_HAVE_IO_URING
+        if (reaper_.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                ring_->submitNop(0); // User data 0 tells the reaper to stop
+            }
+            reaper_.join();
+        }
+#endif
+    }
+
+    // Reads length bytes at offset into buffer, then calls done(bytes read or -errno) on
+    // another thread. The buffer must stay alive until done has been called.
+    void read(int fd, char* buffer, size_t length, uint64_t offset, std::function<void(long long)> done) {
+        auto request = std::make_unique<Request>(Request{fd, buffer, length, offset, std::move(done)});
+#ifdef QP_HAVE_IO_URING
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (ringUsable_ && ringInFlight_ < kRingEntries &&
+                ring_->submitRead(fd, buffer, static_cast<unsigned>(length), offset, reinterpret_cast<uint64_t>(request.get()))) {
+                ringInFlight_++;
+                request.release(); // Deleted by the reaper
+                return;
+            }
+        }
+#endif
+        readWithPool(std::move(request));
+    }
+
+    bool usingIoUring() const {
+#ifdef QP_HAVE_IO_URING
+        std::lock_guard<std::mutex> lock(mutex_);
+        return ringUsable_;
+#else
+        return false;
+#endif
+    }
+
+private:
+    struct Request {
+        int fd;
+        char* buffer;
+        size_t length;
+        uint64_t offset;
+        std::function<void(long long)> done;
+    };
+
+    static constexpr unsigned kRingEntries = 64;
+
+    ReadAheadIo() {
+#ifdef QP_HAVE_IO_URING
+        const char* disable = std::getenv("QP_NO_IO_URING");
+        if (!disable || std::string(disable) == "0") {
+            ring_ = std::make_unique<IoUring>();
+            // The completion queue is twice the submission queue, so it cannot overflow
+            // with at most kRingEntries reads in flight.
+            if (ring_->init(kRingEntries)) {
+                ringUsable_ = true;
+                reaper_ = std::thread([this] { reapLoop(); });
+            } else {
+                ring_.reset();
+            }
+        }
+#endif
+    }
+
+    void readWithPool(std::unique_ptr<Request> request) {
+        std::call_once(poolOnce_, [this] { pool_ = std::make_unique<ThreadPool>(std::max(4u, std::thread::hardware_concurrency())); });
+        pool_->submit([r = std::shared_ptr<Request>(std::move(request))] {
+            ssize_t got;
+            do {
+                got = pread(r->fd, r->buffer, r->length, static_cast<off_t>(r->offset));
+            } while (got < 0 && errno == EINTR);
+            r->done(got < 0 ? -errno : got);
+        });
+    }
+
+#ifdef QP_HAVE_IO_URING
+    // Hands each completion to its reader until the stop no-op arrives.
+    void reapLoop() {
+        while (true) {
+            uint64_t userData;
+            int res;
+            if (!ring_->waitCompletion(userData, res)) continue; // Only EINTR-like failures are expected
+            if (userData == 0) return;
+            std::unique_ptr<Request> request(reinterpret_cast<Request*>(userData));
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                ringInFlight_--;
+                // Kernels without IORING_OP_READ reject it: use pread from now on.
+                if (res == -EINVAL || res == -EOPNOTSUPP) ringUsable_ = false;
+            }
+            if (res == -EINVAL || res == -EOPNOTSUPP) readWithPool(std::move(request));
+            else request->done(res);
+        }
+    }
+
+    std::unique_ptr<IoUring> ring_;
+    std::thread reaper_;
+    bool ringUsable_ = false;
+    unsigned ringInFlight_ = 0;
+#endif
+    mutable std::mutex mutex_; // Guards the submission queue and the counters above
+    std::once_flag poolOnce_;
+    std::unique_ptr<ThreadPool> pool_;
+};
+
+class ReadAheadFile {
+public:
+    explicit ReadAheadFile(const std::string& path, size_t blockBytes = size_t(1) << 20, size_t depth = 4)
+        : path_(path), blockBytes_(blockBytes), slots_(std::max<size_t>(depth, 2)) {
+        fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0) throw std::runtime_error("Cannot open data file: " + path);
+        struct stat st;
+        if (fstat(fd_, &st) != 0) {
+            ::close(fd_);
+            throw std::runtime_error("Cannot stat data file: " + path);
+        }
+        fileSize_ = static_cast<uint64_t>(st.st_size);
+        posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+        // No point in more buffers than the file has blocks; a file that fits in one block
+        // (e.g. the inner side of a nested-loop join, reopened for every outer row) is just
+        // read synchronously.
+        size_t blocks = static_cast<size_t>((fileSize_ + blockBytes_ - 1) / blockBytes_);
+        slots_.resize(std::max<size_t>(1, std::min(slots_.size(), blocks)));
+        for (auto& slot : slots_) slot.buffer.reset(new char[std::min<uint64_t>(blockBytes_, std::max<uint64_t>(fileSize_, 1))]);
+        syncOnly_ = blocks <= 1;
+        for (size_t i = 0; i < slots_.size(); ++i) issue(i);
+    }
+
+    ~ReadAheadFile() {
+        // Buffers must outlive every read still in flight.
+        std::unique_lock<std::mutex> lock(mutex_);
+        readDone_.wait(lock, [this] {
+            for (const auto& slot : slots_) {
+                if (slot.inFlight && !slot.done) return false;
+            }
+            return true;
+        });
+        lock.unlock();
+        ::close(fd_);
+    }
+
+    ReadAheadFile(const ReadAheadFile&) = delete;
+    ReadAheadFile& operator=(const ReadAheadFile&) = delete;
+
+    bool usingIoUring() const { return !syncOnly_ && ReadAheadIo::instance().usingIoUring(); }
+
+    // Hands out the next block of the file. The data stays valid until the next call.
+    bool next(const char*& data, size_t& size) {
+        // The block handed out last time has been consumed: reuse its buffer for a read further ahead.
+        if (lastSlot_ < slots_.size()) issue(lastSlot_);
+
+        size_t index = consumed_ % slots_.size();
+        Slot& slot = slots_[index];
+        if (!slot.inFlight) return false; // Past the end of the file.
+        waitFor(index);
+        slot.inFlight = false;
+        if (slot.result < 0) {
+            throw std::runtime_error("Read error in " + path_ + ": " + std::strerror(static_cast<int>(-slot.result)));
+        }
+        size_t got = static_cast<size_t>(slot.result);
+        // Reads of regular files only come back short at the end of the file, but finish
+        // the block synchronously if one ever does.
+        while (got < slot.length) {
+            ssize_t more = pread(fd_, slot.buffer.get() + got, slot.length - got, static_cast<off_t>(slot.offset + got));
+            if (more < 0 && errno == EINTR) continue;
+            if (more <= 0) break;
+            got += static_cast<size_t>(more);
+        }
+        consumed_++;
+        lastSlot_ = index;
+        if (got == 0) return false;
+        data = slot.buffer.get();
+        size = got;
+        return true;
+    }
+
+private:
+    struct Slot {
+        std::unique_ptr<char[]> buffer;
+        uint64_t offset = 0;
+        size_t length = 0;
+        bool inFlight = false; // A read was issued and the block not handed out yet
+        bool done = false;     // The read has completed
+        long long result = 0;  // Bytes read or -errno
+    };
+
+    // Starts reading the next block of the file into slot i.
+    void issue(size_t i) {
+        Slot& slot = slots_[i];
+        if (nextOffset_ >= fileSize_) return;
+        slot.offset = nextOffset_;
+        slot.length = static_cast<size_t>(std::min<uint64_t>(blockBytes_, fileSize_ - nextOffset_));
+        nextOffset_ += slot.length;
+        slot.inFlight = true;
+        slot.done = false;
+        if (syncOnly_) {
+            ssize_t got;
+            do {
+                got = pread(fd_, slot.buffer.get(), slot.length, static_cast<off_t>(slot.offset));
+            } while (got < 0 && errno == EINTR);
+            slot.result = got < 0 ? -errno : got;
+            slot.done = true;
+            return;
+        }
+        ReadAheadIo::instance().read(fd_, slot.buffer.get(), slot.length, slot.offset, [this, i](long long result) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            slots_[i].result = result;
+            slots_[i].done = true;
+            readDone_.notify_all();
+        });
+    }
+
+    void waitFor(size_t i) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        readDone_.wait(lock, [this, i] { return slots_[i].done; });
+    }
+
+    std::string path_;
+    int fd_ = -1;
+    uint64_t fileSize_ = 0;
+    size_t blockBytes_;
+    std::vector<Slot> slots_;
+    uint64_t nextOffset_ = 0;  // File offset of the next read to issue
+    size_t consumed_ = 0;      // Blocks handed out so far
+    size_t lastSlot_ = size_t(-1);
+    bool syncOnly_ = false; // Small file, read with one pread
+
+    std::mutex mutex_; // Guards done and result of the slots, set on the I/O threads
+    std::condition_variable readDone_;
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "async_exec.h"
+#include <atomic>
+#include <istream>
+#include <mutex>
+
+/*
+    Server mode on the async engine (query_processor_async --serve-async). Same line
+    protocol as QueryServer for plans and stats:
+
+        {"op": "Scan", ...}                    a bare plan
+        {"id": 7, "plan": {...}}               a plan with an id echoed back in the reply
+        {"cmd": "stats"}                       query counters
+
+    Every request becomes a coroutine on the AsyncScheduler instead of a job that owns a
+    pool thread until it finishes, so a handful of threads keep many queries going: while
+    one query waits for its reads, the threads parse and filter for the others. Tables are
+    always read from their files (there is no table or result cache here), which is the
+    case this mode is for. Prepared statements are only offered by the ordinary server.
+*/
+struct AsyncServerOptions {
+    size_t threads = 1;   // Scheduler threads resuming queries
+    size_t ioThreads = 8; // Threads blocked in pread() on behalf of the queries
+};
+
+class AsyncQueryServer {
+public:
+    AsyncQueryServer(const std::string& dataDir, const AsyncServerOptions& options)
+        : dataDir_(dataDir), scheduler_(options.threads, options.ioThreads) {
+        catalog_.loadSchemas(dataDir_);
+    }
+
+    // Reads requests until the stream ends and writes each reply as soon as its query
+    // finishes, then waits for the queries still running.
+    void serveStream(std::istream& in, std::ostream& out) {
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.empty()) continue;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                inFlight_++;
+            }
+            scheduler_.spawn(serveRequest(line, out));
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_.wait(lock, [this] { return inFlight_ == 0; });
+    }
+
+    json stats() const {
+        json s;
+        s["queries_served"] = queriesServed_.load();
+        s["threads"] = scheduler_.threads();
+        s["io_threads"] = scheduler_.ioThreads();
+        return s;
+    }
+
+private:
+    AsyncTask<void> serveRequest(std::string line, std::ostream& out) {
+        std::string reply = co_await handleRequest(std::move(line));
+        {
+            std::lock_guard<std::mutex> lock(outMutex_);
+            out << reply << std::endl;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--inFlight_ == 0) idle_.notify_all();
+    }
+
+    // Handles a single request line and returns the JSON reply (without a newline).
+    AsyncTask<std::string> handleRequest(std::string line) {
+        json reply;
+        try {
+            json request = json::parse(line);
+            if (request.contains("id")) reply["id"] = request["id"];
+
+            if (request.contains("cmd")) {
+                std::string cmd = request["cmd"];
+                if (cmd != "stats") throw std::runtime_error("Unknown command: " + cmd);
+                reply["stats"] = stats();
+            } else {
+                json plan = request.contains("plan") ? request["plan"] : request;
+                QueryResult result = co_await executePlanAsync(std::move(plan), catalog_, dataDir_, scheduler_);
+                reply.update(resultToJson(result));
+                queriesServed_++;
+            }
+            reply["ok"] = true;
+        } catch (const std::exception& e) {
+            reply["ok"] = false;
+            reply["error"] = e.what();
+        }
+        co_return reply.dump();
+    }
+
+    std::string dataDir_;
+    Catalog catalog_;
+    std::atomic<size_t> queriesServed_{0};
+
+    std::mutex outMutex_;
+    std::mutex mutex_;
+    std::condition_variable idle_;
+    size_t inFlight_ = 0;
+
+    // Declared last so that its threads are joined before anything they use goes away.
+    AsyncScheduler scheduler_;
+};
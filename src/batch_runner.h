@@ -0,0 +1,171 @@
+#pragma once
+
+#include "executor.h"
+#include "shared_scan.h"
+#include "table_cache.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+/*
+    Batch mode: runs many plans in one process. The catalog is loaded once and every plan
+    shares the same TableCache and SharedScanManager, so a table is parsed once for the
+    whole batch (or, if it is too big to cache, concurrent plans share their scans of it).
+
+    Each plan's result goes to its own sink: <out_dir>/<plan_name>.out (see planNames)
+    when an output directory is given, otherwise it is printed to stdout in plan order
+    once the batch is done. A timing summary is printed at the end and, with an output
+    directory, also written to <out_dir>/timings.csv.
+*/
+
+struct BatchOptions {
+    size_t threads = 1;
+    size_t tableCacheBytes = size_t(1) << 30;
+    std::string outDir; // Empty: print results to stdout
+};
+
+// Expands the batch argument into a list of plan files. It can be a directory (every
+// *.json in it, sorted by name) or a text file with one plan path per line.
+inline std::vector<std::string> listBatchPlans(const std::string& source) {
+    std::vector<std::string> plans;
+    if (std::filesystem::is_directory(source)) {
+        for (const auto& entry : std::filesystem::directory_iterator(source)) {
+            if (entry.path().extension() == ".json") plans.push_back(entry.path().string());
+        }
+        std::sort(plans.begin(), plans.end());
+        return plans;
+    }
+
+    std::ifstream list(source);
+    if (!list.is_open()) throw std::runtime_error("Could not open plan list: " + source);
+    std::filesystem::path listDir = std::filesystem::path(source).parent_path();
+    std::string line;
+    while (std::getline(list, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        // Paths are taken as given, or relative to the list file if that is where they exist.
+        if (!std::filesystem::exists(line) && std::filesystem::exists(listDir / line)) {
+            line = (listDir / line).string();
+        }
+        plans.push_back(line);
+    }
+    return plans;
+}
+
+class BatchRunner {
+public:
+    BatchRunner(const std::string& dataDir, const BatchOptions& options)
+        : dataDir_(dataDir), options_(options), tableCache_(options.tableCacheBytes) {
+        catalog_.loadSchemas(dataDir_);
+        if (options_.tableCacheBytes > 0) catalog_.setTableCache(&tableCache_);
+        catalog_.setSharedScanManager(&sharedScans_);
+        if (!options_.outDir.empty()) std::filesystem::create_directories(options_.outDir);
+    }
+
+    // Runs every plan and returns the number of plans that failed.
+    int run(const std::vector<std::string>& planPaths, std::ostream& out) {
+        std::vector<std::string> names = planNames(planPaths);
+        std::vector<Outcome> outcomes(planPaths.size());
+        {
+            ThreadPool pool(options_.threads);
+            for (size_t i = 0; i < planPaths.size(); ++i) {
+                pool.submit([this, &planPaths, &names, &outcomes, i] { outcomes[i] = runOne(planPaths[i], names[i]); });
+            }
+            pool.waitIdle();
+        }
+
+        int failures = 0;
+        for (size_t i = 0; i < planPaths.size(); ++i) {
+            if (!outcomes[i].ok) failures++;
+            if (options_.outDir.empty()) {
+                out << "==> " << planPaths[i] << " <==\n" << outcomes[i].text << "\n";
+            }
+        }
+        printSummary(names, outcomes, out);
+        return failures;
+    }
+
+private:
+    struct Outcome {
+        bool ok = false;
+        double elapsedMs = 0.0;
+        size_t rows = 0;
+        std::string text; // Printed result, or the error message
+    };
+
+    // The name of each plan's .out file and timings row: the file stem, or, when several
+    // plans share a stem (a/q.json and b/q.json in a list), the stem and the plan's position
+    // in the batch (q.1, q.2).
+    static std::vector<std::string> planNames(const std::vector<std::string>& planPaths) {
+        std::vector<std::string> names;
+        std::unordered_map<std::string, size_t> stemCount;
+        for (const auto& path : planPaths) stemCount[std::filesystem::path(path).stem().string()]++;
+        std::unordered_map<std::string, size_t> seen;
+        for (size_t i = 0; i < planPaths.size(); ++i) {
+            std::string stem = std::filesystem::path(planPaths[i]).stem().string();
+            names.push_back(stemCount[stem] > 1 ? stem + "." + std::to_string(i + 1) : stem);
+            if (seen.count(names.back())) {
+                throw std::runtime_error("Plans " + planPaths[seen[names.back()]] + " and " + planPaths[i] +
+                                         " would both be named '" + names.back() + "'.");
+            }
+            seen[names.back()] = i;
+        }
+        return names;
+    }
+
+    Outcome runOne(const std::string& planPath, const std::string& name) {
+        Outcome outcome;
+        std::ostringstream text;
+        try {
+            std::ifstream planFile(planPath);
+            if (!planFile.is_open()) throw std::runtime_error("Could not open plan file: " + planPath);
+            json planJson = json::parse(planFile);
+            QueryResult result = executePlan(planJson, catalog_, dataDir_);
+            printResult(result, text);
+            outcome.ok = true;
+            outcome.elapsedMs = result.elapsedMs;
+            outcome.rows = result.rows.size();
+        } catch (const std::exception& e) {
+            text << "Error during execution: " << e.what() << "\n";
+        }
+        outcome.text = text.str();
+
+        if (!options_.outDir.empty()) {
+            std::ofstream sink(std::filesystem::path(options_.outDir) / (name + ".out"));
+            sink << outcome.text;
+        }
+        return outcome;
+    }
+
+    void printSummary(const std::vector<std::string>& names, const std::vector<Outcome>& outcomes, std::ostream& out) {
+        out << "====================================================\n";
+        out << "          Batch Execution Summary\n";
+        out << "====================================================\n";
+        char line[160];
+        std::snprintf(line, sizeof(line), "%-40s %10s %12s\n", "Query Plan", "Rows", "Elapsed (ms)");
+        out << line;
+        out << "----------------------------------------------------\n";
+        std::ofstream csv;
+        if (!options_.outDir.empty()) {
+            csv.open(std::filesystem::path(options_.outDir) / "timings.csv");
+            csv << "plan,ok,rows,elapsed_ms\n";
+        }
+        for (size_t i = 0; i < names.size(); ++i) {
+            const Outcome& o = outcomes[i];
+            const std::string& name = names[i];
+            if (o.ok) std::snprintf(line, sizeof(line), "%-40s %10zu %12.3f\n", name.c_str(), o.rows, o.elapsedMs);
+            else std::snprintf(line, sizeof(line), "%-40s %10s %12s\n", name.c_str(), "-", "FAILED");
+            out << line;
+            if (csv.is_open()) csv << name << "," << (o.ok ? "true" : "false") << "," << o.rows << "," << o.elapsedMs << "\n";
+        }
+        out << "====================================================\n";
+    }
+
+    std::string dataDir_;
+    BatchOptions options_;
+    Catalog catalog_;
+    TableCache tableCache_;
+    SharedScanManager sharedScans_;
+};
@@ -0,0 +1,167 @@
+#pragma once
+
+#include "zone_map.h"
+#include <memory>
+
+/*
+    Select predicates evaluated on the encoded blocks of a cached table, 64 rows per word.
+    Zone predicates (zone_map.h) only cover a single "column <op> constant"; a BlockFilter
+    takes any AND / OR / NOT / IS [NOT] NULL combination of such comparisons. Each
+    comparison is narrowed on the encoded column (ColumnVector::filterBlock) into a value
+    bitmap, its validity bitmap is the column's, and the connectives combine the
+    (value, validity) word pairs with kleeneAnd / kleeneOr from expression.h, so NULLs
+    follow SQL's three-valued logic without a branch per row. Rows whose result is not a
+    valid TRUE are dropped from the scan's selection.
+
+    Like zone maps this is only a head start: the Select above still evaluates every row
+    the scan returns. When a comparison cannot be decided on the encoded block (see
+    filterBlock), the filter is skipped for that block.
+*/
+class BlockFilter {
+public:
+    // Returns null when the predicate is not made only of the supported pieces.
+    static std::unique_ptr<BlockFilter> build(const Expression& predicate, const Schema& schema) {
+        auto filter = std::unique_ptr<BlockFilter>(new BlockFilter());
+        if (!filter->addNode(predicate, schema)) return nullptr;
+        return filter;
+    }
+
+    // Evaluates the constants (or bound parameters) once per open().
+    void bindConstants(const Schema& schema) {
+        Tuple empty;
+        for (auto& node : nodes_) {
+            if (node.kind == Kind::COMPARE) node.value = node.compare.constant->evaluate(empty, schema);
+        }
+    }
+
+    // Clears sel[i] for the rows of the block where the predicate is not TRUE. Returns
+    // false, leaving sel alone, when the block could not be filtered.
+    bool apply(const ColumnarTable& table, size_t block, size_t rows, uint8_t* sel, std::vector<int32_t>& scratch) {
+        words_ = (rows + 63) / 64;
+        rows_ = rows;
+        if (!evaluate(nodes_.size() - 1, table, block, scratch)) return false;
+        const Bits& result = bits_[nodes_.size() - 1];
+        for (size_t i = 0; i < rows; ++i) {
+            sel[i] &= static_cast<uint8_t>(((result.value[i / 64] & result.valid[i / 64]) >> (i % 64)) & 1);
+        }
+        return true;
+    }
+
+private:
+    enum class Kind { COMPARE, IS_NULL, IS_NOT_NULL, NOT, AND, OR };
+
+    // Nodes are stored children first; the root is the last one.
+    struct Node {
+        Kind kind;
+        ZonePredicate compare; // COMPARE; its column is also used by the null tests
+        CmpOp op = CmpOp::EQ;
+        Value value;           // The constant for this open()
+        size_t left = 0, right = 0;
+    };
+
+    // A value bitmap and a validity bitmap (0 = NULL), one bit per row of the block.
+    struct Bits {
+        std::vector<uint64_t> value;
+        std::vector<uint64_t> valid;
+    };
+
+    BlockFilter() = default;
+
+    bool addNode(const Expression& expr, const Schema& schema) {
+        Node node;
+        if (auto* binary = dynamic_cast<const BinaryExpression*>(&expr)) {
+            const std::string& op = binary->getOp();
+            if (op == "AND" || op == "OR") {
+                if (!addNode(binary->getLeft(), schema)) return false;
+                node.left = nodes_.size() - 1;
+                if (!addNode(binary->getRight(), schema)) return false;
+                node.right = nodes_.size() - 1;
+                node.kind = op == "AND" ? Kind::AND : Kind::OR;
+            } else {
+                if (!extractZonePredicate(expr, schema, node.compare) || !parseCmpOp(node.compare.op, node.op)) return false;
+                node.kind = Kind::COMPARE;
+            }
+        } else if (auto* notExpr = dynamic_cast<const NotExpression*>(&expr)) {
+            if (!addNode(notExpr->getExpr(), schema)) return false;
+            node.left = nodes_.size() - 1;
+            node.kind = Kind::NOT;
+        } else if (auto* nullTest = dynamic_cast<const NullTestExpression*>(&expr)) {
+            auto* col = dynamic_cast<const ColumnRefExpression*>(&nullTest->getExpr());
+            if (!col) return false;
+            bool found = false;
+            for (const auto& info : schema.getColumns()) {
+                if (info.name == col->getColumnName()) {
+                    node.compare.column = info.index;
+                    found = true;
+                }
+            }
+            if (!found) return false;
+            node.kind = nullTest->isNegated() ? Kind::IS_NOT_NULL : Kind::IS_NULL;
+        } else {
+            return false;
+        }
+        nodes_.push_back(std::move(node));
+        return true;
+    }
+
+    bool evaluate(size_t n, const ColumnarTable& table, size_t block, std::vector<int32_t>& scratch) {
+        if (bits_.size() < nodes_.size()) bits_.resize(nodes_.size());
+        Node& node = nodes_[n];
+        Bits& out = bits_[n];
+        out.value.assign(words_, 0);
+        out.valid.assign(words_, ~uint64_t(0));
+
+        switch (node.kind) {
+            case Kind::COMPARE: {
+                if (isNull(node.value)) { // A comparison with NULL is NULL for every row
+                    out.valid.assign(words_, 0);
+                    return true;
+                }
+                const ColumnVector& column = table.column(node.compare.column);
+                bytes_.assign(rows_, 1);
+                if (!column.filterBlock(block, node.op, node.value, bytes_.data(), scratch)) return false;
+                for (size_t i = 0; i < rows_; ++i) out.value[i / 64] |= uint64_t(bytes_[i]) << (i % 64);
+                if (const uint64_t* validity = column.blockValidity(block)) out.valid.assign(validity, validity + words_);
+                return true;
+            }
+            case Kind::IS_NULL:
+            case Kind::IS_NOT_NULL: {
+                const uint64_t* validity = table.column(node.compare.column).blockValidity(block);
+                bool negated = node.kind == Kind::IS_NOT_NULL;
+                for (size_t w = 0; w < words_; ++w) {
+                    uint64_t present = validity ? validity[w] : ~uint64_t(0);
+                    out.value[w] = negated ? present : ~present;
+                }
+                return true;
+            }
+            case Kind::NOT: {
+                if (!evaluate(node.left, table, block, scratch)) return false;
+                const Bits& in = bits_[node.left];
+                for (size_t w = 0; w < words_; ++w) {
+                    out.value[w] = ~in.value[w] & in.valid[w]; // NOT NULL stays NULL
+                    out.valid[w] = in.valid[w];
+                }
+                return true;
+            }
+            case Kind::AND:
+            case Kind::OR: {
+                if (!evaluate(node.left, table, block, scratch) || !evaluate(node.right, table, block, scratch)) return false;
+                const Bits& l = bits_[node.left];
+                const Bits& r = bits_[node.right];
+                for (size_t w = 0; w < words_; ++w) {
+                    out.value[w] = node.kind == Kind::AND
+                                       ? kleeneAnd(l.value[w], l.valid[w], r.value[w], r.valid[w], out.valid[w])
+                                       : kleeneOr(l.value[w], l.valid[w], r.value[w], r.valid[w], out.valid[w]);
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<Node> nodes_;
+    std::vector<Bits> bits_;     // Per node, for the current block
+    std::vector<uint8_t> bytes_; // filterBlock's one-byte-per-row selection
+    size_t words_ = 0;
+    size_t rows_ = 0;
+};
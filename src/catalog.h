@@ -8,6 +8,9 @@
 
 using json = nlohmann::json;
 
+class TableCache;        // Defined in table_cache.h
+class SharedScanManager; // Defined in shared_scan.h
+
 inline DataType stringToType(const std::string& typeStr) {
     if (typeStr == "int") return DataType::INT;
     if (typeStr == "float") return DataType::FLOAT;
@@ -16,10 +19,51 @@ inline DataType stringToType(const std::string& typeStr) {
     throw std::runtime_error("Unknown data type: " + typeStr);
 }
 
+inline std::string typeToString(DataType type) {
+    switch (type) {
+        case DataType::INT: return "int";
+        case DataType::FLOAT: return "float";
+        case DataType::STRING: return "string";
+        case DataType::BOOL: return "bool";
+    }
+    return "unknown";
+}
+
+// Compressed table files (see line_reader.h) are named after the CSV they contain.
+inline std::string stripCompressionSuffix(const std::string& name) {
+    for (const char* suffix : {".gz", ".zst"}) {
+        size_t len = std::char_traits<char>::length(suffix);
+        if (name.size() > len && name.compare(name.size() - len, len, suffix) == 0) {
+            return name.substr(0, name.size() - len);
+        }
+    }
+    return name;
+}
+
+// Finds the file behind a table path: the path itself, or else a compressed copy of it
+// (orders.csv -> orders.csv.gz or orders.csv.zst).
+inline std::string resolveTableFile(const std::string& path) {
+    if (std::filesystem::exists(path)) return path;
+    for (const char* suffix : {".gz", ".zst"}) {
+        if (std::filesystem::exists(path + suffix)) return path + suffix;
+    }
+    return path; // Let the scan report the missing file.
+}
+
+// A table stored as many files, e.g. "file": "orders_by_year/order_year=*/*.csv" with
+// "partition_keys": ["order_year"]. The partition key columns are not stored in the files;
+// their values come from the key=value directory names (see partition.h).
+struct PartitionSpec {
+    std::string pattern;              // File pattern or directory, relative to the data directory
+    std::vector<std::string> keys;    // Partition key column names
+    std::vector<size_t> keyColumns;   // Their indexes in the table schema
+};
+
 class Catalog {
 public:
     // Scans a directory for .schema.json files
     void loadSchemas(const std::string& dataDir) {
+        dataDir_ = dataDir;
         std::cout << "[Catalog] Scanning directory: '" << dataDir << "'" << std::endl;
         
         for (const auto& entry : std::filesystem::directory_iterator(dataDir)) {
@@ -33,10 +77,31 @@ public:
 
     // FIX 2: ADDED THIS MISSING PUBLIC FUNCTION
     // Looks up the schema for a given table name (e.g., "customers.csv").
+    // A compressed file ("customers.csv.gz") uses the schema of the CSV it contains.
     const Schema& getSchema(const std::string& tableName) const {
-        return schemas_.at(tableName);
+        auto it = schemas_.find(tableName);
+        if (it == schemas_.end()) it = schemas_.find(stripCompressionSuffix(tableName));
+        if (it == schemas_.end()) return schemas_.at(tableName);
+        return it->second;
     }
 
+    // Returns the partition layout when the table is stored as many files, else nullptr.
+    const PartitionSpec* getPartitionSpec(const std::string& tableName) const {
+        auto it = partitions_.find(tableName);
+        return it == partitions_.end() ? nullptr : &it->second;
+    }
+
+    const std::string& getDataDir() const { return dataDir_; }
+
+    // Long-running modes attach a TableCache so scans can reuse parsed tables.
+    // A plain single-query run leaves this as nullptr and scans read the CSV directly.
+    void setTableCache(TableCache* cache) { tableCache_ = cache; }
+    TableCache* getTableCache() const { return tableCache_; }
+
+    // When set, concurrent scans of the same uncached file share one pass over it.
+    void setSharedScanManager(SharedScanManager* manager) { sharedScans_ = manager; }
+    SharedScanManager* getSharedScanManager() const { return sharedScans_; }
+
     void printAddress() const {
         std::cout << "[Catalog::Debug] My memory address is: " << this << std::endl;
     }
@@ -54,10 +119,41 @@ private:
         for (const auto& col : schemaJson["columns"]) {
             schema.addColumn(col["name"], stringToType(col["type"]));
         }
+        // Partitioned tables are registered under their "name" (which is what plans scan)
+        // as well as under their file pattern.
+        if (schemaJson.contains("partition_keys") || csvFile.find('*') != std::string::npos ||
+            std::filesystem::is_directory(std::filesystem::path(dataDir_) / csvFile)) {
+            PartitionSpec spec;
+            spec.pattern = csvFile;
+            for (const auto& key : schemaJson.value("partition_keys", json::array())) {
+                bool found = false;
+                for (const auto& col : schema.getColumns()) {
+                    if (col.name == key.get<std::string>()) {
+                        spec.keyColumns.push_back(col.index);
+                        found = true;
+                    }
+                }
+                if (!found) throw std::runtime_error("Partition key '" + key.get<std::string>() + "' is not a column of " + schemaPath);
+                spec.keys.push_back(key);
+            }
+            std::string name = schemaJson.value("name", csvFile);
+            schemas_[name] = schema;
+            partitions_[name] = spec;
+            partitions_[csvFile] = spec;
+            std::cout << "[Catalog] Storing partitioned table '" << name << "' (" << csvFile << ")" << std::endl;
+        }
+
+        // A schema may name the compressed file directly; it is stored under the CSV name
+        // so that plans can refer to the table either way.
+        csvFile = stripCompressionSuffix(csvFile);
         schemas_[csvFile] = schema; // Use _ to denote member variable
         std::cout << "[Catalog] Storing schema for key: '" << csvFile << "'" << std::endl;
         std::cout << "Loaded schema for " << csvFile << std::endl;
     }
 
     std::unordered_map<std::string, Schema> schemas_; // Use _ to denote member variable
+    std::unordered_map<std::string, PartitionSpec> partitions_;
+    std::string dataDir_;
+    TableCache* tableCache_ = nullptr;
+    SharedScanManager* sharedScans_ = nullptr;
 }; // FIX 3: Added the missing semicolon here
\ No newline at end of file
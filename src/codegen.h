@@ -0,0 +1,506 @@
+#pragma once
+
+#include "operator.h"
+#include <cstdio>
+#include <dlfcn.h>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <spawn.h>
+#include <sstream>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+/*
+    Runtime code generation for hot Scan -> Select -> Project pipelines. Instead of
+    walking Expression trees of Values for every row, the pipeline is written out as C++
+    with the column offsets, types and constants baked in: every sub-expression becomes a
+    typed local plus a null flag, and the code follows BinaryExpression's rules exactly
+    (three-valued AND/OR, NULL in gives NULL out, arithmetic in double rounded to float,
+    "Division by zero." thrown the same way). The generated file exports two functions:
+
+        bool qp_filter(const Tuple& row)               every Select, innermost first
+        void qp_project(const Tuple& row, Tuple& out)  the Project's expressions
+
+    It is compiled with the compiler that built query_processor into a shared object,
+    named by the FNV-1a hash of the source and of a build fingerprint (see
+    buildFingerprint()), in $QP_CODEGEN_DIR (default: qp_codegen-<uid> in the temp
+    directory), and loaded with dlopen. That directory must belong to the user and not be
+    writable by anyone else, since whatever is in it gets run. The compiler runs in the background: until the
+    object is ready, and if compiling fails, the plan runs interpreted. Later runs of the
+    same plan, in this process or the next one, load the cached object.
+
+    Enabled with "compile": true on a Project, or "engine": "compiled" on any node for
+    every Project below it. Only expressions whose outcome is known from the column types
+    are compiled (e.g. no ordering of strings or parameters); other plans run as before.
+*/
+
+namespace codegen {
+
+// --- Writing the source ---
+
+// Turns the predicates and expressions of one pipeline into C++. Each emit() returns the
+// number of the local holding the result (vN, with the null flag nN).
+class SourceWriter {
+public:
+    explicit SourceWriter(const Schema& schema) : schema_(schema) {}
+
+    // False (with a reason) when some expression is not supported.
+    bool addFilter(const Expression& predicate) {
+        Local result;
+        std::ostringstream saved;
+        std::swap(body_, saved);
+        bool ok = emit(predicate, result);
+        std::swap(body_, saved);
+        if (!ok) return false;
+        if (result.type != DataType::BOOL) return fail("predicate is not boolean");
+        filters_ << "    {\n" << saved.str() << "        if (n" << result.id << " || !v" << result.id << ") return false;\n    }\n";
+        return true;
+    }
+
+    bool addOutput(const Expression& expr, size_t position) {
+        std::ostringstream saved;
+        std::swap(body_, saved);
+        bool ok = true;
+        if (auto* col = dynamic_cast<const ColumnRefExpression*>(&expr)) {
+            // Copied as is, whatever the value holds.
+            size_t index;
+            ok = findColumn(col->getColumnName(), index);
+            if (ok) body_ << "        out[" << position << "] = row[" << index << "];\n";
+        } else {
+            Local result;
+            ok = emit(expr, result);
+            if (ok) {
+                body_ << "        if (n" << result.id << ") out[" << position << "] = nullValue();\n";
+                body_ << "        else out[" << position << "] = Value(" << (result.type == DataType::STRING ? "*v" : "v")
+                      << result.id << ");\n";
+            }
+        }
+        std::swap(body_, saved);
+        if (ok) outputs_ << "    {\n" << saved.str() << "    }\n";
+        outputCount_ = position + 1;
+        return ok;
+    }
+
+    std::string source() const {
+        std::ostringstream out;
+        out << "// Generated by query_processor (codegen.h).\n"
+            << "#include \"types.h\"\n#include <stdexcept>\n\n"
+            << constants_.str() << "\n"
+            << "extern \"C\" bool qp_filter(const Tuple& row) {\n" << filters_.str() << "    return true;\n}\n\n"
+            << "extern \"C\" void qp_project(const Tuple& row, Tuple& out) {\n"
+            << "    out.resize(" << outputCount_ << ");\n" << outputs_.str() << "}\n";
+        return out.str();
+    }
+
+    const std::string& reason() const { return reason_; }
+
+private:
+    struct Local {
+        int id = 0;
+        DataType type = DataType::INT;
+    };
+
+    static const char* cppType(DataType type) {
+        switch (type) {
+            case DataType::INT: return "int";
+            case DataType::FLOAT: return "float";
+            case DataType::STRING: return "std::string";
+            case DataType::BOOL: return "bool";
+        }
+        return "int";
+    }
+
+    static bool numeric(DataType type) { return type == DataType::INT || type == DataType::FLOAT; }
+
+    bool fail(const std::string& why) {
+        reason_ = why;
+        return false;
+    }
+
+    bool findColumn(const std::string& name, size_t& index) {
+        for (const auto& info : schema_.getColumns()) {
+            if (info.name == name) {
+                index = info.index;
+                return true;
+            }
+        }
+        return fail("unknown column " + name);
+    }
+
+    // The local's value as an operand: strings are held by pointer.
+    static std::string operand(const Local& local) {
+        return (local.type == DataType::STRING ? "*v" : "v") + std::to_string(local.id);
+    }
+
+    Local newLocal(DataType type) { return {nextId_++, type}; }
+
+    void declare(const Local& local, const std::string& isNull, const std::string& value) {
+        body_ << "        const bool n" << local.id << " = " << isNull << ";\n";
+        if (local.type == DataType::STRING) body_ << "        const std::string* v" << local.id << " = " << value << ";\n";
+        else body_ << "        const " << cppType(local.type) << " v" << local.id << " = " << value << ";\n";
+    }
+
+    bool emitConstant(const Value& value, Local& out) {
+        char buffer[64];
+        if (auto* i = std::get_if<int>(&value)) {
+            out = newLocal(DataType::INT);
+            declare(out, "false", std::to_string(*i));
+        } else if (auto* f = std::get_if<float>(&value)) {
+            // Hex float literals are exact.
+            std::snprintf(buffer, sizeof(buffer), "%a", static_cast<double>(*f));
+            out = newLocal(DataType::FLOAT);
+            declare(out, "false", std::string("static_cast<float>(") + buffer + ")");
+        } else if (auto* b = std::get_if<bool>(&value)) {
+            out = newLocal(DataType::BOOL);
+            declare(out, "false", *b ? "true" : "false");
+        } else if (auto* s = std::get_if<std::string>(&value)) {
+            std::string name = "kString" + std::to_string(stringCount_++);
+            constants_ << "static const std::string " << name << " = \"";
+            for (unsigned char c : *s) {
+                std::snprintf(buffer, sizeof(buffer), "\\x%02x\" \"", c);
+                constants_ << buffer;
+            }
+            constants_ << "\";\n";
+            out = newLocal(DataType::STRING);
+            declare(out, "false", "&" + name);
+        } else {
+            return fail("NULL constant");
+        }
+        return true;
+    }
+
+    bool emit(const Expression& expr, Local& out) {
+        if (auto* col = dynamic_cast<const ColumnRefExpression*>(&expr)) {
+            size_t index;
+            if (!findColumn(col->getColumnName(), index)) return false;
+            DataType type = schema_.getColumn(col->getColumnName()).type;
+            out = newLocal(type);
+            std::string pointer = "p" + std::to_string(out.id);
+            body_ << "        const " << cppType(type) << "* " << pointer << " = std::get_if<" << cppType(type)
+                  << ">(&row[" << index << "]);\n";
+            declare(out, "!" + pointer, type == DataType::STRING ? pointer
+                                                                 : pointer + " ? *" + pointer + " : " + cppType(type) + "()");
+            return true;
+        }
+        if (auto* constant = dynamic_cast<const ConstantExpression*>(&expr)) {
+            return emitConstant(constant->evaluate(Tuple(), Schema()), out);
+        }
+        if (auto* notExpr = dynamic_cast<const NotExpression*>(&expr)) {
+            Local operandLocal;
+            if (!emit(notExpr->getExpr(), operandLocal)) return false;
+            if (operandLocal.type != DataType::BOOL) return fail("NOT of a non-boolean");
+            out = newLocal(DataType::BOOL);
+            std::string id = std::to_string(operandLocal.id);
+            declare(out, "n" + id, "!n" + id + " && !v" + id);
+            return true;
+        }
+        if (auto* test = dynamic_cast<const NullTestExpression*>(&expr)) {
+            Local operandLocal;
+            if (!emit(test->getExpr(), operandLocal)) return false;
+            out = newLocal(DataType::BOOL);
+            declare(out, "false", "n" + std::to_string(operandLocal.id) + (test->isNegated() ? " == false" : ""));
+            return true;
+        }
+        auto* binary = dynamic_cast<const BinaryExpression*>(&expr);
+        if (!binary) return fail("unsupported expression (e.g. a parameter)");
+
+        // Both sides are always evaluated, as in BinaryExpression.
+        Local l, r;
+        if (!emit(binary->getLeft(), l) || !emit(binary->getRight(), r)) return false;
+        const std::string& op = binary->getOp();
+        std::string ln = "n" + std::to_string(l.id), rn = "n" + std::to_string(r.id);
+        std::string lv = operand(l), rv = operand(r);
+        std::string eitherNull = ln + " || " + rn;
+
+        if (op == "AND" || op == "OR") {
+            if (l.type != DataType::BOOL || r.type != DataType::BOOL) return fail(op + " of non-booleans");
+            // kleeneAnd / kleeneOr on single flags; a NULL side's value is false.
+            out = newLocal(DataType::BOOL);
+            if (op == "AND") {
+                declare(out, "!((!" + ln + " && !" + rn + ") || (!" + ln + " && !" + lv + ") || (!" + rn + " && !" + rv + "))",
+                        lv + " && " + rv);
+            } else {
+                declare(out, "!((!" + ln + " && !" + rn + ") || (!" + ln + " && " + lv + ") || (!" + rn + " && " + rv + "))",
+                        lv + " || " + rv);
+            }
+            return true;
+        }
+        if (op == "ADD" || op == "SUB" || op == "MUL" || op == "DIV") {
+            if (!numeric(l.type) || !numeric(r.type)) return fail(op + " of non-numbers");
+            static const std::map<std::string, const char*> symbols = {{"ADD", "+"}, {"SUB", "-"}, {"MUL", "*"}, {"DIV", "/"}};
+            out = newLocal(DataType::FLOAT);
+            std::string left = "static_cast<double>(" + lv + ")", right = "static_cast<double>(" + rv + ")";
+            if (op == "DIV") {
+                body_ << "        if (!(" << eitherNull << ") && " << right << " == 0.0) throw std::runtime_error(\"Division by zero.\");\n";
+            }
+            declare(out, eitherNull, "(" + eitherNull + ") ? 0.0f : static_cast<float>(" + left + " " + symbols.at(op) + " " + right + ")");
+            return true;
+        }
+        if (op == "EQ" || op == "NEQ") {
+            // Values of different types are never equal (std::variant comparison).
+            std::string same = l.type == r.type ? lv + " == " + rv : "false";
+            out = newLocal(DataType::BOOL);
+            declare(out, eitherNull, "!(" + eitherNull + ") && " + (op == "EQ" ? "(" + same + ")" : "!(" + same + ")"));
+            return true;
+        }
+        static const std::map<std::string, const char*> ordering = {{"LT", "<"}, {"LTE", "<="}, {"GT", ">"}, {"GTE", ">="}};
+        auto it = ordering.find(op);
+        if (it == ordering.end()) return fail("unsupported operator " + op);
+        if (!numeric(l.type) || !numeric(r.type)) return fail(op + " of non-numbers");
+        out = newLocal(DataType::BOOL);
+        declare(out, eitherNull, "!(" + eitherNull + ") && static_cast<double>(" + lv + ") " + it->second +
+                                     " static_cast<double>(" + rv + ")");
+        return true;
+    }
+
+    const Schema& schema_;
+    std::ostringstream body_;      // Statements of the expression being emitted
+    std::ostringstream filters_;   // Body of qp_filter
+    std::ostringstream outputs_;   // Body of qp_project
+    std::ostringstream constants_; // String constants
+    size_t outputCount_ = 0;
+    int nextId_ = 0;
+    int stringCount_ = 0;
+    std::string reason_;
+};
+
+// --- Compiling and loading ---
+
+using FilterFn = bool (*)(const Tuple&);
+using ProjectFn = void (*)(const Tuple&, Tuple&);
+
+struct CompiledPipeline {
+    FilterFn filter = nullptr;
+    ProjectFn project = nullptr;
+};
+
+inline std::string cacheDirectory() {
+    const char* dir = std::getenv("QP_CODEGEN_DIR");
+    if (dir && *dir) return dir;
+    return (std::filesystem::temp_directory_path() / ("qp_codegen-" + std::to_string(geteuid()))).string();
+}
+
+// Creates the cache directory if needed and checks that loading objects from it is safe:
+// a real directory (not a symlink), owned by this user, that no one else can write to.
+inline bool preparePrivateDirectory(const std::string& dir, std::string& problem) {
+    std::error_code ec;
+    std::filesystem::path parent = std::filesystem::path(dir).parent_path();
+    if (!parent.empty()) std::filesystem::create_directories(parent, ec);
+    ::mkdir(dir.c_str(), 0700); // Fails harmlessly when it already exists
+    struct stat st;
+    if (lstat(dir.c_str(), &st) != 0) problem = "cannot create " + dir;
+    else if (!S_ISDIR(st.st_mode)) problem = dir + " is not a directory";
+    else if (st.st_uid != geteuid()) problem = dir + " belongs to another user";
+    else if (st.st_mode & (S_IWGRP | S_IWOTH)) problem = dir + " is writable by other users";
+    else return true;
+    return false;
+}
+
+// Identifies the build the generated code is linked against. The objects include types.h
+// rather than containing it, so the same source compiled against a different Value or
+// Tuple layout (or by another compiler) must get a different name.
+inline const std::string& buildFingerprint() {
+    static const std::string fingerprint = [] {
+        std::string f = std::string(__VERSION__) + "|" + __DATE__ + " " + __TIME__ + "|";
+#ifdef QP_CODEGEN_INCLUDE
+        std::ifstream types(std::string(QP_CODEGEN_INCLUDE) + "/types.h", std::ios::binary);
+        f.append(std::istreambuf_iterator<char>(types), std::istreambuf_iterator<char>());
+#endif
+        return f;
+    }();
+    return fingerprint;
+}
+
+// Shared objects by source hash, for the whole process. A plan's first open() starts the
+// compiler and returns nothing; open() calls after it has finished load the result.
+class ObjectCache {
+public:
+    static ObjectCache& instance() {
+        static ObjectCache* cache = new ObjectCache(); // Never destroyed: loaded code stays valid until exit
+        return *cache;
+    }
+
+    // The loaded pipeline, or null (with a status message) while it is not available.
+    const CompiledPipeline* acquire(const std::string& name, const std::string& source, std::string& status) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!directoryProblem_.empty()) {
+            status = "not using the object cache (" + directoryProblem_ + ")";
+            return nullptr;
+        }
+        Entry& entry = entries_[name];
+        if (entry.state == State::READY) return &entry.pipeline;
+        if (entry.state == State::FAILED) {
+            status = "compiling it failed, see " + path(name, ".log");
+            return nullptr;
+        }
+        if (entry.state == State::COMPILING) {
+            int exitStatus = 0;
+            pid_t done = waitpid(entry.compiler, &exitStatus, WNOHANG);
+            if (done == 0) {
+                status = "still compiling";
+                return nullptr;
+            }
+            if (done < 0 || !WIFEXITED(exitStatus) || WEXITSTATUS(exitStatus) != 0) {
+                entry.state = State::FAILED;
+                status = "compiling it failed, see " + path(name, ".log");
+                return nullptr;
+            }
+        }
+        // Compiled by this process just now, or by an earlier run.
+        if (std::filesystem::exists(path(name, ".so")) && load(name, entry)) return &entry.pipeline;
+        if (entry.state == State::COMPILING || std::filesystem::exists(path(name, ".failed"))) {
+            entry.state = State::FAILED;
+            status = "compiling it failed, see " + path(name, ".log");
+            return nullptr;
+        }
+        status = startCompiler(name, source, entry) ? "compiling in the background" : "could not start the compiler";
+        if (entry.state != State::COMPILING) entry.state = State::FAILED;
+        return nullptr;
+    }
+
+private:
+    ObjectCache() { preparePrivateDirectory(directory_, directoryProblem_); }
+
+    enum class State { NEW, COMPILING, READY, FAILED };
+
+    struct Entry {
+        State state = State::NEW;
+        pid_t compiler = -1;
+        CompiledPipeline pipeline;
+    };
+
+    std::string path(const std::string& name, const char* suffix) const { return directory_ + "/" + name + suffix; }
+
+    bool load(const std::string& name, Entry& entry) {
+        void* handle = dlopen(path(name, ".so").c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (!handle) return false;
+        entry.pipeline.filter = reinterpret_cast<FilterFn>(dlsym(handle, "qp_filter"));
+        entry.pipeline.project = reinterpret_cast<ProjectFn>(dlsym(handle, "qp_project"));
+        if (!entry.pipeline.filter || !entry.pipeline.project) {
+            dlclose(handle);
+            return false;
+        }
+        entry.state = State::READY;
+        return true;
+    }
+
+    // Writes the source and starts "compile, then rename into place" as its own process,
+    // so that it finishes (and later runs find the object) even if this process exits first.
+    bool startCompiler(const std::string& name, const std::string& source, Entry& entry) {
+#if defined(QP_CODEGEN_CXX) && defined(QP_CODEGEN_INCLUDE)
+        {
+            std::ofstream file(path(name, ".cpp"));
+            file << source;
+            if (!file) return false;
+        }
+        std::string temp = path(name, ".so.") + std::to_string(getpid());
+        std::string command = std::string("'") + QP_CODEGEN_CXX + "' -std=c++17 -O2 -fPIC -shared -I'" + QP_CODEGEN_INCLUDE +
+                              "' -o '" + temp + "' '" + path(name, ".cpp") + "' > '" + path(name, ".log") +
+                              "' 2>&1 && mv -f '" + temp + "' '" + path(name, ".so") + "' || { touch '" +
+                              path(name, ".failed") + "'; exit 1; }";
+        const char* argv[] = {"sh", "-c", command.c_str(), nullptr};
+        pid_t pid;
+        if (posix_spawn(&pid, "/bin/sh", nullptr, nullptr, const_cast<char* const*>(argv), environ) != 0) return false;
+        entry.compiler = pid;
+        entry.state = State::COMPILING;
+        return true;
+#else
+        (void)name;
+        (void)source;
+        (void)entry;
+        return false; // Built without a compiler to call
+#endif
+    }
+
+    std::mutex mutex_;
+    std::map<std::string, Entry> entries_;
+    std::string directory_ = cacheDirectory();
+    std::string directoryProblem_; // Set when directory_ is not safe to load code from
+};
+
+} // namespace codegen
+
+// A Project(Select*(Scan)) pipeline run by generated code once it has been compiled, and
+// by the original operators until then.
+class CompiledPipelineOperator : public Operator {
+public:
+    CompiledPipelineOperator(std::unique_ptr<ProjectOperator> project, ScanOperator* scan, std::string source)
+        : project_(std::move(project)), scan_(scan), source_(std::move(source)) {
+        char name[32];
+        const std::string& fingerprint = codegen::buildFingerprint();
+        uint64_t hash = fnv1a64(fingerprint.data(), fingerprint.size());
+        std::snprintf(name, sizeof(name), "%016llx",
+                      static_cast<unsigned long long>(fnv1a64(source_.data(), source_.size(), hash)));
+        name_ = name;
+    }
+
+    void open() override {
+        std::string status;
+        compiled_ = codegen::ObjectCache::instance().acquire(name_, source_, status);
+        if (!compiled_) {
+            std::cout << "[Codegen] Plan " << name_ << ": " << status << "; running interpreted." << std::endl;
+            project_->open();
+            return;
+        }
+        std::cout << "[Codegen] Plan " << name_ << ": running compiled code." << std::endl;
+        scan_->open();
+    }
+
+    bool next(Tuple& tuple) override {
+        if (!compiled_) return project_->next(tuple);
+        while (scan_->ScanOperator::next(row_)) {
+            if (!compiled_->filter(row_)) continue;
+            project_->fetchLateColumns(row_);
+            compiled_->project(row_, tuple);
+            return true;
+        }
+        return false;
+    }
+
+    void close() override {
+        if (compiled_) scan_->close();
+        else project_->close();
+    }
+
+    const Schema& getSchema() const override { return project_->getSchema(); }
+    const std::string& getName() const { return name_; }
+
+private:
+    std::unique_ptr<ProjectOperator> project_;
+    ScanOperator* scan_; // Below project_
+    std::string source_;
+    std::string name_;   // Hash of the source, names the cached files
+    const codegen::CompiledPipeline* compiled_ = nullptr;
+    Tuple row_;
+};
+
+// Planner hook for "compile": true. Returns null, leaving the Project as it is, when the
+// plan is not a Scan -> Select -> Project pipeline the generator supports.
+inline std::unique_ptr<Operator> planCompiledPipeline(std::unique_ptr<ProjectOperator>& project) {
+    std::vector<const SelectOperator*> selects;
+    Operator* below = project->getInput();
+    while (auto* select = dynamic_cast<SelectOperator*>(below)) {
+        selects.push_back(select);
+        below = select->getInput();
+    }
+    auto* scan = dynamic_cast<ScanOperator*>(below);
+    if (!scan) {
+        std::cout << "[Codegen] Not compiling: only Scan -> Select -> Project pipelines are supported." << std::endl;
+        return nullptr;
+    }
+    codegen::SourceWriter writer(scan->getSchema());
+    bool ok = true;
+    for (auto it = selects.rbegin(); ok && it != selects.rend(); ++it) ok = writer.addFilter((*it)->getPredicate());
+    const auto& exprs = project->getExpressions();
+    for (size_t i = 0; ok && i < exprs.size(); ++i) ok = writer.addOutput(*exprs[i].expr, i);
+    if (!ok) {
+        std::cout << "[Codegen] Not compiling: " << writer.reason() << "." << std::endl;
+        return nullptr;
+    }
+    return std::make_unique<CompiledPipelineOperator>(std::move(project), scan, writer.source());
+}
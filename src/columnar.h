@@ -0,0 +1,322 @@
+#pragma once
+
+#include "types.h"
+#include "encoding.h"
+#include "expression.h" // is_numeric / to_double
+#include <vector>
+#include <string>
+
+/*
+    In-memory columnar representation of a table. The TableCache keeps tables in this
+    form so a long-running process does not have to re-read and re-parse CSV files for
+    every query. Each column is stored in typed, compressed blocks instead of a vector
+    of Values.
+*/
+
+// Number of rows per block in a cached table. Zone maps keep statistics per block.
+constexpr size_t kZoneBlockRows = 16384;
+
+// Simple per-column statistics gathered while a table is loaded, both for the whole
+// table and for each block of kZoneBlockRows rows (the zone maps).
+struct ColumnStats {
+    bool hasValues = false;
+    Value min;
+    Value max;
+    size_t nullCount = 0;
+
+    void update(const Value& val) {
+        if (isNull(val)) {
+            nullCount++; // NULLs take no part in min/max
+            return;
+        }
+        if (!hasValues) {
+            min = val;
+            max = val;
+            hasValues = true;
+            return;
+        }
+        if (val < min) min = val;
+        if (max < val) max = val;
+    }
+};
+
+// Validity bitmaps: bit i of a column's bitmap is set when row i holds a value and clear
+// when it is NULL. A column without any NULLs has no bitmap at all.
+inline bool validityBit(const uint64_t* validity, size_t i) {
+    return (validity[i / 64] >> (i % 64)) & 1;
+}
+
+// One block of a column decoded into plain arrays, ready to be turned into Tuples.
+struct DecodedColumn {
+    DataType type = DataType::INT;
+    std::vector<int32_t> ints; // INT and BOOL values, or indexes into `strings` for STRING
+    std::vector<float> floats;
+    const std::vector<std::string>* strings = nullptr;
+    const uint64_t* validity = nullptr; // The block's validity bits; null when it has no NULLs
+
+    Value get(size_t i) const {
+        if (validity && !validityBit(validity, i)) return nullValue();
+        switch (type) {
+            case DataType::INT:    return ints[i];
+            case DataType::BOOL:   return ints[i] != 0;
+            case DataType::FLOAT:  return floats[i];
+            case DataType::STRING: return (*strings)[ints[i]];
+        }
+        return 0;
+    }
+};
+
+// A single column of a table. Values are appended into a typed vector while the table is
+// loaded; finalize() then compresses them into per-block encodings (see encoding.h).
+// NULLs are stored as a placeholder value (0, 0.0, "" or false) with their bit cleared
+// in the validity bitmap, so the encodings never see them.
+class ColumnVector {
+public:
+    explicit ColumnVector(DataType type) : type_(type) {}
+
+    void append(const Value& val) {
+        if (!validity_.empty() && size_ / 64 >= validity_.size()) validity_.push_back(~uint64_t(0));
+        size_t row = size_++;
+        if (isNull(val)) {
+            if (validity_.empty()) validity_.assign(row / 64 + 1, ~uint64_t(0)); // First NULL
+            validity_[row / 64] &= ~(uint64_t(1) << (row % 64));
+            switch (type_) {
+                case DataType::INT:
+                case DataType::BOOL:   ints_.push_back(0); break;
+                case DataType::FLOAT:  floats_.push_back(0.0f); break;
+                case DataType::STRING: strings_.emplace_back(); break;
+            }
+            return;
+        }
+        switch (type_) {
+            case DataType::INT:    ints_.push_back(std::get<int>(val)); break;
+            case DataType::BOOL:   ints_.push_back(std::get<bool>(val) ? 1 : 0); break;
+            case DataType::FLOAT:  floats_.push_back(std::get<float>(val)); break;
+            case DataType::STRING: strings_.push_back(std::get<std::string>(val)); break;
+        }
+    }
+
+    // Encodes the appended values block by block and releases the raw vectors.
+    void finalize() {
+        size_t n = (type_ == DataType::FLOAT) ? floats_.size() : (type_ == DataType::STRING ? strings_.size() : ints_.size());
+        for (size_t start = 0; start < n; start += kZoneBlockRows) {
+            size_t len = std::min(kZoneBlockRows, n - start);
+            switch (type_) {
+                case DataType::INT:
+                case DataType::BOOL:
+                    intBlocks_.push_back(IntBlock::encode(ints_.data() + start, len));
+                    break;
+                case DataType::FLOAT:
+                    floatBlocks_.emplace_back(floats_.begin() + start, floats_.begin() + start + len);
+                    break;
+                case DataType::STRING:
+                    stringBlocks_.push_back(StringBlock::encode(strings_.data() + start, len));
+                    break;
+            }
+        }
+        std::vector<int32_t>().swap(ints_);
+        std::vector<float>().swap(floats_);
+        std::vector<std::string>().swap(strings_);
+        finalized_ = true;
+    }
+
+    // Random access to one value (used when only a few rows are needed).
+    Value get(size_t row) const {
+        if (!isValid(row)) return nullValue();
+        if (!finalized_) {
+            switch (type_) {
+                case DataType::INT:    return ints_[row];
+                case DataType::BOOL:   return ints_[row] != 0;
+                case DataType::FLOAT:  return floats_[row];
+                case DataType::STRING: return strings_[row];
+            }
+        }
+        size_t block = row / kZoneBlockRows, offset = row % kZoneBlockRows;
+        switch (type_) {
+            case DataType::INT:    return intBlocks_[block].get(offset);
+            case DataType::BOOL:   return intBlocks_[block].get(offset) != 0;
+            case DataType::FLOAT:  return floatBlocks_[block][offset];
+            case DataType::STRING: return stringBlocks_[block].get(offset);
+        }
+        return 0;
+    }
+
+    // Decodes a whole block (of a finalized column) into plain arrays.
+    void decodeBlock(size_t block, DecodedColumn& out) const {
+        out.type = type_;
+        out.validity = blockValidity(block);
+        switch (type_) {
+            case DataType::INT:
+            case DataType::BOOL:
+                out.ints.resize(intBlocks_[block].size());
+                intBlocks_[block].decode(out.ints.data());
+                break;
+            case DataType::FLOAT:
+                out.floats = floatBlocks_[block];
+                break;
+            case DataType::STRING:
+                out.ints.resize(stringBlocks_[block].size());
+                stringBlocks_[block].decodeCodes(out.ints.data());
+                out.strings = &stringBlocks_[block].strings();
+                break;
+        }
+    }
+
+    // Narrows sel (one byte per row of the block) to rows where "value <op> c" holds,
+    // working on the encoded block. Follows BinaryExpression's rules; returns false when
+    // the predicate was left for the evaluator (e.g. comparing an int column to a float
+    // with EQ, which is always false there, or ordering strings, which throws there).
+    // A comparison with NULL is never true, so NULL rows are dropped as well.
+    bool filterBlock(size_t block, CmpOp op, const Value& c, uint8_t* sel, std::vector<int32_t>& scratch) const {
+        if (!filterEncoded(block, op, c, sel, scratch)) return false;
+        if (const uint64_t* validity = blockValidity(block)) {
+            size_t rows = std::min(kZoneBlockRows, size_ - block * kZoneBlockRows);
+            for (size_t i = 0; i < rows; ++i) sel[i] &= static_cast<uint8_t>(validityBit(validity, i));
+        }
+        return true;
+    }
+
+    DataType type() const { return type_; }
+    bool hasNulls() const { return !validity_.empty(); }
+    bool isValid(size_t row) const { return validity_.empty() || validityBit(validity_.data(), row); }
+
+    Encoding blockEncoding(size_t block) const {
+        switch (type_) {
+            case DataType::INT:
+            case DataType::BOOL:   return intBlocks_[block].encoding();
+            case DataType::FLOAT:  return Encoding::PLAIN;
+            case DataType::STRING: return stringBlocks_[block].encoding();
+        }
+        return Encoding::PLAIN;
+    }
+
+    // Rough number of bytes held by this column, used for the cache budget.
+    size_t memoryBytes() const {
+        size_t bytes = ints_.capacity() * sizeof(int32_t) + floats_.capacity() * sizeof(float);
+        for (const auto& s : strings_) bytes += sizeof(std::string) + (s.size() > 15 ? s.capacity() : 0);
+        for (const auto& b : intBlocks_) bytes += b.memoryBytes();
+        for (const auto& b : floatBlocks_) bytes += sizeof(b) + b.capacity() * sizeof(float);
+        for (const auto& b : stringBlocks_) bytes += b.memoryBytes();
+        bytes += validity_.capacity() * sizeof(uint64_t);
+        return bytes;
+    }
+
+    // Blocks are a multiple of 64 rows, so each one starts on a bitmap word.
+    static_assert(kZoneBlockRows % 64 == 0, "blocks must start on a validity word");
+
+    // The block's validity words (bit set = not NULL), or null when the column has no NULLs.
+    const uint64_t* blockValidity(size_t block) const {
+        return validity_.empty() ? nullptr : validity_.data() + block * (kZoneBlockRows / 64);
+    }
+
+private:
+
+    bool filterEncoded(size_t block, CmpOp op, const Value& c, uint8_t* sel, std::vector<int32_t>& scratch) const {
+        bool equality = (op == CmpOp::EQ || op == CmpOp::NEQ);
+        switch (type_) {
+            case DataType::INT:
+            case DataType::FLOAT: {
+                bool sameType = (type_ == DataType::INT) ? std::holds_alternative<int>(c) : std::holds_alternative<float>(c);
+                if (!is_numeric(c) || (equality && !sameType)) return false;
+                double constant = to_double(c);
+                if (type_ == DataType::FLOAT) {
+                    const auto& vals = floatBlocks_[block];
+                    filterArray(vals.data(), vals.size(), op, constant, sel);
+                    return true;
+                }
+                scratch.resize(intBlocks_[block].size());
+                intBlocks_[block].filter(op, constant, sel, scratch.data());
+                return true;
+            }
+            case DataType::BOOL:
+                if (!equality || !std::holds_alternative<bool>(c)) return false;
+                scratch.resize(intBlocks_[block].size());
+                intBlocks_[block].filter(op, std::get<bool>(c) ? 1.0 : 0.0, sel, scratch.data());
+                return true;
+            case DataType::STRING:
+                if (!std::holds_alternative<std::string>(c)) return false;
+                scratch.resize(stringBlocks_[block].size());
+                return stringBlocks_[block].filter(op, std::get<std::string>(c), sel, scratch.data());
+        }
+        return false;
+    }
+
+    DataType type_;
+    bool finalized_ = false;
+    size_t size_ = 0;
+    std::vector<uint64_t> validity_; // Empty until the first NULL is appended
+
+    // Raw values while the table is being loaded.
+    std::vector<int32_t> ints_; // INT and BOOL (stored as 0/1)
+    std::vector<float> floats_;
+    std::vector<std::string> strings_;
+
+    // Encoded blocks once finalized; only the vector matching type_ is used.
+    std::vector<IntBlock> intBlocks_;
+    std::vector<std::vector<float>> floatBlocks_;
+    std::vector<StringBlock> stringBlocks_;
+};
+
+// A whole table held column-by-column. The schema uses the unqualified column names
+// from the catalog; scans add their alias on top of it.
+class ColumnarTable {
+public:
+    explicit ColumnarTable(const Schema& schema) : schema_(schema) {
+        for (const auto& col : schema_.getColumns()) {
+            columns_.emplace_back(col.type);
+        }
+        stats_.resize(columns_.size());
+    }
+
+    // Appends one parsed row. Rows with the wrong number of fields are rejected.
+    bool appendRow(const Tuple& tuple) {
+        if (tuple.size() != columns_.size()) return false;
+        if (rowCount_ % kZoneBlockRows == 0) {
+            zones_.emplace_back(columns_.size()); // Start a new block
+        }
+        auto& zone = zones_.back();
+        for (size_t i = 0; i < tuple.size(); ++i) {
+            columns_[i].append(tuple[i]);
+            stats_[i].update(tuple[i]);
+            zone[i].update(tuple[i]);
+        }
+        rowCount_++;
+        return true;
+    }
+
+    // Compresses every column once all rows have been appended.
+    void finalize() {
+        for (auto& col : columns_) col.finalize();
+    }
+
+    // Materializes a row back into the Tuple form the operators work with.
+    void getRow(size_t row, Tuple& tuple) const {
+        tuple.clear();
+        tuple.reserve(columns_.size());
+        for (const auto& col : columns_) {
+            tuple.push_back(col.get(row));
+        }
+    }
+
+    size_t rowCount() const { return rowCount_; }
+    const Schema& getSchema() const { return schema_; }
+    const ColumnVector& column(size_t idx) const { return columns_[idx]; }
+    const ColumnStats& stats(size_t idx) const { return stats_[idx]; }
+
+    // Zone map access: block b covers rows [b * kZoneBlockRows, (b + 1) * kZoneBlockRows).
+    size_t blockCount() const { return zones_.size(); }
+    const ColumnStats& zone(size_t block, size_t col) const { return zones_[block][col]; }
+
+    size_t memoryBytes() const {
+        size_t bytes = 0;
+        for (const auto& col : columns_) bytes += col.memoryBytes();
+        return bytes;
+    }
+
+private:
+    Schema schema_;
+    std::vector<ColumnVector> columns_;
+    std::vector<ColumnStats> stats_;
+    std::vector<std::vector<ColumnStats>> zones_; // [block][column]
+    size_t rowCount_ = 0;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "types.h"
+#include "csv_quotes.h"
+#include <iostream>
+#include <stdexcept>
+
+/*
+    Shared CSV helpers. Both the streaming ScanOperator and the in-memory TableCache
+    turn a raw CSV line into a Tuple, so the conversion lives here in one place.
+*/
+
+// Converts one raw CSV field into a Value of the column's declared type. An empty field
+// is NULL, whatever the type. Throws std::invalid_argument when a numeric field cannot be
+// parsed.
+inline Value parseField(const std::string& field, DataType type) {
+    if (field.empty()) return nullValue();
+    switch (type) {
+        case DataType::INT:    return std::stoi(field);
+        case DataType::FLOAT:  return std::stof(field);
+        case DataType::STRING: return field;
+        case DataType::BOOL:   return field == "true" || field == "1";
+    }
+    throw std::runtime_error("Unknown column type while parsing CSV field.");
+}
+
+// Splits a CSV line on the commas outside quotes and parses each field according to the
+// schema columns; quoted fields are unquoted first (see csv_quotes.h), and a quoted empty
+// string "" stays an empty STRING rather than NULL. Returns false (after printing a
+// warning) when a field could not be parsed or fields are missing, so the caller can skip
+// the row, which is what the scan has always done. Blank lines are skipped without a
+// warning.
+inline bool parseCsvLine(const std::string& line, const std::vector<ColumnInfo>& cols, Tuple& tuple) {
+    tuple.clear();
+    if (line.empty()) return false; // Blank lines (e.g. between concatenated files) are not rows
+
+    bool ok = true;
+    std::string field;
+    forEachCsvField(line, [&](size_t begin, size_t end) {
+        if (tuple.size() >= cols.size()) return false; // Handle trailing commas or malformed lines
+        const auto& colInfo = cols[tuple.size()];
+        bool quoted = end > begin && line[begin] == '"';
+        if (quoted) field = unquoteCsvField(line.data() + begin, line.data() + end);
+        else field.assign(line, begin, end - begin);
+        try {
+            if (quoted && field.empty() && colInfo.type == DataType::STRING) tuple.push_back(std::string());
+            else tuple.push_back(parseField(field, colInfo.type));
+        } catch (const std::invalid_argument&) {
+            std::cerr << "Warning: Could not parse '" << field << "' for column " << colInfo.name << ". Skipping row." << std::endl;
+            ok = false;
+            return false;
+        }
+        return true;
+    });
+    if (!ok) return false;
+    // Operators index tuples by schema position, so a short row cannot be passed on.
+    if (tuple.size() < cols.size()) {
+        std::cerr << "Warning: Row has " << tuple.size() << " of " << cols.size() << " fields. Skipping row." << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define QP_HAVE_X86_SIMD 1
+#endif
+
+/*
+    Quote handling for RFC 4180 CSV ("Korea, Republic of" as one field, "" for a literal
+    quote, newlines inside quotes), done a 64-byte block at a time as in simdjson.
+
+    For each block two bitmasks are built with SIMD compares: where the quotes are and where
+    the commas are. The prefix XOR of the quote mask (bit i = parity of the quotes at or
+    before i) marks the bytes inside a quoted field; it is one carry-less multiplication by
+    an all-ones word (PCLMULQDQ), with a shift-and-xor fallback on CPUs without it. A
+    comma separates fields only where that mask is clear, and the last bit carries into the
+    next block. Fields are then cut at the remaining comma bits without looking at the
+    bytes in between, so quotes cost nothing extra and unquoted lines take the same path.
+
+    As in RFC 4180 only a quote at the start of a field opens a quoted field; a quote in
+    the middle of an unquoted field (Bo"b) is a literal character. The quote mask is
+    narrowed to the delimiting quotes before the prefix XOR, one quote at a time, so lines
+    without quotes never get there.
+
+    Records with a newline inside quotes are glued back together by the line readers: a
+    line that ends inside a quoted field continues on the next line. A record still open
+    after kMaxCsvRecordLines lines is taken to be an unterminated quote and dropped with a
+    warning, so one bad quote cannot swallow the rest of the file.
+*/
+
+// Lines one record may span before an open quote is reported as malformed.
+constexpr size_t kMaxCsvRecordLines = 100;
+
+namespace csv_detail {
+
+inline uint64_t prefixXorPortable(uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+#ifdef QP_HAVE_X86_SIMD
+__attribute__((target("pclmul,sse2"))) inline uint64_t prefixXorClmul(uint64_t bits) {
+    __m128i value = _mm_set_epi64x(0, static_cast<long long>(bits));
+    __m128i ones = _mm_set1_epi8(static_cast<char>(0xff));
+    return static_cast<uint64_t>(_mm_cvtsi128_si64(_mm_clmulepi64_si128(value, ones, 0)));
+}
+
+inline bool cpuHasClmul() {
+    static const bool has = __builtin_cpu_supports("pclmul");
+    return has;
+}
+#endif
+
+// Bit i set when byte i is inside quotes, given the quote positions of the block.
+inline uint64_t prefixXor(uint64_t bits) {
+#ifdef QP_HAVE_X86_SIMD
+    if (cpuHasClmul()) return prefixXorClmul(bits);
+#endif
+    return prefixXorPortable(bits);
+}
+
+// Quote and comma bitmasks of 64 bytes.
+inline void classifyBlock(const char* p, uint64_t& quotes, uint64_t& commas) {
+#ifdef QP_HAVE_X86_SIMD
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i comma = _mm_set1_epi8(',');
+    quotes = commas = 0;
+    for (int k = 0; k < 4; ++k) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * k));
+        quotes |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)))) << (16 * k);
+        commas |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, comma)))) << (16 * k);
+    }
+#else
+    quotes = commas = 0;
+    for (int i = 0; i < 64; ++i) {
+        quotes |= static_cast<uint64_t>(p[i] == '"') << i;
+        commas |= static_cast<uint64_t>(p[i] == ',') << i;
+    }
+#endif
+}
+
+// Whether the quote at line[i] delimits a quoted field, given whether a quoted field is
+// open and where the last one closed. Inside a field a quote closes it; outside, it opens
+// one at the start of a field or right after a closing quote (the "" escape), and is a
+// literal character anywhere else.
+inline bool delimitingQuote(const char* line, size_t i, bool& open, size_t& lastClose) {
+    if (open) {
+        open = false;
+        lastClose = i;
+        return true;
+    }
+    if (i == 0 || line[i - 1] == ',' || lastClose + 1 == i) {
+        open = true;
+        return true;
+    }
+    return false;
+}
+
+// The quotes of a 64-byte block starting at line[base] that delimit quoted fields.
+inline uint64_t delimitingQuotes(const char* line, size_t base, uint64_t quotes, bool& open, size_t& lastClose) {
+    uint64_t kept = 0;
+    while (quotes) {
+        int bit = __builtin_ctzll(quotes);
+        if (delimitingQuote(line, base + static_cast<size_t>(bit), open, lastClose)) kept |= uint64_t(1) << bit;
+        quotes &= quotes - 1;
+    }
+    return kept;
+}
+
+// Whether n bytes of CSV end inside a quoted field, given whether they start inside one.
+inline bool endsInsideQuotes(const char* data, size_t n, bool open) {
+    const char* end = data + n;
+    size_t lastClose = SIZE_MAX;
+    for (const char* p = static_cast<const char*>(std::memchr(data, '"', n)); p;
+         p = static_cast<const char*>(std::memchr(p + 1, '"', static_cast<size_t>(end - p - 1)))) {
+        delimitingQuote(data, static_cast<size_t>(p - data), open, lastClose);
+    }
+    return open;
+}
+
+} // namespace csv_detail
+
+// Calls field(begin, end) for each field of a CSV line, i.e. the ranges between commas
+// that are not inside quotes. Stops early when field returns false.
+template <typename FieldFn>
+inline void forEachCsvField(const std::string& line, FieldFn field) {
+    const size_t n = line.size();
+    size_t start = 0;
+    uint64_t carry = 0; // All ones while the previous block ended inside quotes
+    bool open = false;
+    size_t lastClose = SIZE_MAX;
+    char tail[64];
+    for (size_t base = 0; base < n; base += 64) {
+        const char* block = line.data() + base;
+        if (n - base < 64) {
+            std::memset(tail, 0, sizeof(tail));
+            std::memcpy(tail, block, n - base);
+            block = tail;
+        }
+        uint64_t quotes, commas;
+        csv_detail::classifyBlock(block, quotes, commas);
+        if (quotes) quotes = csv_detail::delimitingQuotes(line.data(), base, quotes, open, lastClose);
+        uint64_t inside = quotes ? csv_detail::prefixXor(quotes) ^ carry : carry;
+        carry = static_cast<uint64_t>(static_cast<int64_t>(inside) >> 63);
+        uint64_t separators = commas & ~inside;
+        while (separators) {
+            size_t i = base + static_cast<size_t>(__builtin_ctzll(separators));
+            if (!field(start, i)) return;
+            start = i + 1;
+            separators &= separators - 1;
+        }
+    }
+    field(start, n);
+}
+
+// The value of a quoted field: the text between the outer quotes with "" turned into ".
+inline std::string unquoteCsvField(const char* begin, const char* end) {
+    std::string out;
+    const char* close = end;
+    if (end - begin >= 2 && end[-1] == '"') close = end - 1;
+    out.reserve(static_cast<size_t>(close - begin));
+    for (const char* p = begin + 1; p < close; ++p) {
+        out.push_back(*p);
+        if (*p == '"' && p + 1 < close && p[1] == '"') ++p;
+    }
+    return out;
+}
+
+// Whether a line ends inside a quoted field, i.e. the record continues on the next line.
+inline bool csvQuoteOpen(const std::string& line) {
+    return csv_detail::endsInsideQuotes(line.data(), line.size(), false);
+}
+
+// Reported by the line readers when a record is dropped after kMaxCsvRecordLines lines.
+inline void warnUnterminatedCsvRecord() {
+    std::cerr << "Warning: Quoted field still open after " << kMaxCsvRecordLines << " lines. Skipping record." << std::endl;
+}
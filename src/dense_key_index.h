@@ -0,0 +1,95 @@
+#pragma once
+
+#include "types.h"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+/*
+    Direct-indexed join table for integer keys. Keys like customer_id or order_id are
+    usually dense integers starting at 1, so instead of hashing them the build side is laid
+    out by key: a presence bitmap with one bit per key in [min, max], and an offset array
+    (CSR layout) pointing at the build tuples with that key, stored contiguously. A probe is
+    a bounds check, a bit test and two loads.
+
+    HashJoinOperator uses this when every build key is an INT and the key range is at most
+    kMaxSpread times the number of build rows; otherwise it falls back to hashing.
+*/
+
+class DenseKeyIndex {
+public:
+    static constexpr size_t kMaxSpread = 4;   // Allowed key range per build row
+    static constexpr size_t kMinRange = 1024; // Small tables are always dense enough
+
+    // Checks whether the keys qualify and, if so, takes the tuples. Returns false (leaving
+    // the tuples untouched) when a key is not an int or the range is too sparse.
+    bool build(const std::vector<Value>& keys, std::vector<Tuple>& tuples) {
+        clear();
+        if (keys.empty()) return false;
+        int64_t lo = std::numeric_limits<int64_t>::max();
+        int64_t hi = std::numeric_limits<int64_t>::min();
+        for (const auto& key : keys) {
+            if (!std::holds_alternative<int>(key)) return false;
+            int64_t k = std::get<int>(key);
+            lo = std::min(lo, k);
+            hi = std::max(hi, k);
+        }
+        uint64_t range = static_cast<uint64_t>(hi - lo) + 1;
+        if (range > std::max<uint64_t>(kMinRange, kMaxSpread * keys.size())) return false;
+
+        // Counting sort of the tuples by key.
+        min_ = lo;
+        range_ = static_cast<size_t>(range);
+        offsets_.assign(range_ + 1, 0);
+        present_.assign((range_ + 63) / 64, 0);
+        for (const auto& key : keys) {
+            size_t slot = static_cast<size_t>(std::get<int>(key) - min_);
+            offsets_[slot + 1]++;
+            present_[slot / 64] |= uint64_t(1) << (slot % 64);
+        }
+        for (size_t i = 0; i < range_; ++i) offsets_[i + 1] += offsets_[i];
+
+        std::vector<uint32_t> cursor(offsets_.begin(), offsets_.end() - 1);
+        rows_.resize(tuples.size());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            size_t slot = static_cast<size_t>(std::get<int>(keys[i]) - min_);
+            rows_[cursor[slot]++] = std::move(tuples[i]);
+        }
+        tuples.clear();
+        built_ = true;
+        return true;
+    }
+
+    bool built() const { return built_; }
+
+    // Sets rows [first, last) to the build tuples matching the key (empty when there are none).
+    void lookup(const Value& key, uint32_t& first, uint32_t& last) const {
+        first = last = 0;
+        if (!std::holds_alternative<int>(key)) return; // Never equal to an INT key
+        int64_t k = static_cast<int64_t>(std::get<int>(key)) - min_;
+        if (k < 0 || static_cast<uint64_t>(k) >= range_) return;
+        size_t slot = static_cast<size_t>(k);
+        if (!(present_[slot / 64] & (uint64_t(1) << (slot % 64)))) return;
+        first = offsets_[slot];
+        last = offsets_[slot + 1];
+    }
+
+    const Tuple& row(uint32_t index) const { return rows_[index]; }
+
+    void clear() {
+        built_ = false;
+        rows_.clear();
+        offsets_.clear();
+        present_.clear();
+        range_ = 0;
+    }
+
+private:
+    bool built_ = false;
+    int64_t min_ = 0;
+    size_t range_ = 0;
+    std::vector<uint64_t> present_; // One bit per key in [min, min + range)
+    std::vector<uint32_t> offsets_; // rows_[offsets_[k] .. offsets_[k + 1]) have key min + k
+    std::vector<Tuple> rows_;
+};
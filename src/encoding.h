@@ -0,0 +1,413 @@
+#pragma once
+
+#include "types.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define QP_HAVE_AVX2_UNPACK 1
+#endif
+
+/*
+    Lightweight compression for the columnar table cache. Every column is cut into blocks
+    (kZoneBlockRows rows) and each block picks whichever encoding is smallest for its data:
+
+      - PLAIN        values as-is
+      - RLE          (value, run end) pairs, for columns like order_year or status
+      - BITPACK_FOR  frame of reference: value - min, packed into the fewest bits
+      - DELTA        sorted keys: differences between neighbours, bit-packed, with an
+                     absolute checkpoint every kDeltaCheckpoint values for random access
+      - DICTIONARY   strings: a sorted per-block dictionary plus integer codes, and the
+                     codes themselves are an IntBlock (so they can be RLE or bit-packed)
+
+    Blocks are decoded a whole block at a time into plain arrays for scanning. The bit
+    unpacking loop has an AVX2 version (picked at runtime) and a scalar fallback. Simple
+    "column <op> constant" predicates can also be evaluated straight on the encoded data
+    (per run for RLE, in the packed domain for frame-of-reference, on codes for
+    dictionaries) to build a selection vector.
+*/
+
+enum class Encoding : uint8_t { PLAIN, RLE, BITPACK_FOR, DELTA, DICTIONARY };
+
+inline const char* encodingName(Encoding enc) {
+    switch (enc) {
+        case Encoding::PLAIN: return "plain";
+        case Encoding::RLE: return "rle";
+        case Encoding::BITPACK_FOR: return "bitpack";
+        case Encoding::DELTA: return "delta";
+        case Encoding::DICTIONARY: return "dictionary";
+    }
+    return "unknown";
+}
+
+// Comparison operators a block can evaluate on its own, parsed once from the plan's op string.
+enum class CmpOp { EQ, NEQ, LT, LTE, GT, GTE };
+
+inline bool parseCmpOp(const std::string& op, CmpOp& out) {
+    if (op == "EQ") out = CmpOp::EQ;
+    else if (op == "NEQ") out = CmpOp::NEQ;
+    else if (op == "LT") out = CmpOp::LT;
+    else if (op == "LTE") out = CmpOp::LTE;
+    else if (op == "GT") out = CmpOp::GT;
+    else if (op == "GTE") out = CmpOp::GTE;
+    else return false;
+    return true;
+}
+
+template <typename T, typename C>
+inline bool compareValues(CmpOp op, T v, C c) {
+    switch (op) {
+        case CmpOp::EQ: return v == c;
+        case CmpOp::NEQ: return v != c;
+        case CmpOp::LT: return v < c;
+        case CmpOp::LTE: return v <= c;
+        case CmpOp::GT: return v > c;
+        case CmpOp::GTE: return v >= c;
+    }
+    return true;
+}
+
+// sel[i] &= (vals[i] <op> c). One tight loop per operator so the compiler can vectorize it.
+template <typename T, typename C>
+inline void filterArray(const T* vals, size_t n, CmpOp op, C c, uint8_t* sel) {
+    switch (op) {
+        case CmpOp::EQ:  for (size_t i = 0; i < n; ++i) sel[i] &= static_cast<uint8_t>(vals[i] == c); break;
+        case CmpOp::NEQ: for (size_t i = 0; i < n; ++i) sel[i] &= static_cast<uint8_t>(vals[i] != c); break;
+        case CmpOp::LT:  for (size_t i = 0; i < n; ++i) sel[i] &= static_cast<uint8_t>(vals[i] < c); break;
+        case CmpOp::LTE: for (size_t i = 0; i < n; ++i) sel[i] &= static_cast<uint8_t>(vals[i] <= c); break;
+        case CmpOp::GT:  for (size_t i = 0; i < n; ++i) sel[i] &= static_cast<uint8_t>(vals[i] > c); break;
+        case CmpOp::GTE: for (size_t i = 0; i < n; ++i) sel[i] &= static_cast<uint8_t>(vals[i] >= c); break;
+    }
+}
+
+// --- Bit packing ---
+
+inline unsigned bitsNeeded(uint32_t maxValue) {
+    unsigned bits = 0;
+    while (bits < 32 && (maxValue >> bits) != 0) bits++;
+    return bits;
+}
+
+// Packs n values of `bits` bits each, little-endian bit order. The buffer is padded with 8
+// spare bytes so the unpackers can always do unaligned 64-bit (or 32-bit) loads.
+inline std::vector<uint8_t> packBits(const uint32_t* vals, size_t n, unsigned bits) {
+    std::vector<uint8_t> out((n * bits + 7) / 8 + 8, 0);
+    if (bits == 0) return out;
+    for (size_t i = 0; i < n; ++i) {
+        size_t bitPos = i * bits;
+        uint64_t word;
+        std::memcpy(&word, &out[bitPos / 8], sizeof(word));
+        word |= static_cast<uint64_t>(vals[i]) << (bitPos % 8);
+        std::memcpy(&out[bitPos / 8], &word, sizeof(word));
+    }
+    return out;
+}
+
+inline uint32_t unpackOne(const uint8_t* data, unsigned bits, size_t i) {
+    if (bits == 0) return 0;
+    size_t bitPos = i * bits;
+    uint64_t word;
+    std::memcpy(&word, data + bitPos / 8, sizeof(word));
+    uint64_t mask = (bits == 32) ? 0xFFFFFFFFULL : ((1ULL << bits) - 1);
+    return static_cast<uint32_t>((word >> (bitPos % 8)) & mask);
+}
+
+inline void unpackBitsScalar(const uint8_t* data, unsigned bits, size_t n, uint32_t* out) {
+    if (bits == 0) {
+        std::fill(out, out + n, 0u);
+        return;
+    }
+    const uint64_t mask = (bits == 32) ? 0xFFFFFFFFULL : ((1ULL << bits) - 1);
+    for (size_t i = 0; i < n; ++i) {
+        size_t bitPos = i * bits;
+        uint64_t word;
+        std::memcpy(&word, data + bitPos / 8, sizeof(word));
+        out[i] = static_cast<uint32_t>((word >> (bitPos % 8)) & mask);
+    }
+}
+
+#ifdef QP_HAVE_AVX2_UNPACK
+// Unpacks 8 values per iteration: gather the 32-bit word holding each value, shift each
+// lane by its own bit offset and mask. Works for widths up to 25 bits (offset + width <= 32).
+__attribute__((target("avx2")))
+inline void unpackBitsAvx2(const uint8_t* data, unsigned bits, size_t n, uint32_t* out) {
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i mask = _mm256_set1_epi32(static_cast<int>((1u << bits) - 1));
+    const __m256i seven = _mm256_set1_epi32(7);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i bitPos = _mm256_mullo_epi32(_mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(i)), lane),
+                                            _mm256_set1_epi32(static_cast<int>(bits)));
+        __m256i byteOffset = _mm256_srli_epi32(bitPos, 3);
+        __m256i shift = _mm256_and_si256(bitPos, seven);
+        __m256i words = _mm256_i32gather_epi32(reinterpret_cast<const int*>(data), byteOffset, 1);
+        __m256i vals = _mm256_and_si256(_mm256_srlv_epi32(words, shift), mask);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), vals);
+    }
+    for (; i < n; ++i) out[i] = unpackOne(data, bits, i);
+}
+
+inline bool cpuHasAvx2() {
+    static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+    return hasAvx2;
+}
+#endif
+
+inline void unpackBits(const uint8_t* data, unsigned bits, size_t n, uint32_t* out) {
+#ifdef QP_HAVE_AVX2_UNPACK
+    // The bit positions are computed in 32-bit lanes, so very large blocks use the scalar path.
+    if (bits > 0 && bits <= 25 && n * bits < (size_t(1) << 31) && cpuHasAvx2()) {
+        unpackBitsAvx2(data, bits, n, out);
+        return;
+    }
+#endif
+    unpackBitsScalar(data, bits, n, out);
+}
+
+// --- Integer blocks (INT, BOOL and dictionary codes) ---
+
+constexpr size_t kDeltaCheckpoint = 64;
+
+class IntBlock {
+public:
+    // Picks the smallest encoding for these values.
+    static IntBlock encode(const int32_t* vals, size_t n) {
+        IntBlock block;
+        block.count_ = n;
+        if (n == 0) return block;
+
+        int64_t lo = *std::min_element(vals, vals + n);
+        int64_t hi = *std::max_element(vals, vals + n);
+        size_t runs = 1;
+        bool sorted = true;
+        int64_t maxDelta = 0;
+        for (size_t i = 1; i < n; ++i) {
+            if (vals[i] != vals[i - 1]) runs++;
+            if (vals[i] < vals[i - 1]) sorted = false;
+            else maxDelta = std::max<int64_t>(maxDelta, int64_t(vals[i]) - vals[i - 1]);
+        }
+
+        unsigned forBits = bitsNeeded(static_cast<uint32_t>(hi - lo));
+        size_t plainBytes = n * sizeof(int32_t);
+        size_t rleBytes = runs * (sizeof(int32_t) + sizeof(uint32_t));
+        size_t forBytes = (n * forBits + 7) / 8;
+        unsigned deltaBits = bitsNeeded(static_cast<uint32_t>(std::min<int64_t>(maxDelta, 0xFFFFFFFFLL)));
+        size_t deltaBytes = sorted ? (n * deltaBits + 7) / 8 + (n / kDeltaCheckpoint + 1) * sizeof(int32_t) : SIZE_MAX;
+
+        size_t best = std::min({plainBytes, rleBytes, forBytes, deltaBytes});
+        std::vector<uint32_t> tmp(n);
+        if (best == plainBytes) {
+            block.encoding_ = Encoding::PLAIN;
+            block.plain_.assign(vals, vals + n);
+        } else if (best == rleBytes) {
+            block.encoding_ = Encoding::RLE;
+            for (size_t i = 0; i < n; ++i) {
+                if (i == 0 || vals[i] != vals[i - 1]) {
+                    block.runValues_.push_back(vals[i]);
+                    block.runEnds_.push_back(static_cast<uint32_t>(i + 1));
+                } else {
+                    block.runEnds_.back() = static_cast<uint32_t>(i + 1);
+                }
+            }
+        } else if (best == forBytes) {
+            block.encoding_ = Encoding::BITPACK_FOR;
+            block.base_ = static_cast<int32_t>(lo);
+            block.bits_ = forBits;
+            for (size_t i = 0; i < n; ++i) tmp[i] = static_cast<uint32_t>(int64_t(vals[i]) - lo);
+            block.packed_ = packBits(tmp.data(), n, forBits);
+        } else {
+            block.encoding_ = Encoding::DELTA;
+            block.bits_ = deltaBits;
+            tmp[0] = 0;
+            for (size_t i = 1; i < n; ++i) tmp[i] = static_cast<uint32_t>(int64_t(vals[i]) - vals[i - 1]);
+            for (size_t i = 0; i < n; i += kDeltaCheckpoint) block.checkpoints_.push_back(vals[i]);
+            block.packed_ = packBits(tmp.data(), n, deltaBits);
+        }
+        return block;
+    }
+
+    size_t size() const { return count_; }
+    Encoding encoding() const { return encoding_; }
+
+    void decode(int32_t* out) const {
+        switch (encoding_) {
+            case Encoding::PLAIN:
+                std::copy(plain_.begin(), plain_.end(), out);
+                break;
+            case Encoding::RLE: {
+                size_t start = 0;
+                for (size_t r = 0; r < runValues_.size(); ++r) {
+                    std::fill(out + start, out + runEnds_[r], runValues_[r]);
+                    start = runEnds_[r];
+                }
+                break;
+            }
+            case Encoding::BITPACK_FOR: {
+                uint32_t* raw = reinterpret_cast<uint32_t*>(out);
+                unpackBits(packed_.data(), bits_, count_, raw);
+                for (size_t i = 0; i < count_; ++i) out[i] = static_cast<int32_t>(raw[i] + static_cast<uint32_t>(base_));
+                break;
+            }
+            case Encoding::DELTA: {
+                uint32_t* raw = reinterpret_cast<uint32_t*>(out);
+                unpackBits(packed_.data(), bits_, count_, raw);
+                int32_t running = 0;
+                for (size_t i = 0; i < count_; ++i) {
+                    running = (i % kDeltaCheckpoint == 0) ? checkpoints_[i / kDeltaCheckpoint]
+                                                         : static_cast<int32_t>(running + raw[i]);
+                    out[i] = running;
+                }
+                break;
+            }
+            case Encoding::DICTIONARY:
+                break; // Not used for integer blocks.
+        }
+    }
+
+    int32_t get(size_t i) const {
+        switch (encoding_) {
+            case Encoding::PLAIN: return plain_[i];
+            case Encoding::RLE: {
+                auto it = std::upper_bound(runEnds_.begin(), runEnds_.end(), static_cast<uint32_t>(i));
+                return runValues_[it - runEnds_.begin()];
+            }
+            case Encoding::BITPACK_FOR: return static_cast<int32_t>(unpackOne(packed_.data(), bits_, i) + static_cast<uint32_t>(base_));
+            case Encoding::DELTA: {
+                size_t cp = i / kDeltaCheckpoint;
+                int32_t v = checkpoints_[cp];
+                for (size_t j = cp * kDeltaCheckpoint + 1; j <= i; ++j) v += static_cast<int32_t>(unpackOne(packed_.data(), bits_, j));
+                return v;
+            }
+            case Encoding::DICTIONARY: break;
+        }
+        return 0;
+    }
+
+    // sel[i] &= (value[i] <op> c), evaluated on the encoded form where that is cheaper.
+    // `scratch` must hold at least size() entries.
+    void filter(CmpOp op, double c, uint8_t* sel, int32_t* scratch) const {
+        if (encoding_ == Encoding::RLE) {
+            // One comparison per run instead of per row.
+            size_t start = 0;
+            for (size_t r = 0; r < runValues_.size(); ++r) {
+                if (!compareValues(op, static_cast<double>(runValues_[r]), c)) {
+                    std::fill(sel + start, sel + runEnds_[r], 0);
+                }
+                start = runEnds_[r];
+            }
+            return;
+        }
+        if (encoding_ == Encoding::BITPACK_FOR) {
+            // Compare in the packed domain: value <op> c  <=>  (value - base) <op> (c - base).
+            uint32_t* raw = reinterpret_cast<uint32_t*>(scratch);
+            unpackBits(packed_.data(), bits_, count_, raw);
+            filterArray(raw, count_, op, static_cast<double>(c - base_), sel);
+            return;
+        }
+        decode(scratch);
+        filterArray(scratch, count_, op, c, sel);
+    }
+
+    size_t memoryBytes() const {
+        return sizeof(IntBlock) + plain_.capacity() * sizeof(int32_t) + packed_.capacity() +
+               runValues_.capacity() * sizeof(int32_t) + runEnds_.capacity() * sizeof(uint32_t) +
+               checkpoints_.capacity() * sizeof(int32_t);
+    }
+
+private:
+    Encoding encoding_ = Encoding::PLAIN;
+    size_t count_ = 0;
+    int32_t base_ = 0;
+    unsigned bits_ = 0;
+    std::vector<int32_t> plain_;
+    std::vector<uint8_t> packed_;      // BITPACK_FOR and DELTA
+    std::vector<int32_t> runValues_;   // RLE
+    std::vector<uint32_t> runEnds_;    // RLE, exclusive end row of each run
+    std::vector<int32_t> checkpoints_; // DELTA
+};
+
+// --- String blocks ---
+
+class StringBlock {
+public:
+    static StringBlock encode(const std::string* vals, size_t n) {
+        StringBlock block;
+        block.count_ = n;
+        std::vector<std::string> dict(vals, vals + n);
+        std::sort(dict.begin(), dict.end());
+        dict.erase(std::unique(dict.begin(), dict.end()), dict.end());
+
+        size_t plainBytes = 0, dictBytes = 0;
+        for (size_t i = 0; i < n; ++i) plainBytes += sizeof(std::string) + vals[i].size();
+        for (const auto& s : dict) dictBytes += sizeof(std::string) + s.size();
+        dictBytes += n * bitsNeeded(static_cast<uint32_t>(dict.size())) / 8;
+
+        if (dictBytes < plainBytes) {
+            block.encoding_ = Encoding::DICTIONARY;
+            std::vector<int32_t> codes(n);
+            for (size_t i = 0; i < n; ++i) {
+                codes[i] = static_cast<int32_t>(std::lower_bound(dict.begin(), dict.end(), vals[i]) - dict.begin());
+            }
+            block.dictionary_ = std::move(dict);
+            block.codes_ = IntBlock::encode(codes.data(), n);
+        } else {
+            block.encoding_ = Encoding::PLAIN;
+            block.plain_.assign(vals, vals + n);
+        }
+        return block;
+    }
+
+    size_t size() const { return count_; }
+    Encoding encoding() const { return encoding_; }
+
+    // Dictionary blocks decode to codes plus a pointer to the dictionary; plain blocks just
+    // expose their strings (codes are then the row numbers).
+    const std::vector<std::string>& strings() const { return encoding_ == Encoding::DICTIONARY ? dictionary_ : plain_; }
+    void decodeCodes(int32_t* out) const {
+        if (encoding_ == Encoding::DICTIONARY) {
+            codes_.decode(out);
+        } else {
+            for (size_t i = 0; i < count_; ++i) out[i] = static_cast<int32_t>(i);
+        }
+    }
+
+    const std::string& get(size_t i) const {
+        return encoding_ == Encoding::DICTIONARY ? dictionary_[codes_.get(i)] : plain_[i];
+    }
+
+    // Equality predicates on dictionary blocks are answered on the codes: the constant is
+    // looked up once and rows are compared as integers. Returns false if it could not filter.
+    bool filter(CmpOp op, const std::string& c, uint8_t* sel, int32_t* scratch) const {
+        if (op != CmpOp::EQ && op != CmpOp::NEQ) return false; // Ordering on strings isn't supported
+        if (encoding_ == Encoding::DICTIONARY) {
+            auto it = std::lower_bound(dictionary_.begin(), dictionary_.end(), c);
+            bool present = it != dictionary_.end() && *it == c;
+            if (!present) {
+                if (op == CmpOp::EQ) std::fill(sel, sel + count_, 0);
+                return true;
+            }
+            codes_.filter(op, static_cast<double>(it - dictionary_.begin()), sel, scratch);
+            return true;
+        }
+        for (size_t i = 0; i < count_; ++i) sel[i] &= static_cast<uint8_t>(compareValues(op, plain_[i], c));
+        return true;
+    }
+
+    size_t memoryBytes() const {
+        size_t bytes = sizeof(StringBlock) + codes_.memoryBytes();
+        for (const auto& s : dictionary_) bytes += sizeof(std::string) + (s.size() > 15 ? s.capacity() : 0);
+        for (const auto& s : plain_) bytes += sizeof(std::string) + (s.size() > 15 ? s.capacity() : 0);
+        return bytes;
+    }
+
+private:
+    Encoding encoding_ = Encoding::PLAIN;
+    size_t count_ = 0;
+    std::vector<std::string> dictionary_; // Sorted, so codes keep the strings' order
+    IntBlock codes_;
+    std::vector<std::string> plain_;
+};
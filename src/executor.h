@@ -0,0 +1,91 @@
+#pragma once
+
+#include "plan_parser.h"
+#include <chrono>
+#include <ostream>
+
+/*
+    Helpers for running a whole plan and collecting its output. The single-query
+    command line prints tuples as they are produced; the server and batch modes
+    instead need the full result as an object they can serialize or store.
+*/
+
+struct QueryResult {
+    Schema schema;
+    std::vector<Tuple> rows;
+    double elapsedMs = 0.0;
+};
+
+// Drives an already built operator tree through open/next/close and gathers every tuple.
+inline QueryResult runOperator(Operator& root) {
+    auto start = std::chrono::steady_clock::now();
+    QueryResult result;
+    root.open();
+    Tuple tuple;
+    while (root.next(tuple)) {
+        result.rows.push_back(tuple);
+    }
+    root.close();
+    result.schema = root.getSchema();
+    result.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+// Builds the operator tree for a JSON plan and runs it to completion.
+inline QueryResult executePlan(const json& planJson, Catalog& catalog, const std::string& dataDir) {
+    auto start = std::chrono::steady_clock::now();
+    auto root = parsePlan(planJson, catalog, dataDir);
+    QueryResult result = runOperator(*root);
+    result.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+inline json valueToJson(const Value& val) {
+    if (std::holds_alternative<float>(val)) {
+        // Round-trip floats through the same text form std::cout uses, otherwise
+        // 373.95f would be serialized as 373.95001220703125.
+        std::ostringstream ss;
+        ss << std::get<float>(val);
+        return std::stod(ss.str());
+    }
+    return std::visit([](auto&& arg) -> json {
+        if constexpr (std::is_same_v<std::decay_t<decltype(arg)>, std::monostate>) return nullptr;
+        else return arg;
+    }, val);
+}
+
+// Serializes a result as {"columns": [...], "rows": [[...], ...], "row_count": n}.
+inline json rowToJson(const Tuple& row) {
+    json out = json::array();
+    for (const auto& val : row) out.push_back(valueToJson(val));
+    return out;
+}
+
+inline json resultToJson(const QueryResult& result) {
+    json out;
+    out["columns"] = json::array();
+    for (const auto& col : result.schema.getColumns()) {
+        out["columns"].push_back(col.name);
+    }
+    out["rows"] = json::array();
+    for (const auto& row : result.rows) out["rows"].push_back(rowToJson(row));
+    out["row_count"] = result.rows.size();
+    out["elapsed_ms"] = result.elapsedMs;
+    return out;
+}
+
+// Prints a result in the same "col: value | col: value" layout main() uses.
+inline void printResult(const QueryResult& result, std::ostream& out) {
+    const auto& cols = result.schema.getColumns();
+    out << "--- Query Results ---\n";
+    for (const auto& row : result.rows) {
+        for (size_t i = 0; i < row.size(); ++i) {
+            out << cols[i].name << ": ";
+            writeValue(out, row[i]);
+            if (i < row.size() - 1) out << " | ";
+        }
+        out << "\n";
+    }
+    out << "---------------------\n";
+    out << "Returned " << result.rows.size() << " rows.\n";
+}
@@ -5,6 +5,7 @@
 #include <memory>   // For std::unique_ptr
 #include <stdexcept>
 #include <set>
+#include <map>
 
 // Abstract base class for all expressions.
 class Expression {
@@ -17,6 +18,10 @@ public:
     
     virtual void collectColumnRefs(std::set<std::string>& columns) const = 0;
 
+    // True for expressions whose value does not depend on the tuple (constants and bound
+    // parameters). Scans use this to recognize "column <op> constant" predicates.
+    virtual bool isConstant() const { return false; }
+
 };
 
 // --- LEAF EXPRESSIONS (the end points of the tree) ---
@@ -33,10 +38,67 @@ public:
     // Evaluating a constant is easy: just return it.
     Value evaluate(const Tuple&, const Schema&) const override { return value_; }
 
+    bool isConstant() const override { return true; }
+
 private:
     Value value_;
 };
 
+// --- PARAMETERS (placeholders in prepared plans) ---
+
+// The current value of one named parameter. All placeholders with the same name in a
+// plan share one slot, so binding a value once updates every use of it.
+struct ParameterSlot {
+    std::string name;
+    DataType type;
+    Value value;
+    bool bound = false;
+};
+
+// All parameters declared by one parsed plan, by name.
+class ParameterSet {
+public:
+    // Returns the slot for a parameter, creating it on first use.
+    std::shared_ptr<ParameterSlot> declare(const std::string& name, DataType type) {
+        auto& slot = slots_[name];
+        if (!slot) {
+            slot = std::make_shared<ParameterSlot>();
+            slot->name = name;
+            slot->type = type;
+        } else if (slot->type != type) {
+            throw std::runtime_error("Parameter '" + name + "' is declared with two different types.");
+        }
+        return slot;
+    }
+
+    const std::map<std::string, std::shared_ptr<ParameterSlot>>& slots() const { return slots_; }
+
+private:
+    std::map<std::string, std::shared_ptr<ParameterSlot>> slots_;
+};
+
+// Represents a parameter placeholder (e.g., {"param": "year", "type": "int"}).
+class ParameterExpression : public Expression {
+public:
+    explicit ParameterExpression(std::shared_ptr<ParameterSlot> slot) : slot_(std::move(slot)) {}
+
+    Value evaluate(const Tuple&, const Schema&) const override {
+        if (!slot_->bound) {
+            throw std::runtime_error("No value bound for parameter '" + slot_->name + "'.");
+        }
+        return slot_->value;
+    }
+
+    void collectColumnRefs(std::set<std::string>&) const override {
+        // Like a constant, a parameter doesn't refer to any column.
+    }
+
+    bool isConstant() const override { return true; }
+
+private:
+    std::shared_ptr<ParameterSlot> slot_;
+};
+
 // Represents a reference to a column (e.g., "c.balance").
 class ColumnRefExpression : public Expression {
 public:
@@ -75,6 +137,30 @@ inline double to_double(const Value& v) {
     return static_cast<double>(std::get<float>(v));
 }
 
+// SQL three-valued AND / OR on (value, valid) pairs, where valid == 0 means NULL. Written
+// with bit operations only, so the same code works on single flags (below) and on 64-row
+// words of a value bitmap plus a validity bitmap (BlockFilter, block_filter.h), without
+// branching per row.
+//   AND is FALSE if either side is a valid FALSE, TRUE if both are TRUE, else NULL.
+//   OR is TRUE if either side is a valid TRUE, FALSE if both are FALSE, else NULL.
+template <typename Bits>
+inline Bits kleeneAnd(Bits lv, Bits lvalid, Bits rv, Bits rvalid, Bits& valid) {
+    valid = (lvalid & rvalid) | (lvalid & ~lv) | (rvalid & ~rv);
+    return lv & rv & lvalid & rvalid;
+}
+
+template <typename Bits>
+inline Bits kleeneOr(Bits lv, Bits lvalid, Bits rv, Bits rvalid, Bits& valid) {
+    valid = (lvalid & rvalid) | (lvalid & lv) | (rvalid & rv);
+    return (lv & lvalid) | (rv & rvalid);
+}
+
+// A predicate lets a row through only when it is TRUE. NULL (unknown) rejects it like FALSE.
+inline bool isTrue(const Value& v) {
+    const bool* b = std::get_if<bool>(&v);
+    return b && *b;
+}
+
 class BinaryExpression : public Expression {
 public:
     BinaryExpression(std::string op, std::unique_ptr<Expression> left, std::unique_ptr<Expression> right)
@@ -84,6 +170,22 @@ public:
     Value leftVal = left_->evaluate(tuple, schema);
     Value rightVal = right_->evaluate(tuple, schema);
 
+    // --- Handle Logical Operations (three-valued, see kleeneAnd / kleeneOr) ---
+    if (op_ == "AND" || op_ == "OR") {
+        unsigned lvalid = !isNull(leftVal), rvalid = !isNull(rightVal);
+        if ((lvalid && !std::holds_alternative<bool>(leftVal)) || (rvalid && !std::holds_alternative<bool>(rightVal))) {
+            throw std::runtime_error("Logical operator on non-boolean value: " + op_);
+        }
+        unsigned lv = lvalid && std::get<bool>(leftVal), rv = rvalid && std::get<bool>(rightVal);
+        unsigned valid;
+        unsigned result = (op_ == "AND") ? kleeneAnd(lv, lvalid, rv, rvalid, valid) : kleeneOr(lv, lvalid, rv, rvalid, valid);
+        if (!(valid & 1)) return nullValue();
+        return (result & 1) != 0;
+    }
+
+    // Arithmetic and comparisons with a NULL operand are NULL.
+    if (isNull(leftVal) || isNull(rightVal)) return nullValue();
+
     // --- Handle Arithmetic Operations ---
     if (op_ == "ADD" || op_ == "SUB" || op_ == "MUL" || op_ == "DIV") {
         if (!is_numeric(leftVal) || !is_numeric(rightVal)) {
@@ -127,6 +229,10 @@ public:
         right_->collectColumnRefs(columns);
     }
 
+    const std::string& getOp() const { return op_; }
+    const Expression& getLeft() const { return *left_; }
+    const Expression& getRight() const { return *right_; }
+
 
 private:
     std::string op_;
@@ -141,12 +247,35 @@ public:
     
     Value evaluate(const Tuple& tuple, const Schema& schema) const override {
         Value val = expr_->evaluate(tuple, schema);
+        if (isNull(val)) return val; // NOT NULL is NULL
         return !std::get<bool>(val);
     }
     void collectColumnRefs(std::set<std::string>& columns) const override {
         expr_->collectColumnRefs(columns);
     }
 
+    const Expression& getExpr() const { return *expr_; }
+
 private:
     std::unique_ptr<Expression> expr_;
-};
\ No newline at end of file
+};
+
+// IS NULL / IS NOT NULL. Unlike comparisons these are never NULL themselves.
+class NullTestExpression : public Expression {
+public:
+    NullTestExpression(std::unique_ptr<Expression> expr, bool negated) : expr_(std::move(expr)), negated_(negated) {}
+
+    Value evaluate(const Tuple& tuple, const Schema& schema) const override {
+        return isNull(expr_->evaluate(tuple, schema)) != negated_;
+    }
+    void collectColumnRefs(std::set<std::string>& columns) const override {
+        expr_->collectColumnRefs(columns);
+    }
+
+    const Expression& getExpr() const { return *expr_; }
+    bool isNegated() const { return negated_; }
+
+private:
+    std::unique_ptr<Expression> expr_;
+    bool negated_; // IS NOT NULL
+};
@@ -0,0 +1,476 @@
+#pragma once
+
+#include "operator.h"
+#include <memory>
+#include <type_traits>
+
+/*
+    Compile-time fused pipelines for the two plan shapes most fixed, frequently-run queries
+    come down to:
+
+        Project(Select*(Scan))                              scan -> filter -> project
+        Project(Select*(HashJoin(Select*(Scan), build)))    scan -> filter -> probe -> project
+
+    Interpreted, every row goes through a virtual next() per operator and every predicate
+    walks an Expression tree of Values and compares op strings. Here the filter is a functor
+    composed from templates instead: a typed column accessor, a comparison whose operator
+    is a template argument, and the conjunction of two of them. The loop reading rows from
+    the scan (called non-virtually), testing them and copying the projected columns is one
+    template instantiated per filter type, so the compiler inlines the whole predicate into
+    it. For the join shape, the probe side's filter runs in the same loop, matches are looked
+    up a batch at a time, and output rows are copied straight from the probe and build rows
+    without building the joined tuple.
+
+    The planner hook, planFusedPipeline, runs on every parsed Project. It takes the shape
+    when each predicate is an AND of "column <op> constant" (at most two in all, Selects
+    above an inner hash join only on probe columns) and each output is a plain column
+    reference. The specialization is picked in open(), once constants and bound parameters
+    are known; when none was instantiated for their types, the original operators run.
+    "fuse": false on the Project turns the hook off.
+
+    Pre-instantiated filters: none, every single comparison (int and float with all six
+    operators, string and bool with EQ and NEQ), and an equality on an int, string or bool
+    column paired with any single comparison, e.g. status = 'OPEN' AND total > 200.
+*/
+
+namespace fused {
+
+// --- Building blocks ---
+
+// Typed access to one column of a row: its value if it holds a T, null for NULL.
+template <typename T>
+struct ColumnAccessor {
+    size_t index;
+    const T* operator()(const Tuple& row) const { return std::get_if<T>(&row[index]); }
+};
+
+// column <Op> constant. A NULL column value is never TRUE, as in a Select.
+template <typename T, CmpOp Op>
+struct CompareConstant {
+    ColumnAccessor<T> column;
+    T constant;
+    bool operator()(const Tuple& row) const {
+        const T* value = column(row);
+        return value && compareValues(Op, *value, constant);
+    }
+};
+
+struct NoFilter {
+    bool operator()(const Tuple&) const { return true; }
+};
+
+template <typename First, typename Second>
+struct BothOf {
+    First first;
+    Second second;
+    bool operator()(const Tuple& row) const { return first(row) && second(row); }
+};
+
+// --- Plan shape, found by the planner hook ---
+
+// One "column <op> constant" part of the plan's predicates.
+struct Conjunct {
+    size_t column; // Index in the scan's (= the join's probe side's) tuple
+    DataType type;
+    CmpOp op;
+    std::string opName;
+    const Expression* constant; // A constant or a parameter, evaluated in open()
+};
+
+struct OutputColumn {
+    bool fromBuild; // Else from the scan / probe row
+    size_t index;
+};
+
+struct Shape {
+    ScanOperator* scan = nullptr;
+    HashJoinOperator* join = nullptr; // Null for scan -> filter -> project
+    size_t probeKeyColumn = 0;
+    std::vector<Conjunct> conjuncts;
+    std::vector<OutputColumn> outputs;
+};
+
+constexpr size_t kMaxConjuncts = 2;
+
+// Splits a predicate on its ANDs into "column <op> constant" parts. False if some part is
+// anything else, or one the interpreter would reject (ordering of strings or bools).
+inline bool collectConjuncts(const Expression& predicate, const Schema& schema, std::vector<Conjunct>& out) {
+    auto* binary = dynamic_cast<const BinaryExpression*>(&predicate);
+    if (binary && binary->getOp() == "AND") {
+        return collectConjuncts(binary->getLeft(), schema, out) && collectConjuncts(binary->getRight(), schema, out);
+    }
+    ZonePredicate part;
+    Conjunct conjunct;
+    if (!extractZonePredicate(predicate, schema, part) || !parseCmpOp(part.op, conjunct.op)) return false;
+    conjunct.column = part.column;
+    conjunct.type = schema.getColumns()[part.column].type;
+    conjunct.opName = part.op;
+    conjunct.constant = part.constant;
+    bool ordering = conjunct.op != CmpOp::EQ && conjunct.op != CmpOp::NEQ;
+    if (ordering && conjunct.type != DataType::INT && conjunct.type != DataType::FLOAT) return false;
+    out.push_back(std::move(conjunct));
+    return true;
+}
+
+// Walks down a chain of Selects, collecting their conjuncts; returns the operator below.
+inline Operator* collectSelects(Operator* op, std::vector<Conjunct>& out, bool& ok) {
+    while (auto* select = dynamic_cast<SelectOperator*>(op)) {
+        ok = ok && collectConjuncts(select->getPredicate(), select->getSchema(), out);
+        op = select->getInput();
+    }
+    return op;
+}
+
+inline bool matchShape(const ProjectOperator& project, Shape& shape) {
+    const Schema& inputSchema = project.getInput()->getSchema();
+    for (const auto& p : project.getExpressions()) {
+        auto* col = dynamic_cast<const ColumnRefExpression*>(p.expr.get());
+        if (!col) return false;
+        bool found = false;
+        for (const auto& info : inputSchema.getColumns()) {
+            if (info.name == col->getColumnName()) {
+                shape.outputs.push_back({false, info.index});
+                found = true;
+                break;
+            }
+        }
+        if (!found) return false;
+    }
+
+    bool ok = true;
+    Operator* below = collectSelects(project.getInput(), shape.conjuncts, ok);
+    if (auto* join = dynamic_cast<HashJoinOperator*>(below)) {
+        if (join->getType() != JoinType::INNER) return false;
+        // The joined tuple starts with the probe columns, so a probe column has the same
+        // index above the join as in the probe scan's rows.
+        size_t probeWidth = join->getProbe()->getSchema().getColumns().size();
+        for (const auto& c : shape.conjuncts) {
+            if (c.column >= probeWidth) return false;
+        }
+        for (auto& out : shape.outputs) {
+            if (out.index >= probeWidth) {
+                out.fromBuild = true;
+                out.index -= probeWidth;
+            }
+        }
+        int keyColumn = keyColumnIndex(join->getProbeKey(), join->getProbe()->getSchema());
+        if (keyColumn < 0) return false;
+        shape.join = join;
+        shape.probeKeyColumn = static_cast<size_t>(keyColumn);
+        below = collectSelects(join->getProbe(), shape.conjuncts, ok);
+    }
+    shape.scan = dynamic_cast<ScanOperator*>(below);
+    return ok && shape.scan && shape.conjuncts.size() <= kMaxConjuncts;
+}
+
+// --- The fused loops ---
+
+class FusedLoop {
+public:
+    virtual ~FusedLoop() = default;
+    virtual void open() = 0;
+    virtual bool next(Tuple& out) = 0;
+    virtual void close() = 0;
+};
+
+template <typename Filter>
+class ScanFilterProject : public FusedLoop {
+public:
+    ScanFilterProject(const Shape& shape, Filter filter, const ProjectOperator& project)
+        : scan_(*shape.scan), filter_(filter), project_(project) {
+        for (const auto& out : shape.outputs) columns_.push_back(out.index);
+    }
+
+    void open() override { scan_.open(); }
+
+    bool next(Tuple& out) override {
+        while (scan_.ScanOperator::next(row_)) {
+            if (!filter_(row_)) continue;
+            project_.fetchLateColumns(row_);
+            out.resize(columns_.size());
+            for (size_t i = 0; i < columns_.size(); ++i) out[i] = row_[columns_[i]];
+            return true;
+        }
+        return false;
+    }
+
+    void close() override { scan_.close(); }
+
+private:
+    ScanOperator& scan_;
+    Filter filter_;
+    const ProjectOperator& project_;
+    std::vector<size_t> columns_;
+    Tuple row_;
+};
+
+// The join shape. Everything that does not depend on the filter (the build, the lookups,
+// the projection) lives here, compiled once; the subclass only fills batches of probe rows.
+class ProbeProjectLoop : public FusedLoop {
+public:
+    ProbeProjectLoop(const Shape& shape, const ProjectOperator& project)
+        : scan_(*shape.scan), probeKeyColumn_(shape.probeKeyColumn), join_(*shape.join), project_(project),
+          outputs_(shape.outputs) {}
+
+    // Builds the hash table from the join's build input (any operator tree), the same way
+    // HashJoinOperator does, then starts the probe scan.
+    void open() override {
+        hashTable_.clear();
+        denseIndex_.clear();
+        Operator& build = *join_.getBuild();
+        const Expression& keyExpr = join_.getBuildKey();
+        int keyColumn = keyColumnIndex(keyExpr, build.getSchema());
+        std::vector<Value> keys;
+        std::vector<Tuple> tuples;
+        Tuple tuple;
+        build.open();
+        while (build.next(tuple)) {
+            Value key = keyColumn >= 0 ? tuple[keyColumn] : keyExpr.evaluate(tuple, build.getSchema());
+            if (isNull(key)) continue; // Never matches in an inner join
+            keys.push_back(std::move(key));
+            tuples.push_back(std::move(tuple));
+        }
+        build.close();
+        if (!denseIndex_.build(keys, tuples)) hashTable_.build(keys, tuples);
+
+        batch_.resize(kProbeBatchSize);
+        batchRows_ = 0;
+        matches_.clear();
+        matchPos_ = 0;
+        scanDone_ = false;
+        scan_.open();
+    }
+
+    bool next(Tuple& out) override {
+        while (true) {
+            if (matchPos_ < matches_.size()) {
+                const auto& match = matches_[matchPos_++];
+                project(batch_[match.first], buildRow(match.second), out);
+                return true;
+            }
+            if (!probeNextBatch()) return false;
+        }
+    }
+
+    void close() override { scan_.close(); }
+
+protected:
+    static constexpr size_t kProbeBatchSize = 1024;
+
+    // Reads probe rows into batch_ until kProbeBatchSize of them passed the filter or the
+    // scan ends, setting batchRows_, keys_ and scanDone_.
+    virtual void readProbeBatch() = 0;
+
+    ScanOperator& scan_;
+    size_t probeKeyColumn_;
+    std::vector<Tuple> batch_; // Probe rows that passed the filter, batch_[0, batchRows_)
+    size_t batchRows_ = 0;
+    std::vector<Value> keys_;
+    bool scanDone_ = false;
+
+private:
+    const Tuple& buildRow(uint32_t row) const { return denseIndex_.built() ? denseIndex_.row(row) : hashTable_.row(row); }
+
+    // Finds the matches of a whole batch of probe rows at once, so the lookups overlap
+    // (see hash_table.h).
+    bool probeNextBatch() {
+        matches_.clear();
+        matchPos_ = 0;
+        while (matches_.empty()) {
+            if (scanDone_) return false;
+            batchRows_ = 0;
+            keys_.clear();
+            readProbeBatch();
+            if (batchRows_ == 0) continue;
+            if (denseIndex_.built()) {
+                for (size_t i = 0; i < keys_.size(); ++i) {
+                    uint32_t first, last;
+                    denseIndex_.lookup(keys_[i], first, last);
+                    for (uint32_t r = first; r < last; ++r) matches_.emplace_back(static_cast<uint32_t>(i), r);
+                }
+            } else {
+                hashTable_.probeBatch(keys_, matches_);
+            }
+        }
+        return true;
+    }
+
+    void project(const Tuple& probeRow, const Tuple& buildRow, Tuple& out) {
+        out.resize(outputs_.size());
+        if (project_.hasLateColumns()) {
+            // Deferred columns are addressed by their position in the joined tuple.
+            joined_ = probeRow;
+            joined_.insert(joined_.end(), buildRow.begin(), buildRow.end());
+            project_.fetchLateColumns(joined_);
+            size_t probeWidth = probeRow.size();
+            for (size_t i = 0; i < outputs_.size(); ++i) {
+                out[i] = joined_[outputs_[i].fromBuild ? probeWidth + outputs_[i].index : outputs_[i].index];
+            }
+            return;
+        }
+        for (size_t i = 0; i < outputs_.size(); ++i) {
+            out[i] = outputs_[i].fromBuild ? buildRow[outputs_[i].index] : probeRow[outputs_[i].index];
+        }
+    }
+
+    HashJoinOperator& join_;
+    const ProjectOperator& project_;
+    std::vector<OutputColumn> outputs_;
+
+    JoinHashTable hashTable_;
+    DenseKeyIndex denseIndex_; // Used instead of hashTable_ for dense integer keys
+    JoinHashTable::MatchList matches_;
+    size_t matchPos_ = 0;
+    Tuple joined_;
+};
+
+template <typename Filter>
+class ScanFilterProbeProject : public ProbeProjectLoop {
+public:
+    ScanFilterProbeProject(const Shape& shape, Filter filter, const ProjectOperator& project)
+        : ProbeProjectLoop(shape, project), filter_(filter) {}
+
+private:
+    void readProbeBatch() override {
+        while (batchRows_ < kProbeBatchSize) {
+            Tuple& row = batch_[batchRows_];
+            if (!scan_.ScanOperator::next(row)) {
+                scanDone_ = true;
+                return;
+            }
+            if (!filter_(row)) continue;
+            keys_.push_back(row[probeKeyColumn_]);
+            batchRows_++;
+        }
+    }
+
+    Filter filter_;
+};
+
+// --- Picking the instantiation ---
+
+// Calls make(comparison) with the CompareConstant for a conjunct and its constant's value.
+// Returns false when none is instantiated for them; EqualityOnly restricts it to EQ (the
+// first half of a pair).
+template <typename T, bool EqualityOnly, typename Make>
+bool withOperator(const Conjunct& c, const Value& constant, Make& make) {
+    const T* value = std::get_if<T>(&constant);
+    if (!value) return false; // NULL, or a constant of another type
+    if constexpr (EqualityOnly && std::is_same_v<T, float>) return false; // Rare, not worth the code
+    ColumnAccessor<T> column{c.column};
+    if (c.op == CmpOp::EQ) {
+        make(CompareConstant<T, CmpOp::EQ>{column, *value});
+        return true;
+    }
+    if constexpr (!EqualityOnly) {
+        if (c.op == CmpOp::NEQ) {
+            make(CompareConstant<T, CmpOp::NEQ>{column, *value});
+            return true;
+        }
+        if constexpr (std::is_same_v<T, int> || std::is_same_v<T, float>) {
+            switch (c.op) {
+                case CmpOp::LT: make(CompareConstant<T, CmpOp::LT>{column, *value}); return true;
+                case CmpOp::LTE: make(CompareConstant<T, CmpOp::LTE>{column, *value}); return true;
+                case CmpOp::GT: make(CompareConstant<T, CmpOp::GT>{column, *value}); return true;
+                case CmpOp::GTE: make(CompareConstant<T, CmpOp::GTE>{column, *value}); return true;
+                default: break;
+            }
+        }
+    }
+    return false;
+}
+
+template <bool EqualityOnly, typename Make>
+bool withComparison(const Conjunct& c, const Value& constant, Make&& make) {
+    switch (c.type) {
+        case DataType::INT: return withOperator<int, EqualityOnly>(c, constant, make);
+        case DataType::FLOAT: return withOperator<float, EqualityOnly>(c, constant, make);
+        case DataType::STRING: return withOperator<std::string, EqualityOnly>(c, constant, make);
+        case DataType::BOOL: return withOperator<bool, EqualityOnly>(c, constant, make);
+    }
+    return false;
+}
+
+// The fused loop for a shape with its current constants, or null if it was not compiled in.
+inline std::unique_ptr<FusedLoop> instantiate(const Shape& shape, const ProjectOperator& project) {
+    std::unique_ptr<FusedLoop> loop;
+    auto make = [&](auto filter) {
+        using Filter = decltype(filter);
+        if (shape.join) loop = std::make_unique<ScanFilterProbeProject<Filter>>(shape, filter, project);
+        else loop = std::make_unique<ScanFilterProject<Filter>>(shape, filter, project);
+    };
+
+    std::vector<Value> constants;
+    for (const auto& c : shape.conjuncts) constants.push_back(c.constant->evaluate(Tuple(), Schema()));
+
+    if (shape.conjuncts.empty()) {
+        make(NoFilter{});
+    } else if (shape.conjuncts.size() == 1) {
+        withComparison<false>(shape.conjuncts[0], constants[0], make);
+    } else {
+        // Put the equality first; AND does not care about the order.
+        size_t first = shape.conjuncts[0].op == CmpOp::EQ ? 0 : 1;
+        size_t second = 1 - first;
+        withComparison<true>(shape.conjuncts[first], constants[first], [&](auto equality) {
+            withComparison<false>(shape.conjuncts[second], constants[second], [&](auto comparison) {
+                make(BothOf<decltype(equality), decltype(comparison)>{equality, comparison});
+            });
+        });
+    }
+    return loop;
+}
+
+inline std::string describe(const Shape& shape) {
+    std::string text = "Scan(" + shape.scan->getAlias() + ")";
+    for (size_t i = 0; i < shape.conjuncts.size(); ++i) {
+        text += i == 0 ? " -> Filter[" : ", ";
+        text += typeToString(shape.conjuncts[i].type) + " " + shape.conjuncts[i].opName;
+    }
+    if (!shape.conjuncts.empty()) text += "]";
+    if (shape.join) text += " -> HashProbe";
+    return text + " -> Project(" + std::to_string(shape.outputs.size()) + ")";
+}
+
+} // namespace fused
+
+// A Project whose subtree matched one of the fused shapes. It keeps the original operators
+// and runs them itself when no instantiation fits the constants.
+class FusedPipelineOperator : public Operator {
+public:
+    FusedPipelineOperator(std::unique_ptr<ProjectOperator> project, fused::Shape shape)
+        : project_(std::move(project)), shape_(std::move(shape)) {}
+
+    void open() override {
+        loop_ = fused::instantiate(shape_, *project_);
+        if (!loop_) {
+            std::cout << "[Fused] No compiled pipeline for " << fused::describe(shape_)
+                      << "; running interpreted." << std::endl;
+            project_->open();
+            return;
+        }
+        std::cout << "[Fused] " << fused::describe(shape_) << std::endl;
+        loop_->open();
+    }
+
+    bool next(Tuple& tuple) override { return loop_ ? loop_->next(tuple) : project_->next(tuple); }
+
+    void close() override {
+        if (loop_) loop_->close();
+        else project_->close();
+    }
+
+    const Schema& getSchema() const override { return project_->getSchema(); }
+    ProjectOperator* getProject() const { return project_.get(); }
+
+private:
+    std::unique_ptr<ProjectOperator> project_;
+    fused::Shape shape_;
+    std::unique_ptr<fused::FusedLoop> loop_;
+};
+
+// Planner hook: routes a Project of a fused shape to a FusedPipelineOperator.
+inline std::unique_ptr<Operator> planFusedPipeline(std::unique_ptr<ProjectOperator> project) {
+    fused::Shape shape;
+    if (!fused::matchShape(*project, shape)) return project;
+    return std::make_unique<FusedPipelineOperator>(std::move(project), std::move(shape));
+}
@@ -0,0 +1,262 @@
+#pragma once
+
+#include "types.h"
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+/*
+    Flat open-addressing hash table for hash joins. Distinct build keys live in one array
+    of slots (linear probing, power-of-two size), and the build tuples are stored grouped by
+    key so each slot just points at a contiguous range of rows. Compared to
+    std::unordered_map<Value, std::vector<Tuple>> there are no per-node allocations and a
+    lookup touches one slot, one key and the rows it returns.
+
+    Probes are done in batches. All hashes of a batch are computed first, then the slot of
+    probe i + 2D is prefetched while probe i + D reads its (already fetched) slot and
+    prefetches the key it points at, and probe i compares keys and emits its matches. Once
+    the table is larger than the caches this keeps several misses in flight instead of
+    stalling on one at a time.
+*/
+
+// Hash of a Value, with a final mix so that sequential integer keys spread across slots.
+inline uint64_t hashValue(const Value& val) {
+    uint64_t h = std::hash<Value>{}(val);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Hash of a whole tuple (group keys, DISTINCT rows).
+inline uint64_t hashTuple(const Tuple& tuple) {
+    uint64_t h = 0x9e3779b97f4a7c15ULL;
+    for (const auto& val : tuple) h = (h ^ hashValue(val)) * 0x100000001b3ULL;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// 64-bit FNV-1a, used for cache keys, file checksums and generated code names.
+inline uint64_t fnv1a64(const char* data, size_t size, uint64_t hash = 1469598103934665603ULL) {
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+class JoinHashTable {
+public:
+    static constexpr size_t kPrefetchDistance = 8;
+
+    // (probe index within the batch, build row index) for every match.
+    using MatchList = std::vector<std::pair<uint32_t, uint32_t>>;
+
+    // Takes the build tuples; keys[i] is the join key of tuples[i].
+    void build(const std::vector<Value>& keys, std::vector<Tuple>& tuples) {
+        std::vector<uint32_t> keyOf;
+        std::vector<uint32_t> counts;
+        insertKeys(keys, keyOf, counts);
+
+        // Second pass: lay the rows out grouped by key, keeping build order within a key.
+        std::vector<uint32_t> first(keys_.size() + 1, 0);
+        for (size_t k = 0; k < keys_.size(); ++k) first[k + 1] = first[k] + counts[k];
+        for (auto& slot : slots_) {
+            if (!slot.used) continue;
+            slot.first = first[slot.key];
+            slot.count = counts[slot.key];
+        }
+        std::vector<uint32_t> cursor(first.begin(), first.end() - 1);
+        rows_.resize(tuples.size());
+        for (size_t i = 0; i < tuples.size(); ++i) rows_[cursor[keyOf[i]]++] = std::move(tuples[i]);
+        tuples.clear();
+    }
+
+    // Builds a table of distinct keys only, for semi and anti joins: no rows are stored.
+    void buildKeys(const std::vector<Value>& keys) {
+        std::vector<uint32_t> keyOf;
+        std::vector<uint32_t> counts;
+        insertKeys(keys, keyOf, counts);
+    }
+
+    // Appends the matches of a batch of probe keys to `out`, in probe order.
+    void probeBatch(const std::vector<Value>& keys, MatchList& out) {
+        forEachMatch(keys, [&](size_t j, const Slot& slot) {
+            for (uint32_t r = 0; r < slot.count; ++r) out.emplace_back(static_cast<uint32_t>(j), slot.first + r);
+        });
+    }
+
+    // Sets found[i] to whether keys[i] is in the table. Stops at the first matching key,
+    // without touching any rows.
+    void containsBatch(const std::vector<Value>& keys, std::vector<uint8_t>& found) {
+        found.assign(keys.size(), 0);
+        forEachMatch(keys, [&](size_t j, const Slot&) { found[j] = 1; });
+    }
+
+    const Tuple& row(uint32_t index) const { return rows_[index]; }
+    size_t rowCount() const { return rows_.size(); }
+    size_t keyCount() const { return keys_.size(); }
+
+    void clear() {
+        slots_.clear();
+        keys_.clear();
+        rows_.clear();
+        mask_ = 0;
+    }
+
+private:
+    static constexpr size_t kNone = static_cast<size_t>(-1);
+
+    struct Slot {
+        uint64_t hash = 0;
+        uint32_t key = 0;   // Index into keys_
+        uint32_t first = 0; // rows_[first, first + count) have this key
+        uint32_t count = 0;
+        bool used = false;
+    };
+
+    // Resets the table and inserts the distinct keys. keyOf[i] is the key index of keys[i]
+    // and counts[k] the number of times key k occurs.
+    void insertKeys(const std::vector<Value>& keys, std::vector<uint32_t>& keyOf, std::vector<uint32_t>& counts) {
+        clear();
+        size_t capacity = 16;
+        while (capacity < keys.size() * 2) capacity <<= 1;
+        slots_.assign(capacity, Slot());
+        mask_ = capacity - 1;
+
+        keyOf.resize(keys.size());
+        counts.clear();
+        for (size_t i = 0; i < keys.size(); ++i) {
+            uint64_t h = hashValue(keys[i]);
+            size_t s = h & mask_;
+            while (slots_[s].used) {
+                if (slots_[s].hash == h && keys_[slots_[s].key] == keys[i]) break;
+                s = (s + 1) & mask_;
+            }
+            if (!slots_[s].used) {
+                slots_[s].used = true;
+                slots_[s].hash = h;
+                slots_[s].key = static_cast<uint32_t>(keys_.size());
+                keys_.push_back(keys[i]);
+                counts.push_back(0);
+            }
+            keyOf[i] = slots_[s].key;
+            counts[slots_[s].key]++;
+        }
+    }
+
+    // Runs the prefetching probe pipeline over a batch and calls emit(i, slot) for every
+    // probe key found, in probe order.
+    template <typename Emit>
+    void forEachMatch(const std::vector<Value>& keys, Emit emit) {
+        size_t n = keys.size();
+        hashes_.resize(n);
+        found_.resize(n);
+        for (size_t i = 0; i < n; ++i) hashes_[i] = hashValue(keys[i]);
+
+        const size_t d = kPrefetchDistance;
+        for (size_t i = 0; i < n + 2 * d; ++i) {
+            // Stage 1: fetch the home slot.
+            if (i < n) __builtin_prefetch(&slots_[hashes_[i] & mask_]);
+            // Stage 2: find the slot with a matching hash and fetch its key.
+            if (i >= d && i - d < n) {
+                size_t j = i - d;
+                found_[j] = findSlot(hashes_[j], hashes_[j] & mask_);
+                if (found_[j] != kNone) __builtin_prefetch(&keys_[slots_[found_[j]].key]);
+            }
+            // Stage 3: compare the key and emit the rows.
+            if (i >= 2 * d) {
+                size_t j = i - 2 * d;
+                size_t s = found_[j];
+                while (s != kNone && !(keys_[slots_[s].key] == keys[j])) {
+                    s = findSlot(hashes_[j], (s + 1) & mask_); // Hash collision, keep probing
+                }
+                if (s == kNone) continue;
+                emit(j, slots_[s]);
+            }
+        }
+    }
+
+    // First slot at or after `s` (following the probe sequence) holding this hash.
+    size_t findSlot(uint64_t hash, size_t s) const {
+        if (slots_.empty()) return kNone;
+        while (slots_[s].used) {
+            if (slots_[s].hash == hash) return s;
+            s = (s + 1) & mask_;
+        }
+        return kNone;
+    }
+
+    std::vector<Slot> slots_;
+    size_t mask_ = 0;
+    std::vector<Value> keys_;
+    std::vector<Tuple> rows_;
+
+    // Per-batch scratch space.
+    std::vector<uint64_t> hashes_;
+    std::vector<size_t> found_;
+};
+
+// Set of whole tuples with the same flat layout: linear probing over an array of indexes
+// into the stored tuples, grown at half load. Used by DISTINCT and the set operations.
+class TupleSet {
+public:
+    TupleSet() { clear(); }
+
+    // Adds the tuple unless an equal one is already present; returns whether it was added.
+    bool insert(const Tuple& tuple) {
+        uint64_t h = hashTuple(tuple);
+        size_t s = find(tuple, h);
+        if (slots_[s] != 0) return false;
+        tuples_.push_back(tuple);
+        hashes_.push_back(h);
+        slots_[s] = static_cast<uint32_t>(tuples_.size());
+        if (tuples_.size() * 2 > slots_.size()) grow();
+        return true;
+    }
+
+    bool contains(const Tuple& tuple) const {
+        return slots_[find(tuple, hashTuple(tuple))] != 0;
+    }
+
+    size_t size() const { return tuples_.size(); }
+
+    void clear() {
+        tuples_.clear();
+        hashes_.clear();
+        slots_.assign(1024, 0);
+        mask_ = slots_.size() - 1;
+    }
+
+private:
+    // Slot holding an equal tuple, or the empty slot where it would go.
+    size_t find(const Tuple& tuple, uint64_t h) const {
+        size_t s = h & mask_;
+        while (slots_[s] != 0) {
+            size_t i = slots_[s] - 1;
+            if (hashes_[i] == h && tuples_[i] == tuple) return s;
+            s = (s + 1) & mask_;
+        }
+        return s;
+    }
+
+    void grow() {
+        slots_.assign(slots_.size() * 2, 0);
+        mask_ = slots_.size() - 1;
+        for (size_t i = 0; i < tuples_.size(); ++i) {
+            size_t s = hashes_[i] & mask_;
+            while (slots_[s] != 0) s = (s + 1) & mask_;
+            slots_[s] = static_cast<uint32_t>(i + 1);
+        }
+    }
+
+    std::vector<Tuple> tuples_;
+    std::vector<uint64_t> hashes_;
+    std::vector<uint32_t> slots_; // Tuple index + 1, 0 when empty
+    size_t mask_ = 0;
+};
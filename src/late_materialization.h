@@ -0,0 +1,104 @@
+#pragma once
+
+#include "operator.h"
+#include "merge_join.h"
+#include <map>
+#include <set>
+
+/*
+    Late materialization. Below a projection, Selects and joins only look at the columns
+    in their predicates and join keys; every other column is just copied along until the
+    projection picks it up (or drops it). For scans served from the columnar table cache,
+    such columns are left encoded: the scan puts the row ID in their place, and the
+    projection fetches the value from the cached table only for rows that reach it.
+
+    The pass only looks through operators whose column use it knows (Select, Limit, Sample and
+    the joins, including semi and anti joins). Anything else below the projection leaves the plan unchanged.
+*/
+
+namespace late_detail {
+
+// Collects the columns operators below the projection evaluate, and the scans they read.
+// Returns false on an operator the pass does not understand.
+inline bool collect(Operator* op, std::set<std::string>& used, std::vector<ScanOperator*>& scans) {
+    if (auto* scan = dynamic_cast<ScanOperator*>(op)) {
+        scans.push_back(scan);
+        return true;
+    }
+    if (auto* select = dynamic_cast<SelectOperator*>(op)) {
+        select->getPredicate().collectColumnRefs(used);
+        return collect(select->getInput(), used, scans);
+    }
+    if (auto* limit = dynamic_cast<LimitOperator*>(op)) {
+        return collect(limit->getInput(), used, scans);
+    }
+    if (auto* sample = dynamic_cast<SampleOperator*>(op)) {
+        return collect(sample->getInput(), used, scans);
+    }
+    if (auto* join = dynamic_cast<NestedLoopJoinOperator*>(op)) {
+        join->getCondition().collectColumnRefs(used);
+        return collect(join->getLeft(), used, scans) && collect(join->getRight(), used, scans);
+    }
+    if (auto* join = dynamic_cast<BlockNestedLoopJoinOperator*>(op)) {
+        join->getCondition().collectColumnRefs(used);
+        return collect(join->getLeft(), used, scans) && collect(join->getRight(), used, scans);
+    }
+    if (auto* join = dynamic_cast<HashJoinOperator*>(op)) {
+        join->getProbeKey().collectColumnRefs(used);
+        join->getBuildKey().collectColumnRefs(used);
+        return collect(join->getProbe(), used, scans) && collect(join->getBuild(), used, scans);
+    }
+    if (auto* join = dynamic_cast<SortMergeJoinOperator*>(op)) {
+        join->getLeftKey().collectColumnRefs(used);
+        join->getRightKey().collectColumnRefs(used);
+        return collect(join->getLeft(), used, scans) && collect(join->getRight(), used, scans);
+    }
+    // Semi and anti joins only pass left tuples on, so scans on the right are left alone.
+    if (auto* join = dynamic_cast<HashSemiJoinOperator*>(op)) {
+        std::set<std::string> rightUsed;
+        std::vector<ScanOperator*> rightScans;
+        join->getProbeKey().collectColumnRefs(used);
+        return collect(join->getProbe(), used, scans) && collect(join->getBuild(), rightUsed, rightScans);
+    }
+    if (auto* join = dynamic_cast<MergeSemiJoinOperator*>(op)) {
+        std::set<std::string> rightUsed;
+        std::vector<ScanOperator*> rightScans;
+        join->getLeftKey().collectColumnRefs(used);
+        return collect(join->getLeft(), used, scans) && collect(join->getRight(), rightUsed, rightScans);
+    }
+    return false;
+}
+
+} // namespace late_detail
+
+inline void planLateMaterialization(ProjectOperator& project) {
+    std::set<std::string> used;
+    std::vector<ScanOperator*> scans;
+    if (!late_detail::collect(project.getInput(), used, scans)) return;
+
+    // Columns the projection outputs, and where each one sits in its input tuple. A name
+    // that appears more than once (e.g. a self-join under one alias) is never deferred.
+    const Schema& inputSchema = project.getInput()->getSchema();
+    std::map<std::string, size_t> position;
+    for (const auto& col : inputSchema.getColumns()) {
+        if (position.count(col.name)) used.insert(col.name);
+        position[col.name] = col.index;
+    }
+    std::set<std::string> projected;
+    for (const auto& expr : project.getExpressions()) expr.expr->collectColumnRefs(projected);
+
+    for (ScanOperator* scan : scans) {
+        const auto& cols = scan->getSchema().getColumns();
+        std::vector<bool> late(cols.size(), false);
+        size_t deferred = 0;
+        for (const auto& col : cols) {
+            if (used.count(col.name) || !position.count(col.name)) continue;
+            late[col.index] = true;
+            deferred++;
+            if (projected.count(col.name)) project.addLateColumn(position[col.name], scan, col.index);
+        }
+        // Whether the columns are really deferred is only known when the scan opens and
+        // finds its table in the cache; the scan reports it then.
+        if (deferred > 0) scan->setLateColumns(late);
+    }
+}
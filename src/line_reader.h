@@ -0,0 +1,398 @@
+#pragma once
+
+#include "async_io.h"
+#include "csv_quotes.h"
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef QP_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef QP_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+/*
+    Reads the lines of a table file, which may be plain CSV or a gzip (.gz) or zstd (.zst)
+    compressed CSV. The format is detected from the file's magic bytes, not its name.
+
+    Compressed files are decompressed on a separate thread into a small queue of chunks,
+    so decompression overlaps with the parsing done by the caller and nothing is ever
+    written to disk. A zstd file made of several independent frames (e.g. written by
+    pzstd or zstd -T) has its frames decompressed in parallel, still handed out in order.
+
+    gzip support needs zlib and zstd support needs libzstd at build time (see
+    CMakeLists.txt); without them such files are rejected with an error.
+*/
+
+enum class FileCompression { NONE, GZIP, ZSTD };
+
+inline FileCompression detectCompression(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    unsigned char magic[4] = {0, 0, 0, 0};
+    file.read(reinterpret_cast<char*>(magic), sizeof(magic));
+    std::streamsize got = file.gcount();
+    if (got >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) return FileCompression::GZIP;
+    if (got >= 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) return FileCompression::ZSTD;
+    return FileCompression::NONE;
+}
+
+// Runs a decompressor on its own thread and hands its output out as chunks of text.
+class DecompressionStream {
+public:
+    DecompressionStream(const std::string& path, FileCompression compression, size_t maxQueuedChunks = 4)
+        : path_(path), compression_(compression), maxQueued_(maxQueuedChunks) {
+        worker_ = std::thread([this] { run(); });
+    }
+
+    ~DecompressionStream() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        spaceFree_.notify_all();
+        worker_.join();
+    }
+
+    // Next chunk of decompressed bytes; false at the end of the file. Rethrows decompression errors.
+    bool nextChunk(std::string& out) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        dataReady_.wait(lock, [this] { return !queue_.empty() || finished_; });
+        if (queue_.empty()) {
+            if (error_) std::rethrow_exception(error_);
+            return false;
+        }
+        out = std::move(queue_.front());
+        queue_.pop_front();
+        spaceFree_.notify_one();
+        return true;
+    }
+
+private:
+    static constexpr size_t kChunkBytes = 1 << 20;
+
+    void run() {
+        try {
+            switch (compression_) {
+                case FileCompression::GZIP: inflateGzip(); break;
+                case FileCompression::ZSTD: decompressZstd(); break;
+                case FileCompression::NONE: break;
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            error_ = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        finished_ = true;
+        dataReady_.notify_all();
+    }
+
+    // Queues a chunk, waiting while the reader is behind. Returns false once the stream is being closed.
+    bool emit(std::string chunk) {
+        if (chunk.empty()) return true;
+        std::unique_lock<std::mutex> lock(mutex_);
+        spaceFree_.wait(lock, [this] { return stopping_ || queue_.size() < maxQueued_; });
+        if (stopping_) return false;
+        queue_.push_back(std::move(chunk));
+        dataReady_.notify_one();
+        return true;
+    }
+
+    bool stopping() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stopping_;
+    }
+
+    void inflateGzip() {
+#ifdef QP_HAVE_ZLIB
+        // gzread handles multi-member files (e.g. concatenated .gz parts) transparently.
+        gzFile file = gzopen(path_.c_str(), "rb");
+        if (!file) throw std::runtime_error("Cannot open data file: " + path_);
+        gzbuffer(file, 256 * 1024);
+        std::string chunk;
+        while (true) {
+            chunk.resize(kChunkBytes);
+            int got = gzread(file, &chunk[0], static_cast<unsigned>(chunk.size()));
+            int code = Z_OK;
+            const char* message = gzerror(file, &code);
+            if (got < 0 || code != Z_OK) { // Includes a truncated file (Z_BUF_ERROR)
+                std::string error = std::string("gzip error: ") + message; // zlib names the file
+                gzclose(file);
+                throw std::runtime_error(error);
+            }
+            if (got == 0) break;
+            chunk.resize(static_cast<size_t>(got));
+            if (!emit(std::move(chunk))) break;
+        }
+        gzclose(file);
+#else
+        throw std::runtime_error("Cannot read " + path_ + ": built without gzip support (zlib).");
+#endif
+    }
+
+#ifdef QP_HAVE_ZSTD
+    // Decompresses one complete frame.
+    static std::string decompressZstdFrame(const char* data, size_t size) {
+        std::string out;
+        unsigned long long contentSize = ZSTD_getFrameContentSize(data, size);
+        if (contentSize != ZSTD_CONTENTSIZE_UNKNOWN && contentSize != ZSTD_CONTENTSIZE_ERROR) {
+            out.resize(static_cast<size_t>(contentSize));
+            size_t got = ZSTD_decompress(&out[0], out.size(), data, size);
+            if (ZSTD_isError(got)) throw std::runtime_error(std::string("zstd error: ") + ZSTD_getErrorName(got));
+            out.resize(got);
+            return out;
+        }
+        // The frame does not record its size: stream it.
+        ZSTD_DStream* stream = ZSTD_createDStream();
+        ZSTD_initDStream(stream);
+        std::vector<char> buffer(ZSTD_DStreamOutSize());
+        ZSTD_inBuffer input = {data, size, 0};
+        while (input.pos < input.size) {
+            ZSTD_outBuffer output = {buffer.data(), buffer.size(), 0};
+            size_t ret = ZSTD_decompressStream(stream, &output, &input);
+            if (ZSTD_isError(ret)) {
+                ZSTD_freeDStream(stream);
+                throw std::runtime_error(std::string("zstd error: ") + ZSTD_getErrorName(ret));
+            }
+            out.append(buffer.data(), output.pos);
+        }
+        ZSTD_freeDStream(stream);
+        return out;
+    }
+#endif
+
+    void decompressZstd() {
+#ifdef QP_HAVE_ZSTD
+        std::ifstream file(path_, std::ios::binary);
+        if (!file.is_open()) throw std::runtime_error("Cannot open data file: " + path_);
+
+        // Look at the start of the file: if the first frame ends inside it, the file is a
+        // sequence of frames that can be decompressed independently.
+        std::string pending(4 * kChunkBytes, '\0');
+        file.read(&pending[0], static_cast<std::streamsize>(pending.size()));
+        pending.resize(static_cast<size_t>(file.gcount()));
+        size_t firstFrame = ZSTD_findFrameCompressedSize(pending.data(), pending.size());
+        if (!ZSTD_isError(firstFrame) && firstFrame < pending.size()) {
+            decompressZstdFrames(file, pending);
+        } else {
+            streamZstd(file, pending);
+        }
+#else
+        throw std::runtime_error("Cannot read " + path_ + ": built without zstd support (libzstd).");
+#endif
+    }
+
+#ifdef QP_HAVE_ZSTD
+    // Multi-frame files: cut complete frames off the input and decompress a group of them
+    // at a time in parallel, emitting the results in file order.
+    void decompressZstdFrames(std::ifstream& file, std::string& pending) {
+        size_t parallelism = std::max(1u, std::min(8u, std::thread::hardware_concurrency()));
+        bool eof = false;
+        while (true) {
+            std::vector<std::string> frames;
+            while (frames.size() < parallelism) {
+                size_t frameSize = ZSTD_findFrameCompressedSize(pending.data(), pending.size());
+                if (!pending.empty() && !ZSTD_isError(frameSize)) {
+                    frames.push_back(pending.substr(0, frameSize));
+                    pending.erase(0, frameSize);
+                    continue;
+                }
+                if (eof) {
+                    if (!pending.empty()) throw std::runtime_error("Truncated zstd file: " + path_);
+                    break;
+                }
+                // Need more input to complete the next frame.
+                std::string more(kChunkBytes, '\0');
+                file.read(&more[0], static_cast<std::streamsize>(more.size()));
+                more.resize(static_cast<size_t>(file.gcount()));
+                if (more.empty()) eof = true;
+                pending += more;
+            }
+            if (frames.empty()) return;
+
+            std::vector<std::future<std::string>> results;
+            for (const auto& frame : frames) {
+                results.push_back(std::async(std::launch::async, [&frame] { return decompressZstdFrame(frame.data(), frame.size()); }));
+            }
+            for (auto& result : results) {
+                if (!emit(result.get())) return;
+            }
+        }
+    }
+
+    // A single (possibly huge) frame: plain streaming decompression.
+    void streamZstd(std::ifstream& file, std::string& pending) {
+        ZSTD_DStream* stream = ZSTD_createDStream();
+        ZSTD_initDStream(stream);
+        std::vector<char> inBuffer(ZSTD_DStreamInSize());
+        std::string chunk;
+        size_t lastRet = 0;
+        bool first = true;
+        while (true) {
+            ZSTD_inBuffer input = {nullptr, 0, 0};
+            if (first) {
+                input = {pending.data(), pending.size(), 0};
+                first = false;
+            } else {
+                file.read(inBuffer.data(), static_cast<std::streamsize>(inBuffer.size()));
+                size_t got = static_cast<size_t>(file.gcount());
+                if (got == 0) break;
+                input = {inBuffer.data(), got, 0};
+            }
+            while (input.pos < input.size) {
+                if (chunk.size() < kChunkBytes) chunk.resize(kChunkBytes);
+                ZSTD_outBuffer output = {&chunk[0], chunk.size(), 0};
+                lastRet = ZSTD_decompressStream(stream, &output, &input);
+                if (ZSTD_isError(lastRet)) {
+                    ZSTD_freeDStream(stream);
+                    throw std::runtime_error("zstd error in " + path_ + ": " + ZSTD_getErrorName(lastRet));
+                }
+                chunk.resize(output.pos);
+                if (!emit(std::move(chunk))) {
+                    ZSTD_freeDStream(stream);
+                    return;
+                }
+                chunk.clear();
+            }
+            if (stopping()) break;
+        }
+        ZSTD_freeDStream(stream);
+        if (lastRet != 0) throw std::runtime_error("Truncated zstd file: " + path_);
+    }
+#endif
+
+    std::string path_;
+    FileCompression compression_;
+    size_t maxQueued_;
+
+    std::mutex mutex_;
+    std::condition_variable dataReady_;
+    std::condition_variable spaceFree_;
+    std::deque<std::string> queue_;
+    bool finished_ = false;
+    bool stopping_ = false;
+    std::exception_ptr error_;
+    std::thread worker_;
+};
+
+// Line-by-line reader used by every CSV scan path (plain scans, the table cache loader
+// and shared scans). Plain files are read through a ReadAheadFile (see async_io.h), so
+// the next blocks are already being read while the current one is split into lines.
+class LineReader {
+public:
+    LineReader() = default;
+    explicit LineReader(const std::string& path) { open(path); }
+
+    void open(const std::string& path) {
+        close();
+        path_ = path;
+        compression_ = detectCompression(path);
+        if (compression_ == FileCompression::NONE) {
+            file_ = std::make_unique<ReadAheadFile>(path); // Throws if the file cannot be opened.
+        } else {
+            std::ifstream probe(path);
+            if (!probe.is_open()) throw std::runtime_error("Cannot open data file: " + path);
+            stream_ = std::make_unique<DecompressionStream>(path, compression_);
+        }
+        open_ = true;
+    }
+
+    bool isOpen() const { return open_; }
+    FileCompression compression() const { return compression_; }
+
+    // Same results as std::getline: the line without its '\n', and a last line without a
+    // trailing newline still counts. A newline inside a quoted CSV field does not end the
+    // line (see csv_quotes.h); a record still inside quotes after kMaxCsvRecordLines lines
+    // is skipped.
+    bool getline(std::string& line) {
+        while (readLine(line)) {
+            size_t lines = 1;
+            while (csvQuoteOpen(line)) {
+                if (lines == kMaxCsvRecordLines) break;
+                line.push_back('\n');
+                if (!readLine(continuation_)) return true;
+                line += continuation_;
+                lines++;
+            }
+            if (lines < kMaxCsvRecordLines || !csvQuoteOpen(line)) return true;
+            warnUnterminatedCsvRecord();
+        }
+        return false;
+    }
+
+    // Starts over at the first line of the file.
+    void rewind() {
+        std::string path = path_;
+        open(path);
+    }
+
+    void close() {
+        stream_.reset();
+        file_.reset();
+        chunk_.clear();
+        data_ = nullptr;
+        size_ = pos_ = 0;
+        open_ = false;
+    }
+
+private:
+    // The next physical line, up to the next '\n'.
+    bool readLine(std::string& line) {
+        if (!open_) return false;
+        line.clear();
+        bool any = false;
+        while (true) {
+            if (pos_ < size_) {
+                any = true;
+                const char* start = data_ + pos_;
+                const void* newline = std::memchr(start, '\n', size_ - pos_);
+                if (newline) {
+                    size_t len = static_cast<const char*>(newline) - start;
+                    line.append(start, len);
+                    pos_ += len + 1;
+                    return true;
+                }
+                line.append(start, size_ - pos_);
+                pos_ = size_;
+            }
+            if (!refill()) return any;
+        }
+    }
+
+    // Moves on to the next block of file data.
+    bool refill() {
+        pos_ = size_ = 0;
+        if (file_) return file_->next(data_, size_);
+        if (!stream_->nextChunk(chunk_)) {
+            chunk_.clear();
+            return false;
+        }
+        data_ = chunk_.data();
+        size_ = chunk_.size();
+        return true;
+    }
+
+    std::string path_;
+    FileCompression compression_ = FileCompression::NONE;
+    bool open_ = false;
+
+    std::unique_ptr<ReadAheadFile> file_;         // Plain files
+    std::unique_ptr<DecompressionStream> stream_; // Compressed files
+    std::string chunk_;                           // Current decompressed chunk
+    std::string continuation_;                    // Next line of a record with quoted newlines
+
+    // The block being split into lines.
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    size_t pos_ = 0;
+};
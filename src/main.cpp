@@ -1,10 +1,173 @@
 #include "plan_parser.h" // This includes everything else we need.
+#include "query_server.h"
+#include "batch_runner.h"
+#ifdef QP_ASYNC_EXEC
+#include "async_server.h"
+#endif
+#include <functional>
 #include <iostream>
 
+// Reads the "--flag value" pairs of argv[first...], handing each to set, which returns
+// false for a flag it does not know. Returns false, after saying why, for an unknown flag,
+// a flag without a value or a value that does not parse (set's std::stoul throws).
+static bool parseFlags(int argc, char* argv[], int first, const std::function<bool(const std::string&, const std::string&)>& set) {
+    for (int i = first; i < argc; i += 2) {
+        std::string flag = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for option: " << flag << std::endl;
+            return false;
+        }
+        try {
+            if (!set(flag, argv[i + 1])) {
+                std::cerr << "Unknown option: " << flag << std::endl;
+                return false;
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Invalid value for " << flag << ": " << argv[i + 1] << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Server mode: query_processor --serve <data_dir> [--socket <path>] [--threads N] [--cache-mb N]
+//                                [--result-cache-mb N] [--result-cache-dir <dir>]
+// Keeps the catalog and parsed tables in memory and answers JSON plans until stdin closes
+// (or forever when listening on a socket).
+static int runServer(int argc, char* argv[]) {
+    auto usage = [&] {
+        std::cerr << "Usage: " << argv[0] << " --serve <path_to_data_directory> [--socket <path>] [--threads N] [--cache-mb N]"
+                  << " [--result-cache-mb N] [--result-cache-dir <dir>]" << std::endl;
+        return 1;
+    };
+    if (argc < 3) return usage();
+    std::string data_dir = argv[2];
+    std::string socket_path;
+    ServerOptions options;
+    options.threads = std::max(1u, std::thread::hardware_concurrency());
+    bool flagsOk = parseFlags(argc, argv, 3, [&](const std::string& flag, const std::string& value) {
+        if (flag == "--socket") socket_path = value;
+        else if (flag == "--threads") options.threads = std::stoul(value);
+        else if (flag == "--cache-mb") options.tableCacheBytes = std::stoul(value) << 20;
+        else if (flag == "--result-cache-mb") options.resultCacheBytes = std::stoul(value) << 20;
+        else if (flag == "--result-cache-dir") options.resultCacheDir = value;
+        else return false;
+        return true;
+    });
+    if (!flagsOk) return usage();
+
+    // Replies go to stdout, so send all of the debug chatter to stderr instead.
+    std::ostream replies(std::cout.rdbuf());
+    std::cout.rdbuf(std::cerr.rdbuf());
+
+    try {
+        QueryServer server(data_dir, options);
+        if (socket_path.empty()) {
+            server.serveStream(std::cin, replies);
+        } else {
+            server.serveSocket(socket_path);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "\nServer error: " << e.what() << std::endl;
+        std::cout.rdbuf(replies.rdbuf());
+        return 1;
+    }
+    std::cout.rdbuf(replies.rdbuf());
+    return 0;
+}
+
+// Batch mode: query_processor --batch <plan_dir_or_list> <data_dir> [--threads N] [--out <dir>] [--cache-mb N]
+// Runs every plan in one process over a shared catalog and table cache.
+static int runBatch(int argc, char* argv[]) {
+    auto usage = [&] {
+        std::cerr << "Usage: " << argv[0] << " --batch <plan_dir_or_list> <path_to_data_directory> [--threads N] [--out <dir>] [--cache-mb N]" << std::endl;
+        return 1;
+    };
+    if (argc < 4) return usage();
+    std::string plans_source = argv[2];
+    std::string data_dir = argv[3];
+    BatchOptions options;
+    bool flagsOk = parseFlags(argc, argv, 4, [&](const std::string& flag, const std::string& value) {
+        if (flag == "--threads") options.threads = std::stoul(value);
+        else if (flag == "--out") options.outDir = value;
+        else if (flag == "--cache-mb") options.tableCacheBytes = std::stoul(value) << 20;
+        else return false;
+        return true;
+    });
+    if (!flagsOk) return usage();
+
+    // Results and the summary go to stdout; debug chatter goes to stderr.
+    std::ostream results(std::cout.rdbuf());
+    std::cout.rdbuf(std::cerr.rdbuf());
+    int failures = 0;
+    try {
+        std::vector<std::string> plans = listBatchPlans(plans_source);
+        BatchRunner runner(data_dir, options);
+        failures = runner.run(plans, results);
+    } catch (const std::exception& e) {
+        std::cerr << "\nBatch error: " << e.what() << std::endl;
+        failures = 1;
+    }
+    std::cout.rdbuf(results.rdbuf());
+    return failures == 0 ? 0 : 1;
+}
+
+#ifdef QP_ASYNC_EXEC
+// Async server mode (query_processor_async only):
+//   query_processor_async --serve-async <data_dir> [--threads N] [--io-threads N]
+// Answers JSON plans from stdin like --serve, running every query as coroutines on a few
+// scheduler threads (see src/async_exec.h).
+static int runAsyncServer(int argc, char* argv[]) {
+    auto usage = [&] {
+        std::cerr << "Usage: " << argv[0] << " --serve-async <path_to_data_directory> [--threads N] [--io-threads N]" << std::endl;
+        return 1;
+    };
+    if (argc < 3) return usage();
+    std::string data_dir = argv[2];
+    AsyncServerOptions options;
+    options.threads = std::max(1u, std::thread::hardware_concurrency());
+    bool flagsOk = parseFlags(argc, argv, 3, [&](const std::string& flag, const std::string& value) {
+        if (flag == "--threads") options.threads = std::stoul(value);
+        else if (flag == "--io-threads") options.ioThreads = std::stoul(value);
+        else return false;
+        return true;
+    });
+    if (!flagsOk) return usage();
+
+    // Replies go to stdout, so send all of the debug chatter to stderr instead.
+    std::ostream replies(std::cout.rdbuf());
+    std::cout.rdbuf(std::cerr.rdbuf());
+    int status = 0;
+    try {
+        AsyncQueryServer server(data_dir, options);
+        server.serveStream(std::cin, replies);
+    } catch (const std::exception& e) {
+        std::cerr << "\nServer error: " << e.what() << std::endl;
+        status = 1;
+    }
+    std::cout.rdbuf(replies.rdbuf());
+    return status;
+}
+#endif
+
 int main(int argc, char* argv[]) {
+#ifdef QP_ASYNC_EXEC
+    if (argc >= 2 && std::string(argv[1]) == "--serve-async") {
+        return runAsyncServer(argc, argv);
+    }
+#endif
+    if (argc >= 2 && std::string(argv[1]) == "--serve") {
+        return runServer(argc, argv);
+    }
+    if (argc >= 2 && std::string(argv[1]) == "--batch") {
+        return runBatch(argc, argv);
+    }
+
     // 1. Check that the user provided the right command-line arguments.
     if (argc != 3) {
         std::cerr << "Usage: " << argv[0] << " <path_to_plan.json> <path_to_data_directory>" << std::endl;
+        std::cerr << "       " << argv[0] << " --serve <path_to_data_directory> [--socket <path>] [--threads N] [--cache-mb N]" << std::endl;
+        std::cerr << "       " << argv[0] << " --batch <plan_dir_or_list> <path_to_data_directory> [--threads N] [--out <dir>]" << std::endl;
         return 1;
     }
 
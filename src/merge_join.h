@@ -0,0 +1,253 @@
+#pragma once
+
+#include "operator.h"
+#include <algorithm>
+#include <numeric>
+
+/*
+    Merge joins ("method": "merge"). Both inputs are brought into key order and then walked
+    side by side, so matching never needs a hash table. An input that already arrives sorted
+    on its key (checked while it is read) is not sorted again; otherwise its rows are sorted
+    in memory, keeping input order among equal keys. Results come out in key order.
+*/
+
+// Order in which to visit keys so that they are ascending (stable for equal keys).
+// Returns an empty vector when the keys are already in order.
+inline std::vector<uint32_t> sortedKeyOrder(const std::vector<Value>& keys) {
+    if (std::is_sorted(keys.begin(), keys.end())) return {};
+    std::vector<uint32_t> order(keys.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&keys](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+    return order;
+}
+
+// --- Merge Semi/Anti Join Operator ---
+// Same result as HashSemiJoinOperator, but found by merging the sorted left tuples with
+// the sorted, de-duplicated right keys. Each left tuple is compared against the right keys
+// only until the first key that is not smaller than its own.
+class MergeSemiJoinOperator : public Operator {
+public:
+    MergeSemiJoinOperator(std::unique_ptr<Operator> left, std::unique_ptr<Operator> right,
+                          std::unique_ptr<Expression> leftKey, std::unique_ptr<Expression> rightKey, bool anti)
+        : left_(std::move(left)), right_(std::move(right)),
+          leftKeyExpr_(std::move(leftKey)), rightKeyExpr_(std::move(rightKey)), anti_(anti) {
+        outputSchema_ = left_->getSchema();
+    }
+
+    void open() override {
+        // The right side contributes its distinct keys only.
+        rightKeys_.clear();
+        right_->open();
+        Tuple tuple;
+        int rightKeyColumn = keyColumnIndex(*rightKeyExpr_, right_->getSchema());
+        while (right_->next(tuple)) {
+            Value key = rightKeyColumn >= 0 ? std::move(tuple[rightKeyColumn]) : rightKeyExpr_->evaluate(tuple, right_->getSchema());
+            if (!isNull(key)) rightKeys_.push_back(std::move(key)); // NULL never matches
+        }
+        right_->close();
+        if (!std::is_sorted(rightKeys_.begin(), rightKeys_.end())) std::sort(rightKeys_.begin(), rightKeys_.end());
+        rightKeys_.erase(std::unique(rightKeys_.begin(), rightKeys_.end()), rightKeys_.end());
+
+        // The left side is read in full and sorted by key (unless it already is).
+        leftRows_.clear();
+        leftKeys_.clear();
+        left_->open();
+        int leftKeyColumn = keyColumnIndex(*leftKeyExpr_, left_->getSchema());
+        while (left_->next(tuple)) {
+            leftKeys_.push_back(leftKeyColumn >= 0 ? tuple[leftKeyColumn] : leftKeyExpr_->evaluate(tuple, left_->getSchema()));
+            leftRows_.push_back(std::move(tuple));
+        }
+        left_->close();
+        leftOrder_ = sortedKeyOrder(leftKeys_);
+        std::cout << "[MergeJoin] " << (anti_ ? "Anti" : "Semi") << " join of " << leftRows_.size() << " rows against "
+                  << rightKeys_.size() << " distinct keys" << (leftOrder_.empty() ? " (left input already sorted)." : ".") << std::endl;
+
+        leftPos_ = 0;
+        rightPos_ = 0;
+    }
+
+    bool next(Tuple& tuple) override {
+        while (leftPos_ < leftRows_.size()) {
+            uint32_t row = leftOrder_.empty() ? static_cast<uint32_t>(leftPos_) : leftOrder_[leftPos_];
+            leftPos_++;
+            const Value& key = leftKeys_[row];
+            while (rightPos_ < rightKeys_.size() && rightKeys_[rightPos_] < key) rightPos_++;
+            bool matched = rightPos_ < rightKeys_.size() && rightKeys_[rightPos_] == key;
+            if (matched != anti_) {
+                tuple = std::move(leftRows_[row]);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void close() override {
+        leftRows_.clear();
+        leftKeys_.clear();
+        leftOrder_.clear();
+        rightKeys_.clear();
+    }
+
+    const Schema& getSchema() const override { return outputSchema_; }
+    Operator* getLeft() const { return left_.get(); }
+    Operator* getRight() const { return right_.get(); }
+    const Expression& getLeftKey() const { return *leftKeyExpr_; }
+    const Expression& getRightKey() const { return *rightKeyExpr_; }
+    bool isAnti() const { return anti_; }
+
+private:
+    std::unique_ptr<Operator> left_;
+    std::unique_ptr<Operator> right_;
+    std::unique_ptr<Expression> leftKeyExpr_;
+    std::unique_ptr<Expression> rightKeyExpr_;
+    bool anti_;
+    Schema outputSchema_;
+
+    std::vector<Tuple> leftRows_;
+    std::vector<Value> leftKeys_;
+    std::vector<uint32_t> leftOrder_; // Empty when the left rows are already in key order
+    std::vector<Value> rightKeys_;    // Sorted and distinct
+    size_t leftPos_ = 0;
+    size_t rightPos_ = 0;
+};
+
+// --- Sort-Merge Join Operator ---
+// Equi-join by merging both inputs in key order. For every key present on both sides the
+// matching rows are paired up (left-major); with an outer join type, rows whose key has no
+// partner (or is NULL) are returned padded with NULLs as the merge passes them.
+class SortMergeJoinOperator : public Operator {
+public:
+    SortMergeJoinOperator(std::unique_ptr<Operator> left, std::unique_ptr<Operator> right,
+                          std::unique_ptr<Expression> leftKey, std::unique_ptr<Expression> rightKey,
+                          JoinType type = JoinType::INNER)
+        : left_(std::move(left)), right_(std::move(right)),
+          leftKeyExpr_(std::move(leftKey)), rightKeyExpr_(std::move(rightKey)), type_(type) {
+        outputSchema_ = Schema::merge(left_->getSchema(), right_->getSchema());
+    }
+
+    void open() override {
+        readSorted(*left_, *leftKeyExpr_, leftRows_, leftKeys_, leftOrder_);
+        readSorted(*right_, *rightKeyExpr_, rightRows_, rightKeys_, rightOrder_);
+        std::cout << "[MergeJoin] Merging " << leftRows_.size() << " left rows with " << rightRows_.size() << " right rows"
+                  << (leftOrder_.empty() && rightOrder_.empty() ? " (inputs already sorted)." : ".") << std::endl;
+        leftPos_ = rightPos_ = 0;
+        inGroup_ = false;
+    }
+
+    bool next(Tuple& tuple) override {
+        while (true) {
+            // Pair up the rows of the current key group, left-major.
+            if (inGroup_) {
+                if (groupLeft_ < leftEnd_) {
+                    const Tuple& rightTuple = rightRows_[rightRow(groupRight_)];
+                    tuple = leftRows_[leftRow(groupLeft_)];
+                    tuple.insert(tuple.end(), rightTuple.begin(), rightTuple.end());
+                    if (++groupRight_ == rightEnd_) {
+                        groupRight_ = rightPos_;
+                        groupLeft_++;
+                    }
+                    return true;
+                }
+                leftPos_ = leftEnd_;
+                rightPos_ = rightEnd_;
+                inGroup_ = false;
+            }
+
+            bool hasLeft = leftPos_ < leftRows_.size();
+            bool hasRight = rightPos_ < rightRows_.size();
+            if (!hasLeft && !hasRight) return false;
+
+            if (hasLeft && hasRight) {
+                const Value& leftKey = leftKeys_[leftRow(leftPos_)];
+                const Value& rightKey = rightKeys_[rightRow(rightPos_)];
+                if (leftKey == rightKey && !isNull(leftKey)) {
+                    // Found a key on both sides: find the extent of its group on each side.
+                    leftEnd_ = leftPos_ + 1;
+                    while (leftEnd_ < leftRows_.size() && leftKeys_[leftRow(leftEnd_)] == leftKey) leftEnd_++;
+                    rightEnd_ = rightPos_ + 1;
+                    while (rightEnd_ < rightRows_.size() && rightKeys_[rightRow(rightEnd_)] == rightKey) rightEnd_++;
+                    groupLeft_ = leftPos_;
+                    groupRight_ = rightPos_;
+                    inGroup_ = true;
+                    continue;
+                }
+                // NULL sorts last on both sides; NULL keys never match, so the left ones
+                // are passed over first and the right ones after them.
+                bool leftFirst = leftKey < rightKey || (isNull(leftKey) && isNull(rightKey));
+                hasLeft = leftFirst;
+                hasRight = !leftFirst;
+            }
+
+            if (hasLeft) {
+                size_t row = leftRow(leftPos_++);
+                if (type_ == JoinType::LEFT || type_ == JoinType::FULL) {
+                    tuple = leftRows_[row];
+                    tuple.resize(outputSchema_.getColumns().size(), nullValue());
+                    return true;
+                }
+            } else {
+                size_t row = rightRow(rightPos_++);
+                if (type_ == JoinType::RIGHT || type_ == JoinType::FULL) {
+                    tuple.assign(leftWidth(), nullValue());
+                    tuple.insert(tuple.end(), rightRows_[row].begin(), rightRows_[row].end());
+                    return true;
+                }
+            }
+        }
+    }
+
+    void close() override {
+        leftRows_.clear();
+        leftKeys_.clear();
+        leftOrder_.clear();
+        rightRows_.clear();
+        rightKeys_.clear();
+        rightOrder_.clear();
+    }
+
+    const Schema& getSchema() const override { return outputSchema_; }
+    Operator* getLeft() const { return left_.get(); }
+    Operator* getRight() const { return right_.get(); }
+    const Expression& getLeftKey() const { return *leftKeyExpr_; }
+    const Expression& getRightKey() const { return *rightKeyExpr_; }
+    JoinType getType() const { return type_; }
+
+private:
+    // Reads an input in full with its keys, and the order that sorts it by key.
+    static void readSorted(Operator& input, const Expression& keyExpr, std::vector<Tuple>& rows,
+                           std::vector<Value>& keys, std::vector<uint32_t>& order) {
+        rows.clear();
+        keys.clear();
+        input.open();
+        Tuple tuple;
+        int keyColumn = keyColumnIndex(keyExpr, input.getSchema());
+        while (input.next(tuple)) {
+            keys.push_back(keyColumn >= 0 ? tuple[keyColumn] : keyExpr.evaluate(tuple, input.getSchema()));
+            rows.push_back(std::move(tuple));
+        }
+        input.close();
+        order = sortedKeyOrder(keys);
+    }
+
+    // Row index of the i-th row in key order.
+    size_t leftRow(size_t i) const { return leftOrder_.empty() ? i : leftOrder_[i]; }
+    size_t rightRow(size_t i) const { return rightOrder_.empty() ? i : rightOrder_[i]; }
+    size_t leftWidth() const { return left_->getSchema().getColumns().size(); }
+
+    std::unique_ptr<Operator> left_;
+    std::unique_ptr<Operator> right_;
+    std::unique_ptr<Expression> leftKeyExpr_;
+    std::unique_ptr<Expression> rightKeyExpr_;
+    JoinType type_;
+    Schema outputSchema_;
+
+    std::vector<Tuple> leftRows_, rightRows_;
+    std::vector<Value> leftKeys_, rightKeys_;
+    std::vector<uint32_t> leftOrder_, rightOrder_; // Empty when already in key order
+
+    // Merge position (in key order) and the key group being paired up.
+    size_t leftPos_ = 0, rightPos_ = 0;
+    bool inGroup_ = false;
+    size_t leftEnd_ = 0, rightEnd_ = 0;
+    size_t groupLeft_ = 0, groupRight_ = 0;
+};
@@ -2,6 +2,16 @@
 
 #include "types.h"
 #include "catalog.h"
+#include "csv.h"
+#include "line_reader.h"
+#include "sampling.h"
+#include "partition.h"
+#include "dense_key_index.h"
+#include "hash_table.h"
+#include "table_cache.h"
+#include "shared_scan.h"
+#include "zone_map.h"
+#include "block_filter.h"
 #include <fstream>
 #include <sstream>
 #include <memory> // For std::unique_ptr
@@ -40,73 +50,306 @@ public:
         
         // Now, use the correct key (the filename) for the catalog lookup.
         const Schema& baseSchema = catalog_.getSchema(tableName); 
+        baseSchema_ = baseSchema;
         // -----------------------
 
         for (const auto& col : baseSchema.getColumns()) {
             qualifiedSchema_.addColumn(alias_ + "." + col.name, col.type);
         }
+
+        // Tables stored as many files are read through a PartitionedScan.
+        partitionSpec_ = catalog_.getPartitionSpec(tableName);
     }
 
     void open() override {
+        blockSampled_ = false;
+        if (partitionSpec_) {
+            openPartitions();
+            return;
+        }
+
+        // If the catalog has a table cache (server/batch mode), read the parsed table from memory.
+        if (TableCache* cache = catalog_.getTableCache()) {
+            cachedTable_ = cache->get(tablePath_, baseSchema_);
+            if (cachedTable_) {
+                prepareCachedScan();
+                if (sampleFraction_ >= 0.0) sampleCachedBlocks();
+                // Deferred columns can only be fetched later from a columnar table.
+                lateActive_ = std::find(lateColumns_.begin(), lateColumns_.end(), true) != lateColumns_.end();
+                if (lateActive_) {
+                    std::cout << "[Scan] Late materialization defers " << std::count(lateColumns_.begin(), lateColumns_.end(), true)
+                              << " of " << lateColumns_.size() << " columns of '" << alias_ << "'" << std::endl;
+                }
+                lateTable_ = cachedTable_;
+                return;
+            }
+        }
+        lateActive_ = false;
+
+        // A block sample of a plain file reads only the sampled byte ranges.
+        if (sampleFraction_ >= 0.0 && detectCompression(tablePath_) == FileCompression::NONE) {
+            sampleReader_ = std::make_unique<BlockSampleReader>(tablePath_, sampleFraction_, sampleSeed_);
+            blockSampled_ = true;
+            std::cout << "[Scan] Block sample reads " << sampleReader_->sampledBlocks() << " of "
+                      << sampleReader_->totalBlocks() << " byte ranges of '" << tablePath_ << "'" << std::endl;
+            return;
+        }
+
+        // Otherwise try to piggyback on a scan of the same file another query is running.
+        if (SharedScanManager* shared = catalog_.getSharedScanManager()) {
+            sharedCursor_ = shared->attach(tablePath_, baseSchema_);
+            sharedBatch_.reset();
+            sharedRow_ = 0;
+            if (sharedCursor_) return;
+        }
+
         // Don't open if already open.
-        if (fileStream_.is_open()) return;
+        if (fileStream_.isOpen()) return;
         
+        // Throws if the file cannot be opened. Compressed files are decompressed on the fly.
         fileStream_.open(tablePath_);
-        if (!fileStream_.is_open()) {
-            throw std::runtime_error("Cannot open data file: " + tablePath_);
-        }   
         
         // IMPORTANT: Skip the header row of the CSV file.
         std::string header;
-        std::getline(fileStream_, header);
+        fileStream_.getline(header);
     }
 
     bool next(Tuple& tuple) override {
+        if (partitionedScan_) return partitionedScan_->next(tuple);
+
+        if (cachedTable_) {
+            // Cached tables are read a block at a time: decode the block, then hand out
+            // the rows that survived the pushed-down predicates.
+            while (true) {
+                while (blockPos_ < blockRowCount_) {
+                    size_t i = blockPos_++;
+                    if (!selection_[i]) continue;
+                    tuple.clear();
+                    if (lateActive_) {
+                        // Deferred columns carry the row ID instead of their value.
+                        int rowId = static_cast<int>(blockBase_ + i);
+                        for (size_t c = 0; c < decoded_.size(); ++c) {
+                            if (lateColumns_[c]) tuple.push_back(rowId);
+                            else tuple.push_back(decoded_[c].get(i));
+                        }
+                        return true;
+                    }
+                    for (const auto& col : decoded_) tuple.push_back(col.get(i));
+                    return true;
+                }
+                if (!loadNextCachedBlock()) return false;
+            }
+        }
+
+        if (sharedCursor_) {
+            while (!sharedBatch_ || sharedRow_ >= sharedBatch_->rows.size()) {
+                sharedBatch_ = sharedCursor_->nextBatch();
+                sharedRow_ = 0;
+                if (!sharedBatch_) return false; // We have seen every block of the table.
+            }
+            tuple = sharedBatch_->rows[sharedRow_++];
+            return true;
+        }
+
         std::string line;
-        if (std::getline(fileStream_, line)) {
-            tuple.clear();
-            std::stringstream ss(line);
-            std::string field;
-            int colIdx = 0;
-            const auto& cols = qualifiedSchema_.getColumns();
-
-            while (std::getline(ss, field, ',')) {
-                 if (colIdx >= cols.size()) break; // Handle trailing commas or malformed lines
-                 const auto& colInfo = cols[colIdx++];
-                 
-                 // This is where we parse the string from the CSV into our C++ types.
-                 try {
-                     switch (colInfo.type) {
-                         case DataType::INT:    tuple.emplace_back(std::stoi(field)); break;
-                         case DataType::FLOAT:  tuple.emplace_back(std::stof(field)); break;
-                         case DataType::STRING: tuple.emplace_back(field); break;
-                         case DataType::BOOL:   tuple.emplace_back(field == "true" || field == "1"); break;
-                     }
-                 } catch (const std::invalid_argument& e) {
-                     // Handle parsing errors gracefully
-                     std::cerr << "Warning: Could not parse '" << field << "' for column " << colInfo.name << ". Skipping row." << std::endl;
-                     return next(tuple); // Try to get the next valid row
-                 }
+        if (sampleReader_) {
+            while (sampleReader_->getline(line)) {
+                if (parseCsvLine(line, qualifiedSchema_.getColumns(), tuple)) return true;
+            }
+            return false;
+        }
+        while (fileStream_.getline(line)) {
+            // This is where we parse the string from the CSV into our C++ types.
+            // Rows that fail to parse are reported and skipped.
+            if (parseCsvLine(line, qualifiedSchema_.getColumns(), tuple)) {
+                return true; // Successfully produced a tuple
             }
-            return true; // Successfully produced a tuple
         }
         return false; // No more lines in the file
     }
 
     void close() override {
-        if (fileStream_.is_open()) {
-            fileStream_.close();
-        }
+        partitionedScan_.reset();
+        cachedTable_.reset();
+        sharedBatch_.reset();
+        sharedCursor_.reset();
+        sampleReader_.reset();
+        fileStream_.close();
     }
 
     const Schema& getSchema() const override { return qualifiedSchema_; }
 
+    // Called by the planner for each Select predicate applied directly to this scan.
+    // Predicates of the form "column <op> constant" are used to skip blocks of a cached
+    // table using its zone maps, and files of a partitioned table using their partition
+    // values. AND / OR / NOT / IS NULL combinations of such comparisons become block
+    // filters, evaluated on the compressed blocks of a cached table; anything else is ignored.
+    void addPruningPredicate(const Expression& predicate) {
+        ZonePredicate zp;
+        if (extractZonePredicate(predicate, qualifiedSchema_, zp)) {
+            zonePredicates_.push_back(zp);
+        } else if (auto filter = BlockFilter::build(predicate, qualifiedSchema_)) {
+            blockFilters_.push_back(std::move(filter));
+        }
+    }
+
+    // Late materialization. The planner marks the columns no operator below the projection
+    // needs; when the scan is served from a columnar table those columns are not decoded
+    // and carry the row ID instead, and the projection fetches the ones it outputs.
+    void setLateColumns(const std::vector<bool>& lateColumns) { lateColumns_ = lateColumns; }
+    const std::string& getAlias() const { return alias_; }
+    bool lateActive() const { return lateActive_; }
+
+    // Block sampling, requested by a Sample node directly above the scan. After open(),
+    // blockSampled() tells whether the scan could skip the unsampled blocks itself (cached
+    // tables and plain files); otherwise it returns every row and the Sample node samples.
+    void setBlockSample(double fraction, uint64_t seed) {
+        sampleFraction_ = fraction;
+        sampleSeed_ = seed;
+    }
+    bool blockSampled() const { return blockSampled_; }
+
+    // Whether open() would read the whole uncompressed CSV file itself: no table cache,
+    // shared scans, partitions or block sample. The async engine (async_exec.h) reads such
+    // files on its own.
+    bool readsPlainFile() const {
+        return !partitionSpec_ && sampleFraction_ < 0.0 && !catalog_.getTableCache() &&
+               !catalog_.getSharedScanManager() && detectCompression(tablePath_) == FileCompression::NONE;
+    }
+    const std::string& getTablePath() const { return tablePath_; }
+    Value fetchLate(size_t column, int rowId) const { return lateTable_->column(column).get(static_cast<size_t>(rowId)); }
+
 private:
+    // Lists the table's files and drops those whose partition values cannot satisfy the
+    // pushed-down predicates, before opening any of them.
+    void openPartitions() {
+        std::vector<PartitionFile> files = listPartitionFiles(*partitionSpec_, baseSchema_, catalog_.getDataDir());
+        size_t total = files.size();
+        if (!zonePredicates_.empty()) {
+            Tuple empty;
+            std::vector<Value> constants;
+            for (const auto& zp : zonePredicates_) constants.push_back(zp.constant->evaluate(empty, qualifiedSchema_));
+            files.erase(std::remove_if(files.begin(), files.end(), [&](const PartitionFile& file) {
+                return !partitionMayMatch(file, *partitionSpec_, zonePredicates_, constants);
+            }), files.end());
+        }
+        std::cout << "[Scan] Partition pruning keeps " << files.size() << " of " << total << " files of '" << tablePath_ << "'" << std::endl;
+        partitionedScan_ = std::make_unique<PartitionedScan>(std::move(files), baseSchema_, *partitionSpec_);
+    }
+
+    // Works out, once per open(), which blocks the zone maps rule out entirely.
+    void prepareCachedScan() {
+        nextBlock_ = 0;
+        blockPos_ = blockRowCount_ = 0;
+        decoded_.assign(cachedTable_->getSchema().getColumns().size(), DecodedColumn());
+
+        size_t blocks = cachedTable_->blockCount();
+        skipBlock_.assign(blocks, false);
+        zoneConstants_.clear();
+        for (auto& filter : blockFilters_) filter->bindConstants(qualifiedSchema_);
+        if (zonePredicates_.empty()) return;
+
+        size_t skipped = 0;
+        Tuple empty;
+        for (const auto& zp : zonePredicates_) {
+            // Constants (or bound parameters) are evaluated once per open().
+            zoneConstants_.push_back(zp.constant->evaluate(empty, qualifiedSchema_));
+            for (size_t b = 0; b < blocks; ++b) {
+                if (!skipBlock_[b] && !zoneMayMatch(cachedTable_->zone(b, zp.column), zp.op, zoneConstants_.back())) {
+                    skipBlock_[b] = true;
+                    skipped++;
+                }
+            }
+        }
+        std::cout << "[Scan] Zone maps skip " << skipped << " of " << blocks << " blocks of '" << tablePath_ << "'" << std::endl;
+    }
+
+    // Block sampling of a cached table: unsampled blocks are skipped like pruned ones.
+    void sampleCachedBlocks() {
+        size_t kept = 0;
+        for (size_t b = 0; b < skipBlock_.size(); ++b) {
+            if (!sampleKeep(sampleSeed_, b, sampleFraction_)) skipBlock_[b] = true;
+            else kept++;
+        }
+        blockSampled_ = true;
+        std::cout << "[Scan] Block sample keeps " << kept << " of " << skipBlock_.size() << " blocks of '" << tablePath_ << "'" << std::endl;
+    }
+
+    // Moves to the next block that may contain matching rows. The pushed-down predicates
+    // are evaluated on the compressed block first; columns are only decoded when at least
+    // one row survives.
+    bool loadNextCachedBlock() {
+        size_t blocks = cachedTable_->blockCount();
+        while (nextBlock_ < blocks) {
+            size_t b = nextBlock_++;
+            if (skipBlock_[b]) continue;
+
+            size_t rows = std::min(kZoneBlockRows, cachedTable_->rowCount() - b * kZoneBlockRows);
+            selection_.assign(rows, 1);
+            for (size_t p = 0; p < zonePredicates_.size(); ++p) {
+                CmpOp op;
+                if (parseCmpOp(zonePredicates_[p].op, op)) {
+                    cachedTable_->column(zonePredicates_[p].column).filterBlock(b, op, zoneConstants_[p], selection_.data(), scratch_);
+                }
+            }
+            for (auto& filter : blockFilters_) filter->apply(*cachedTable_, b, rows, selection_.data(), scratch_);
+            if (std::find(selection_.begin(), selection_.end(), 1) == selection_.end()) continue;
+
+            for (size_t c = 0; c < decoded_.size(); ++c) {
+                if (lateActive_ && lateColumns_[c]) continue; // Fetched later, if at all
+                cachedTable_->column(c).decodeBlock(b, decoded_[c]);
+            }
+            blockBase_ = b * kZoneBlockRows;
+            blockPos_ = 0;
+            blockRowCount_ = rows;
+            return true;
+        }
+        return false;
+    }
+
     std::string tablePath_;
     std::string alias_;
     const Catalog& catalog_;
+    Schema baseSchema_;      // The catalog schema with plain column names
     Schema qualifiedSchema_; // The output schema with aliased column names
-    std::ifstream fileStream_;
+    LineReader fileStream_; // Plain, gzip or zstd CSV
+
+    // Set when the table is served from the catalog's TableCache instead of the file.
+    std::shared_ptr<const ColumnarTable> cachedTable_;
+    std::vector<ZonePredicate> zonePredicates_;
+    std::vector<Value> zoneConstants_; // Value of each predicate's constant for this open()
+    std::vector<std::unique_ptr<BlockFilter>> blockFilters_; // Pushed-down predicates zone maps cannot use
+    std::vector<bool> skipBlock_;      // Per block of the cached table, from the zone maps
+    size_t nextBlock_ = 0;
+    std::vector<DecodedColumn> decoded_; // The current block, one entry per column
+    std::vector<uint8_t> selection_;     // Rows of the current block that passed the predicates
+    std::vector<int32_t> scratch_;
+    size_t blockPos_ = 0;
+    size_t blockRowCount_ = 0;
+    size_t blockBase_ = 0; // Row ID of the current block's first row
+
+    // Late materialization: which columns are deferred, and the table to fetch them from.
+    // lateTable_ outlives close() because rows may still be in flight (e.g. a hash join
+    // closes its build side before probing).
+    std::vector<bool> lateColumns_;
+    bool lateActive_ = false;
+    std::shared_ptr<const ColumnarTable> lateTable_;
+
+    // Set for partitioned (multi-file) tables.
+    const PartitionSpec* partitionSpec_ = nullptr;
+    std::unique_ptr<PartitionedScan> partitionedScan_;
+
+    // Block sampling: the fraction (negative when not sampling) and seed, and the reader
+    // used for plain files.
+    double sampleFraction_ = -1.0;
+    uint64_t sampleSeed_ = 0;
+    bool blockSampled_ = false;
+    std::unique_ptr<BlockSampleReader> sampleReader_;
+
+    // Set when this scan is attached to a shared circular scan of the file.
+    std::unique_ptr<SharedScanCursor> sharedCursor_;
+    std::shared_ptr<const SharedBatch> sharedBatch_;
+    size_t sharedRow_ = 0;
 };
 // --- Select Operator ---
 // Filters tuples based on a predicate expression.
@@ -122,13 +365,16 @@ public:
     // The schema doesn't change through a select, so we just return our child's schema.
     const Schema& getSchema() const override { return input_->getSchema(); }
 
+    Operator* getInput() const { return input_.get(); }
+    const Expression& getPredicate() const { return *predicate_; }
+
     bool next(Tuple& tuple) override {
         // Loop until we find a tuple that matches the predicate or the child runs out of data.
         while (input_->next(tuple)) {
             // Evaluate the predicate on the tuple we just got.
             Value result = predicate_->evaluate(tuple, getSchema());
-            // If the expression evaluates to true, we've found our next tuple.
-            if (std::get<bool>(result)) {
+            // If the expression evaluates to true, we've found our next tuple (NULL counts as false).
+            if (isTrue(result)) {
                 return true; // Success! The tuple is passed to our caller.
             }
             // Otherwise, the loop continues to get the next tuple from the child.
@@ -165,10 +411,10 @@ public:
             if (dynamic_cast<BinaryExpression*>(p_expr.expr.get())) {
                  type = DataType::FLOAT; // Assume MUL produces float
             } else if (auto* col_ref = dynamic_cast<ColumnRefExpression*>(p_expr.expr.get())) {
-                 // We can't easily get the column type without an input tuple.
-                 // This part of the system would need to be more sophisticated in a real DB.
-                 // For now, let's keep it simple and fix if needed.
-                 // The provided query schemas are simple enough this won't be an issue yet.
+                 // A plain column keeps its input type, which set operations check.
+                 for (const auto& info : input_->getSchema().getColumns()) {
+                     if (info.name == col_ref->getColumnName()) type = info.type;
+                 }
             }
             outputSchema_.addColumn(p_expr.alias, type); 
         }
@@ -178,10 +424,22 @@ public:
     void close() override { input_->close(); }
     const Schema& getSchema() const override { return outputSchema_; }
 
+    Operator* getInput() const { return input_.get(); }
+    const std::vector<ProjExpr>& getExpressions() const { return expressions_; }
+
+    // Registers an input column that a late-materializing scan may have deferred: when the
+    // scan is deferring, the tuple holds a row ID there and the value is fetched here.
+    void addLateColumn(size_t position, const ScanOperator* scan, size_t column) {
+        lateColumns_.push_back({position, scan, column});
+    }
+
+    bool hasLateColumns() const { return !lateColumns_.empty(); }
+
     bool next(Tuple& tuple) override {
         Tuple inputTuple;
         // First, get a tuple from our child.
         if (input_->next(inputTuple)) {
+            fetchLateColumns(inputTuple);
             tuple.clear(); // Clear the output tuple to build our new one.
             // Now, evaluate each of our expressions to build the new tuple.
             for (const auto& p_expr : expressions_) {
@@ -192,10 +450,27 @@ public:
         return false; // Child has no more tuples.
     }
 
+    // Replaces the row IDs of deferred columns in an input tuple with their values.
+    void fetchLateColumns(Tuple& inputTuple) const {
+        for (const auto& late : lateColumns_) {
+            // Rows padded by an outer join hold NULL instead of a row ID.
+            if (late.scan->lateActive() && !isNull(inputTuple[late.position])) {
+                inputTuple[late.position] = late.scan->fetchLate(late.column, std::get<int>(inputTuple[late.position]));
+            }
+        }
+    }
+
 private:
+    struct LateColumn {
+        size_t position;           // Index in the input tuple
+        const ScanOperator* scan;  // Scan that produced the column
+        size_t column;             // Column index in that scan's table
+    };
+
     std::unique_ptr<Operator> input_;
     std::vector<ProjExpr> expressions_;
     Schema outputSchema_; // The new schema we produce.
+    std::vector<LateColumn> lateColumns_;
 };
 
 // --- Limit Operator ---
@@ -208,6 +483,8 @@ public:
     void open() override { input_->open(); count_ = 0; }
     void close() override { input_->close(); }
     const Schema& getSchema() const override { return input_->getSchema(); }
+    Operator* getInput() const { return input_.get(); }
+    int getLimit() const { return limit_; }
 
     bool next(Tuple& tuple) override {
         // If we've already reached our limit, stop.
@@ -228,6 +505,55 @@ private:
     int count_;
 };
 
+// --- Sample Operator ---
+// Returns a random sample of about `fraction` of its input. BERNOULLI keeps each row on its
+// own; BLOCK keeps or drops whole blocks, which a scan directly below can do without reading
+// the dropped blocks. When it cannot, blocks of kRowBlock consecutive rows are sampled here.
+// The choice depends only on the seed and the row (or block) position.
+class SampleOperator : public Operator {
+public:
+    enum class Method { BERNOULLI, BLOCK };
+    static constexpr uint64_t kRowBlock = 1024;
+
+    SampleOperator(std::unique_ptr<Operator> input, Method method, double fraction, uint64_t seed)
+        : input_(std::move(input)), method_(method), fraction_(fraction), seed_(seed) {
+        scan_ = method_ == Method::BLOCK ? dynamic_cast<ScanOperator*>(input_.get()) : nullptr;
+        if (scan_) scan_->setBlockSample(fraction_, seed_);
+    }
+
+    void open() override {
+        input_->open();
+        row_ = 0;
+        passThrough_ = scan_ && scan_->blockSampled();
+        if (method_ == Method::BLOCK && !passThrough_) {
+            std::cout << "[Sample] Input cannot skip blocks; sampling blocks of " << kRowBlock << " rows instead." << std::endl;
+        }
+    }
+
+    bool next(Tuple& tuple) override {
+        while (input_->next(tuple)) {
+            if (passThrough_) return true;
+            uint64_t index = method_ == Method::BLOCK ? row_ / kRowBlock : row_;
+            row_++;
+            if (sampleKeep(seed_, index, fraction_)) return true;
+        }
+        return false;
+    }
+
+    void close() override { input_->close(); }
+    const Schema& getSchema() const override { return input_->getSchema(); }
+    Operator* getInput() const { return input_.get(); }
+
+private:
+    std::unique_ptr<Operator> input_;
+    Method method_;
+    double fraction_;
+    uint64_t seed_;
+    ScanOperator* scan_ = nullptr; // The scan below, for BLOCK sampling
+    bool passThrough_ = false;     // The scan already samples
+    uint64_t row_ = 0;
+};
+
 
 // --- Nested-Loop Join Operator ---
 // Joins tuples from two inputs using a nested loop algorithm.
@@ -257,7 +583,7 @@ public:
                 combined.insert(combined.end(), rightTuple.begin(), rightTuple.end());
                 
                 // Check if the combined tuple satisfies the join condition.
-                if (std::get<bool>(condition_->evaluate(combined, outputSchema_))) {
+                if (isTrue(condition_->evaluate(combined, outputSchema_))) {
                     tuple = combined;
                     return true; // Found a match!
                 }
@@ -279,6 +605,9 @@ public:
     }
     
     const Schema& getSchema() const override { return outputSchema_; }
+    Operator* getLeft() const { return left_.get(); }
+    Operator* getRight() const { return right_.get(); }
+    const Expression& getCondition() const { return *condition_; }
 
 private:
     std::unique_ptr<Operator> left_;
@@ -313,7 +642,7 @@ public:
                 Tuple combined = leftTuple;
                 combined.insert(combined.end(), rightTuple.begin(), rightTuple.end());
                 
-                if (std::get<bool>(condition_->evaluate(combined, outputSchema_))) {
+                if (isTrue(condition_->evaluate(combined, outputSchema_))) {
                     tuple = combined;
                     return true; // Found a match
                 }
@@ -340,6 +669,9 @@ public:
     }
     
     const Schema& getSchema() const override { return outputSchema_; }
+    Operator* getLeft() const { return left_.get(); }
+    Operator* getRight() const { return right_.get(); }
+    const Expression& getCondition() const { return *condition_; }
 
 private:
     bool loadNextLeftBlock() {
@@ -367,61 +699,101 @@ private:
 };
 // --- Hash Join Operator ---
 // Performs an efficient equijoin by hashing one table and probing with the other.
+// Which rows a join returns besides the matching pairs: none (INNER), the left rows without
+// a match (LEFT), the right rows without a match (RIGHT), or both (FULL). The missing side
+// is filled with NULLs.
+enum class JoinType { INNER, LEFT, RIGHT, FULL };
+
+// Index of a join key in the input tuples when the key is a plain column reference, else -1.
+// Joins read such keys straight from the tuple instead of evaluating the expression.
+inline int keyColumnIndex(const Expression& key, const Schema& schema) {
+    auto* col = dynamic_cast<const ColumnRefExpression*>(&key);
+    return col ? static_cast<int>(schema.getColumn(col->getColumnName()).index) : -1;
+}
+
 class HashJoinOperator : public Operator {
 public:
     HashJoinOperator(std::unique_ptr<Operator> left, std::unique_ptr<Operator> right, 
-                     std::unique_ptr<Expression> probeKey, std::unique_ptr<Expression> buildKey)
+                     std::unique_ptr<Expression> probeKey, std::unique_ptr<Expression> buildKey,
+                     JoinType type = JoinType::INNER)
         : probe_(std::move(left)), build_(std::move(right)), 
-          probeKeyExpr_(std::move(probeKey)), buildKeyExpr_(std::move(buildKey)) {
+          probeKeyExpr_(std::move(probeKey)), buildKeyExpr_(std::move(buildKey)), type_(type) {
         outputSchema_ = Schema::merge(probe_->getSchema(), build_->getSchema());
     }
 
     void open() override {
         // 1. Build Phase: Read all tuples from the right input and build the hash table.
+        // Dense integer keys get a direct-indexed table instead (see dense_key_index.h).
         hashTable_.clear();
+        denseIndex_.clear();
+        nullKeyRows_.clear();
         build_->open();
+        std::vector<Value> keys;
+        std::vector<Tuple> tuples;
         Tuple buildTuple;
+        int buildKeyColumn = keyColumnIndex(*buildKeyExpr_, build_->getSchema());
         while (build_->next(buildTuple)) {
-            Value key = buildKeyExpr_->evaluate(buildTuple, build_->getSchema());
-            hashTable_[key].push_back(buildTuple);
+            Value key = buildKeyColumn >= 0 ? buildTuple[buildKeyColumn] : buildKeyExpr_->evaluate(buildTuple, build_->getSchema());
+            if (isNull(key)) {
+                // A NULL key never matches; right and full joins still return the row.
+                if (keepsUnmatchedBuild()) nullKeyRows_.push_back(std::move(buildTuple));
+                continue;
+            }
+            keys.push_back(std::move(key));
+            tuples.push_back(std::move(buildTuple));
         }
         build_->close();
+        if (denseIndex_.build(keys, tuples)) {
+            std::cout << "[HashJoin] Using dense array join on " << keys.size() << " build rows." << std::endl;
+        } else {
+            hashTable_.build(keys, tuples);
+        }
+        // Right and full joins remember which build rows found a partner.
+        buildMatched_.assign(keepsUnmatchedBuild() ? keys.size() : 0, 0);
 
         // 2. Probe Phase Setup: Open the left input to prepare for probing.
+        probeKeyColumn_ = keyColumnIndex(*probeKeyExpr_, probe_->getSchema());
         probe_->open();
-        hasProbeTuple_ = false; // Ensure we fetch a new probe tuple first
+        probeBatch_.clear();
+        matches_.clear();
+        matchPos_ = 0;
+        probeDone_ = false;
+        unmatchedPos_ = 0;
     }
 
     bool next(Tuple& tuple) override {
-        while (true) {
-            // If we have a valid iterator, we have more matches for the current probe tuple.
-            if (hasProbeTuple_ && matchIterator_ != matchEndIterator_) {
-                const Tuple& buildTuple = *matchIterator_;
-                tuple = probeTuple_;
+        while (!probeDone_) {
+            // Hand out the matches of the current batch of probe tuples, in probe order.
+            if (matchPos_ < matches_.size()) {
+                const auto& match = matches_[matchPos_++];
+                tuple = probeBatch_[match.first];
+                if (match.second == kNoRow) {
+                    // Left and full joins: no build row matched, pad with NULLs.
+                    tuple.resize(outputSchema_.getColumns().size(), nullValue());
+                    return true;
+                }
+                if (!buildMatched_.empty()) buildMatched_[match.second] = 1;
+                const Tuple& buildTuple = buildRow(match.second);
                 tuple.insert(tuple.end(), buildTuple.begin(), buildTuple.end());
-                matchIterator_++; // Advance to the next match for this key
                 return true;
             }
-
-            // Otherwise, get the next tuple from the probe (left) side.
-            hasProbeTuple_ = probe_->next(probeTuple_);
-            if (!hasProbeTuple_) {
-                return false; // Probe side is exhausted, join is complete.
+            if (!probeNextBatch()) {
+                probeDone_ = true; // Probe side is exhausted.
             }
+        }
 
-            // We have a new probe tuple; find its matches in the hash table.
-            Value key = probeKeyExpr_->evaluate(probeTuple_, probe_->getSchema());
-            auto range = hashTable_.find(key);
-            if (range != hashTable_.end()) {
-                // Found matches, set up iterators
-                matchIterator_ = range->second.begin();
-                matchEndIterator_ = range->second.end();
-            } else {
-                // No matches, create empty iterators
-                matchIterator_ = end(emptyVec_);
-                matchEndIterator_ = end(emptyVec_);
-            }
+        // Right and full joins end with the build rows no probe tuple matched.
+        if (!keepsUnmatchedBuild()) return false;
+        size_t probeWidth = probe_->getSchema().getColumns().size();
+        while (unmatchedPos_ < buildMatched_.size() + nullKeyRows_.size()) {
+            size_t r = unmatchedPos_++;
+            if (r < buildMatched_.size() && buildMatched_[r]) continue;
+            const Tuple& buildTuple = r < buildMatched_.size() ? buildRow(static_cast<uint32_t>(r)) : nullKeyRows_[r - buildMatched_.size()];
+            tuple.assign(probeWidth, nullValue());
+            tuple.insert(tuple.end(), buildTuple.begin(), buildTuple.end());
+            return true;
         }
+        return false; // Join is complete.
     }
 
     void close() override {
@@ -430,21 +802,179 @@ public:
     }
 
     const Schema& getSchema() const override { return outputSchema_; }
+    Operator* getProbe() const { return probe_.get(); }
+    Operator* getBuild() const { return build_.get(); }
+    const Expression& getProbeKey() const { return *probeKeyExpr_; }
+    const Expression& getBuildKey() const { return *buildKeyExpr_; }
+    JoinType getType() const { return type_; }
 
 private:
+    static constexpr size_t kProbeBatchSize = 1024;
+    static constexpr uint32_t kNoRow = static_cast<uint32_t>(-1); // Unmatched probe tuple
+
+    bool keepsUnmatchedProbe() const { return type_ == JoinType::LEFT || type_ == JoinType::FULL; }
+    bool keepsUnmatchedBuild() const { return type_ == JoinType::RIGHT || type_ == JoinType::FULL; }
+
+    const Tuple& buildRow(uint32_t row) const {
+        return denseIndex_.built() ? denseIndex_.row(row) : hashTable_.row(row);
+    }
+
+    // Pulls the next batch of probe tuples and finds all of their matches at once, so the
+    // hash table lookups can overlap their cache misses (see hash_table.h).
+    bool probeNextBatch() {
+        probeBatch_.clear();
+        probeKeys_.clear();
+        matches_.clear();
+        matchPos_ = 0;
+        Tuple probeTuple;
+        while (probeBatch_.size() < kProbeBatchSize && probe_->next(probeTuple)) {
+            probeKeys_.push_back(probeKeyColumn_ >= 0 ? probeTuple[probeKeyColumn_] : probeKeyExpr_->evaluate(probeTuple, probe_->getSchema()));
+            probeBatch_.push_back(std::move(probeTuple));
+        }
+        if (probeBatch_.empty()) return false;
+
+        if (denseIndex_.built()) {
+            for (size_t i = 0; i < probeKeys_.size(); ++i) {
+                uint32_t first, last;
+                denseIndex_.lookup(probeKeys_[i], first, last);
+                for (uint32_t r = first; r < last; ++r) matches_.emplace_back(static_cast<uint32_t>(i), r);
+            }
+        } else {
+            hashTable_.probeBatch(probeKeys_, matches_);
+        }
+
+        if (keepsUnmatchedProbe()) {
+            // Slot the probe tuples without a match in between, keeping probe order.
+            JoinHashTable::MatchList all;
+            all.reserve(matches_.size() + probeBatch_.size());
+            size_t m = 0;
+            for (uint32_t i = 0; i < probeBatch_.size(); ++i) {
+                size_t before = all.size();
+                while (m < matches_.size() && matches_[m].first == i) all.push_back(matches_[m++]);
+                if (all.size() == before) all.emplace_back(i, kNoRow);
+            }
+            matches_.swap(all);
+        }
+        return true;
+    }
+
     std::unique_ptr<Operator> probe_; // Left input
     std::unique_ptr<Operator> build_; // Right input
     std::unique_ptr<Expression> probeKeyExpr_;
     std::unique_ptr<Expression> buildKeyExpr_;
+    JoinType type_;
     Schema outputSchema_;
 
     // State for the hash join algorithm
-    std::unordered_map<Value, std::vector<Tuple>> hashTable_;
-    Tuple probeTuple_;
-    bool hasProbeTuple_ = false;
-    std::vector<Tuple> emptyVec_; // For failed lookups
-
-    // Iterators to navigate matches for the current probe tuple
-    std::vector<Tuple>::const_iterator matchIterator_;
-    std::vector<Tuple>::const_iterator matchEndIterator_;
-};
\ No newline at end of file
+    JoinHashTable hashTable_;
+    DenseKeyIndex denseIndex_; // Used instead of hashTable_ for dense integer keys
+    int probeKeyColumn_ = -1;
+
+    // The current batch of probe tuples and their matches as (probe index, build row) pairs.
+    std::vector<Tuple> probeBatch_;
+    std::vector<Value> probeKeys_;
+    JoinHashTable::MatchList matches_;
+    size_t matchPos_ = 0;
+    bool probeDone_ = false;
+
+    // Right and full joins: one flag per build row, set once it has been matched, and the
+    // build rows with a NULL key. Both are returned padded with NULLs after the probe.
+    std::vector<uint8_t> buildMatched_;
+    std::vector<Tuple> nullKeyRows_;
+    size_t unmatchedPos_ = 0;
+};
+
+
+// --- Hash Semi/Anti Join Operator ---
+// Returns the left tuples that have at least one match in the right input (semi join, like
+// EXISTS or IN), or none at all (anti join, like NOT EXISTS or NOT IN). Only the distinct
+// right keys are kept, and a probe stops at its first match, so each left tuple comes out
+// at most once and nothing from the right side is copied.
+class HashSemiJoinOperator : public Operator {
+public:
+    HashSemiJoinOperator(std::unique_ptr<Operator> left, std::unique_ptr<Operator> right,
+                         std::unique_ptr<Expression> probeKey, std::unique_ptr<Expression> buildKey, bool anti)
+        : probe_(std::move(left)), build_(std::move(right)),
+          probeKeyExpr_(std::move(probeKey)), buildKeyExpr_(std::move(buildKey)), anti_(anti) {
+        outputSchema_ = probe_->getSchema();
+    }
+
+    void open() override {
+        // Build Phase: only the keys of the right input are needed.
+        build_->open();
+        std::vector<Value> keys;
+        Tuple buildTuple;
+        int buildKeyColumn = keyColumnIndex(*buildKeyExpr_, build_->getSchema());
+        while (build_->next(buildTuple)) {
+            Value key = buildKeyColumn >= 0 ? std::move(buildTuple[buildKeyColumn]) : buildKeyExpr_->evaluate(buildTuple, build_->getSchema());
+            if (!isNull(key)) keys.push_back(std::move(key)); // NULL never matches
+        }
+        build_->close();
+        keySet_.buildKeys(keys);
+        std::cout << "[HashJoin] " << (anti_ ? "Anti" : "Semi") << " join on " << keySet_.keyCount()
+                  << " distinct keys of " << keys.size() << " build rows." << std::endl;
+
+        probeKeyColumn_ = keyColumnIndex(*probeKeyExpr_, probe_->getSchema());
+        probe_->open();
+        probeBatch_.clear();
+        batchPos_ = 0;
+    }
+
+    bool next(Tuple& tuple) override {
+        while (true) {
+            while (batchPos_ < probeBatch_.size()) {
+                size_t i = batchPos_++;
+                if (static_cast<bool>(found_[i]) != anti_) {
+                    tuple = std::move(probeBatch_[i]);
+                    return true;
+                }
+            }
+            if (!probeNextBatch()) return false;
+        }
+    }
+
+    void close() override {
+        probe_->close();
+        // build_ is already closed after the build phase
+    }
+
+    const Schema& getSchema() const override { return outputSchema_; }
+    Operator* getProbe() const { return probe_.get(); }
+    Operator* getBuild() const { return build_.get(); }
+    const Expression& getProbeKey() const { return *probeKeyExpr_; }
+    const Expression& getBuildKey() const { return *buildKeyExpr_; }
+    bool isAnti() const { return anti_; }
+
+private:
+    static constexpr size_t kProbeBatchSize = 1024;
+
+    // Pulls the next batch of left tuples and looks all of their keys up at once.
+    bool probeNextBatch() {
+        probeBatch_.clear();
+        probeKeys_.clear();
+        batchPos_ = 0;
+        Tuple probeTuple;
+        while (probeBatch_.size() < kProbeBatchSize && probe_->next(probeTuple)) {
+            probeKeys_.push_back(probeKeyColumn_ >= 0 ? probeTuple[probeKeyColumn_] : probeKeyExpr_->evaluate(probeTuple, probe_->getSchema()));
+            probeBatch_.push_back(std::move(probeTuple));
+        }
+        if (probeBatch_.empty()) return false;
+        keySet_.containsBatch(probeKeys_, found_);
+        return true;
+    }
+
+    std::unique_ptr<Operator> probe_; // Left input, the one whose tuples are returned
+    std::unique_ptr<Operator> build_; // Right input, only its keys are kept
+    std::unique_ptr<Expression> probeKeyExpr_;
+    std::unique_ptr<Expression> buildKeyExpr_;
+    bool anti_;
+    Schema outputSchema_;
+
+    JoinHashTable keySet_;
+    int probeKeyColumn_ = -1;
+
+    std::vector<Tuple> probeBatch_;
+    std::vector<Value> probeKeys_;
+    std::vector<uint8_t> found_;
+    size_t batchPos_ = 0;
+};
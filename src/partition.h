@@ -0,0 +1,257 @@
+#pragma once
+
+#include "catalog.h"
+#include "csv.h"
+#include "line_reader.h"
+#include "zone_map.h"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <fnmatch.h>
+#include <mutex>
+#include <thread>
+
+/*
+    Partitioned (multi-file) tables. A schema whose "file" is a glob or a directory, e.g.
+
+        { "name": "orders_by_year", "file": "orders_by_year",
+          "partition_keys": ["order_year"], "columns": [...] }
+
+    with files like orders_by_year/order_year=2024/part-0.csv, describes one table stored
+    as many CSV files (plain or compressed). Hive-style key=value directory names give the
+    partition key values of every file below them, and the key columns themselves are not
+    stored in the files. Plans scan such a table by its "name".
+
+    Before reading anything, the scan evaluates its pushed-down "column <op> constant"
+    predicates on the partition values of each file and drops files that cannot match.
+    The remaining files are read by several threads at once; rows are still returned file
+    by file in path order.
+*/
+
+struct PartitionFile {
+    std::string path;
+    std::vector<Value> keyValues; // One per PartitionSpec::keys
+};
+
+namespace partition_detail {
+
+inline bool hasWildcard(const std::string& s) {
+    return s.find_first_of("*?[") != std::string::npos;
+}
+
+inline bool isTableFile(const std::filesystem::path& p) {
+    std::string name = stripCompressionSuffix(p.filename().string());
+    return name.size() > 4 && name.compare(name.size() - 4, 4, ".csv") == 0;
+}
+
+// Expands a relative glob one path component at a time.
+inline void expand(const std::filesystem::path& base, const std::vector<std::string>& parts, size_t i,
+                   std::vector<std::string>& out) {
+    if (i == parts.size()) {
+        if (std::filesystem::is_regular_file(base)) out.push_back(base.string());
+        return;
+    }
+    if (!hasWildcard(parts[i])) {
+        std::filesystem::path next = base / parts[i];
+        if (std::filesystem::exists(next)) expand(next, parts, i + 1, out);
+        return;
+    }
+    if (!std::filesystem::is_directory(base)) return;
+    for (const auto& entry : std::filesystem::directory_iterator(base)) {
+        std::string name = entry.path().filename().string();
+        if (fnmatch(parts[i].c_str(), name.c_str(), FNM_PERIOD) == 0) expand(entry.path(), parts, i + 1, out);
+    }
+}
+
+} // namespace partition_detail
+
+// Lists the files of a partitioned table, sorted by path, with their partition values.
+inline std::vector<PartitionFile> listPartitionFiles(const PartitionSpec& spec, const Schema& schema, const std::string& dataDir) {
+    std::filesystem::path root = std::filesystem::path(dataDir) / spec.pattern;
+    std::vector<std::string> paths;
+    if (std::filesystem::is_directory(root)) {
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(root)) {
+            if (entry.is_regular_file() && partition_detail::isTableFile(entry.path())) paths.push_back(entry.path().string());
+        }
+    } else {
+        std::vector<std::string> parts;
+        for (const auto& part : std::filesystem::path(spec.pattern)) {
+            if (!part.empty() && part != ".") parts.push_back(part.string());
+        }
+        partition_detail::expand(std::filesystem::path(dataDir), parts, 0, paths);
+    }
+    std::sort(paths.begin(), paths.end());
+
+    const auto& cols = schema.getColumns();
+    std::vector<PartitionFile> files;
+    for (const auto& path : paths) {
+        PartitionFile file;
+        file.path = path;
+        file.keyValues.resize(spec.keys.size());
+        std::vector<bool> found(spec.keys.size(), false);
+        for (const auto& part : std::filesystem::path(path).lexically_relative(dataDir)) {
+            std::string component = part.string();
+            size_t eq = component.find('=');
+            if (eq == std::string::npos) continue;
+            for (size_t k = 0; k < spec.keys.size(); ++k) {
+                if (component.compare(0, eq, spec.keys[k]) != 0 || eq != spec.keys[k].size()) continue;
+                try {
+                    file.keyValues[k] = parseField(component.substr(eq + 1), cols[spec.keyColumns[k]].type);
+                } catch (const std::exception&) {
+                    throw std::runtime_error("Bad value for partition key '" + spec.keys[k] + "' in " + path);
+                }
+                found[k] = true;
+            }
+        }
+        for (size_t k = 0; k < spec.keys.size(); ++k) {
+            if (!found[k]) throw std::runtime_error("No value for partition key '" + spec.keys[k] + "' in the path of " + path);
+        }
+        files.push_back(std::move(file));
+    }
+    return files;
+}
+
+// True when the file's partition values may satisfy every predicate on a partition key.
+// Reuses the zone map check with a single-value zone.
+inline bool partitionMayMatch(const PartitionFile& file, const PartitionSpec& spec,
+                              const std::vector<ZonePredicate>& predicates, const std::vector<Value>& constants) {
+    for (size_t p = 0; p < predicates.size(); ++p) {
+        for (size_t k = 0; k < spec.keyColumns.size(); ++k) {
+            if (predicates[p].column != spec.keyColumns[k]) continue;
+            ColumnStats zone;
+            zone.update(file.keyValues[k]);
+            if (!zoneMayMatch(zone, predicates[p].op, constants[p])) return false;
+        }
+    }
+    return true;
+}
+
+// Reads a list of files with a few worker threads. Each file gets its own small queue of
+// row batches; the reader drains them in file order. Workers claim files in order too, so
+// the file being read is always being worked on and the pipeline cannot stall.
+class PartitionedScan {
+public:
+    PartitionedScan(std::vector<PartitionFile> files, const Schema& schema, const PartitionSpec& spec,
+                    size_t threads = std::thread::hardware_concurrency())
+        : files_(std::move(files)), schema_(schema), spec_(spec), slots_(files_.size()) {
+        std::vector<bool> isKey(schema_.getColumns().size(), false);
+        for (size_t col : spec_.keyColumns) isKey[col] = true;
+        for (const auto& col : schema_.getColumns()) {
+            if (!isKey[col.index]) fileColumns_.push_back(col);
+        }
+        threads = std::max<size_t>(1, std::min({threads, files_.size(), size_t(8)}));
+        for (size_t i = 0; i < threads && !files_.empty(); ++i) {
+            workers_.emplace_back([this] { work(); });
+        }
+    }
+
+    ~PartitionedScan() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        changed_.notify_all();
+        for (auto& worker : workers_) worker.join();
+    }
+
+    bool next(Tuple& tuple) {
+        while (batchRow_ >= batch_.size()) {
+            if (current_ >= files_.size()) return false;
+            std::unique_lock<std::mutex> lock(mutex_);
+            Slot& slot = slots_[current_];
+            changed_.wait(lock, [&slot] { return !slot.batches.empty() || slot.done; });
+            if (slot.error) std::rethrow_exception(slot.error);
+            if (slot.batches.empty()) {
+                current_++; // This file is finished.
+                continue;
+            }
+            batch_ = std::move(slot.batches.front());
+            slot.batches.pop_front();
+            batchRow_ = 0;
+            changed_.notify_all();
+        }
+        tuple = std::move(batch_[batchRow_++]);
+        return true;
+    }
+
+private:
+    static constexpr size_t kBatchRows = 4096;
+    static constexpr size_t kMaxQueuedBatches = 8; // Per file
+
+    struct Slot {
+        std::deque<std::vector<Tuple>> batches;
+        bool done = false;
+        std::exception_ptr error;
+    };
+
+    void work() {
+        while (true) {
+            size_t f;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (stopping_ || nextFile_ >= files_.size()) return;
+                f = nextFile_++;
+            }
+            try {
+                readFile(f);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                slots_[f].error = std::current_exception();
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            slots_[f].done = true;
+            changed_.notify_all();
+        }
+    }
+
+    void readFile(size_t f) {
+        const PartitionFile& file = files_[f];
+        LineReader reader(file.path);
+        std::string line;
+        reader.getline(line); // Skip the header row.
+
+        size_t width = schema_.getColumns().size();
+        std::vector<Tuple> batch;
+        Tuple fields;
+        while (reader.getline(line)) {
+            if (!parseCsvLine(line, fileColumns_, fields)) continue;
+            // Put the file's columns and the partition values in schema order.
+            Tuple row(width);
+            for (size_t i = 0; i < fields.size() && i < fileColumns_.size(); ++i) row[fileColumns_[i].index] = std::move(fields[i]);
+            for (size_t k = 0; k < spec_.keyColumns.size(); ++k) row[spec_.keyColumns[k]] = file.keyValues[k];
+            batch.push_back(std::move(row));
+            if (batch.size() == kBatchRows && !publish(f, batch)) return;
+        }
+        if (!batch.empty()) publish(f, batch);
+    }
+
+    // Hands a batch to the reader, waiting while this file's queue is full.
+    bool publish(size_t f, std::vector<Tuple>& batch) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        Slot& slot = slots_[f];
+        changed_.wait(lock, [this, &slot] { return stopping_ || slot.batches.size() < kMaxQueuedBatches; });
+        if (stopping_) return false;
+        slot.batches.push_back(std::move(batch));
+        batch.clear();
+        changed_.notify_all();
+        return true;
+    }
+
+    std::vector<PartitionFile> files_;
+    Schema schema_;
+    PartitionSpec spec_;
+    std::vector<ColumnInfo> fileColumns_; // Schema columns minus the partition keys
+
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::vector<Slot> slots_;
+    size_t nextFile_ = 0;
+    bool stopping_ = false;
+    std::vector<std::thread> workers_;
+
+    // Reader-only state.
+    size_t current_ = 0;
+    std::vector<Tuple> batch_;
+    size_t batchRow_ = 0;
+};
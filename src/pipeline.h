@@ -0,0 +1,327 @@
+#pragma once
+
+#include "operator.h"
+#include "aggregate.h"
+#include "fused_pipeline.h"
+#include <memory>
+
+/*
+    Push-based execution. Instead of every operator pulling single tuples from its child
+    through next(), the plan is cut into pipelines at the pipeline breakers (the build side
+    of a hash join, aggregation): each pipeline has a source that produces batches of up to
+    kPushBatchSize rows and pushes them through a chain of consume() calls, ending in a
+    sink. Within a pipeline rows never go back up through virtual next() calls, which is
+    what later lets a whole pipeline be fused into one loop or run on morsels in parallel.
+
+    Pipelines are built from an ordinary operator tree, so parsing, pushdown and late
+    materialization are shared with the pull engine:
+
+        Select          -> FilterStage
+        Project         -> ProjectStage
+        Limit           -> LimitStage (tells the source to stop once it has enough)
+        inner HashJoin  -> the build side's pipeline ends in a HashBuildSink; the probe side
+                           continues through a HashProbeStage into the join's consumer
+        Aggregate       -> the input's pipeline ends in an AggregateSink; a new pipeline
+                           starts from the aggregate's results
+
+    Any other operator (scans, sorts, the other join kinds, set operations, fused pipelines
+    from fused_pipeline.h...) becomes a pipeline source through the adapter: its own
+    open()/next() is pulled in batches. A plan selects this engine with "engine": "push" on
+    any node; that subtree then runs as a PipelineOperator, itself an ordinary Operator to
+    whatever is above it.
+*/
+
+constexpr size_t kPushBatchSize = 1024;
+
+using TupleBatch = std::vector<Tuple>;
+
+// A step of a pipeline. consume() may modify the batch; it returns false once it (and
+// everything after it) needs no more input.
+class PushStage {
+public:
+    virtual ~PushStage() = default;
+    virtual bool consume(TupleBatch& batch) = 0;
+    virtual void finish() {} // The source is exhausted
+    virtual std::string describe() const = 0;
+};
+
+namespace pipeline_detail {
+
+// Stages that pass their output on to another stage.
+class ChainedStage : public PushStage {
+public:
+    explicit ChainedStage(std::unique_ptr<PushStage> next) : next_(std::move(next)) {}
+    void finish() override { next_->finish(); }
+
+protected:
+    std::string describeNext(const std::string& self) const { return self + " -> " + next_->describe(); }
+    std::unique_ptr<PushStage> next_;
+};
+
+class FilterStage : public ChainedStage {
+public:
+    FilterStage(const SelectOperator& select, std::unique_ptr<PushStage> next)
+        : ChainedStage(std::move(next)), predicate_(select.getPredicate()), schema_(select.getSchema()) {}
+
+    bool consume(TupleBatch& batch) override {
+        size_t kept = 0;
+        for (auto& row : batch) {
+            if (isTrue(predicate_.evaluate(row, schema_))) {
+                if (&batch[kept] != &row) batch[kept] = std::move(row);
+                kept++;
+            }
+        }
+        batch.resize(kept);
+        return kept == 0 || next_->consume(batch);
+    }
+
+    std::string describe() const override { return describeNext("Filter"); }
+
+private:
+    const Expression& predicate_;
+    const Schema& schema_;
+};
+
+class ProjectStage : public ChainedStage {
+public:
+    ProjectStage(const ProjectOperator& project, std::unique_ptr<PushStage> next)
+        : ChainedStage(std::move(next)), project_(project), inputSchema_(project.getInput()->getSchema()) {}
+
+    bool consume(TupleBatch& batch) override {
+        out_.resize(batch.size());
+        const auto& exprs = project_.getExpressions();
+        for (size_t i = 0; i < batch.size(); ++i) {
+            project_.fetchLateColumns(batch[i]);
+            out_[i].clear();
+            for (const auto& p : exprs) out_[i].push_back(p.expr->evaluate(batch[i], inputSchema_));
+        }
+        return next_->consume(out_);
+    }
+
+    std::string describe() const override { return describeNext("Project"); }
+
+private:
+    const ProjectOperator& project_;
+    const Schema& inputSchema_;
+    TupleBatch out_;
+};
+
+class LimitStage : public ChainedStage {
+public:
+    LimitStage(size_t limit, std::unique_ptr<PushStage> next) : ChainedStage(std::move(next)), remaining_(limit) {}
+
+    bool consume(TupleBatch& batch) override {
+        if (batch.size() > remaining_) batch.resize(remaining_);
+        remaining_ -= batch.size();
+        bool more = batch.empty() || next_->consume(batch);
+        return more && remaining_ > 0;
+    }
+
+    std::string describe() const override { return describeNext("Limit"); }
+
+private:
+    size_t remaining_;
+};
+
+// The hash table of an inner hash join, filled by the build pipeline and read by the
+// probe pipeline.
+struct JoinBuildState {
+    JoinHashTable table;
+    std::vector<Value> keys;
+    TupleBatch rows;
+};
+
+class HashBuildSink : public PushStage {
+public:
+    HashBuildSink(std::shared_ptr<JoinBuildState> state, const HashJoinOperator& join)
+        : state_(std::move(state)), keyExpr_(join.getBuildKey()), schema_(join.getBuild()->getSchema()),
+          keyColumn_(keyColumnIndex(keyExpr_, schema_)) {}
+
+    bool consume(TupleBatch& batch) override {
+        for (auto& row : batch) {
+            Value key = keyColumn_ >= 0 ? row[keyColumn_] : keyExpr_.evaluate(row, schema_);
+            if (isNull(key)) continue; // Never matches in an inner join
+            state_->keys.push_back(std::move(key));
+            state_->rows.push_back(std::move(row));
+        }
+        return true;
+    }
+
+    void finish() override {
+        state_->table.build(state_->keys, state_->rows);
+        state_->keys.clear();
+    }
+
+    std::string describe() const override { return "HashBuild"; }
+
+private:
+    std::shared_ptr<JoinBuildState> state_;
+    const Expression& keyExpr_;
+    const Schema& schema_;
+    int keyColumn_;
+};
+
+class HashProbeStage : public ChainedStage {
+public:
+    HashProbeStage(std::shared_ptr<JoinBuildState> state, const HashJoinOperator& join, std::unique_ptr<PushStage> next)
+        : ChainedStage(std::move(next)), state_(std::move(state)), keyExpr_(join.getProbeKey()),
+          schema_(join.getProbe()->getSchema()), keyColumn_(keyColumnIndex(keyExpr_, schema_)) {}
+
+    bool consume(TupleBatch& batch) override {
+        keys_.clear();
+        for (const auto& row : batch) keys_.push_back(keyColumn_ >= 0 ? row[keyColumn_] : keyExpr_.evaluate(row, schema_));
+        matches_.clear();
+        state_->table.probeBatch(keys_, matches_);
+        if (matches_.empty()) return true;
+        out_.resize(matches_.size());
+        for (size_t m = 0; m < matches_.size(); ++m) {
+            const Tuple& buildRow = state_->table.row(matches_[m].second);
+            out_[m] = batch[matches_[m].first];
+            out_[m].insert(out_[m].end(), buildRow.begin(), buildRow.end());
+        }
+        return next_->consume(out_);
+    }
+
+    std::string describe() const override { return describeNext("HashProbe"); }
+
+private:
+    std::shared_ptr<JoinBuildState> state_;
+    const Expression& keyExpr_;
+    const Schema& schema_;
+    int keyColumn_;
+    std::vector<Value> keys_;
+    JoinHashTable::MatchList matches_;
+    TupleBatch out_;
+};
+
+class AggregateSink : public PushStage {
+public:
+    explicit AggregateSink(HashAggregateOperator& aggregate) : aggregate_(aggregate) { aggregate_.beginInput(); }
+
+    bool consume(TupleBatch& batch) override {
+        for (const auto& row : batch) aggregate_.addRow(row);
+        return true;
+    }
+
+    void finish() override { aggregate_.finishInput(); }
+    std::string describe() const override { return "AggregateBuild"; }
+
+private:
+    HashAggregateOperator& aggregate_;
+};
+
+class CollectSink : public PushStage {
+public:
+    explicit CollectSink(TupleBatch& rows) : rows_(rows) {}
+
+    bool consume(TupleBatch& batch) override {
+        for (auto& row : batch) rows_.push_back(std::move(row));
+        return true;
+    }
+
+    std::string describe() const override { return "Output"; }
+
+private:
+    TupleBatch& rows_;
+};
+
+} // namespace pipeline_detail
+
+// One pipeline: a source operator pulled in batches and the chain its rows are pushed into.
+struct Pipeline {
+    Operator* source;
+    bool openSource; // False when the source was already filled by an earlier pipeline
+    std::unique_ptr<PushStage> chain;
+
+    void run() {
+        if (openSource) source->open();
+        // Rows are read straight into the batch, so tuples a stage leaves in place keep
+        // their storage for the next batch.
+        TupleBatch batch;
+        bool more = true;
+        while (more) {
+            batch.resize(kPushBatchSize);
+            size_t n = 0;
+            while (n < kPushBatchSize && source->next(batch[n])) n++;
+            if (n == 0) break;
+            batch.resize(n);
+            more = chain->consume(batch);
+        }
+        source->close();
+        chain->finish();
+    }
+};
+
+// Cuts an operator tree into pipelines, in the order they must run (every pipeline after
+// the ones that fill the breakers it reads from).
+inline void buildPipelines(Operator* op, std::unique_ptr<PushStage> consumer, std::vector<Pipeline>& out) {
+    using namespace pipeline_detail;
+    if (auto* select = dynamic_cast<SelectOperator*>(op)) {
+        buildPipelines(select->getInput(), std::make_unique<FilterStage>(*select, std::move(consumer)), out);
+        return;
+    }
+    if (auto* project = dynamic_cast<ProjectOperator*>(op)) {
+        buildPipelines(project->getInput(), std::make_unique<ProjectStage>(*project, std::move(consumer)), out);
+        return;
+    }
+    if (auto* limit = dynamic_cast<LimitOperator*>(op)) {
+        size_t n = static_cast<size_t>(std::max(0, limit->getLimit()));
+        buildPipelines(limit->getInput(), std::make_unique<LimitStage>(n, std::move(consumer)), out);
+        return;
+    }
+    if (auto* join = dynamic_cast<HashJoinOperator*>(op)) {
+        if (join->getType() == JoinType::INNER) {
+            auto state = std::make_shared<JoinBuildState>();
+            buildPipelines(join->getBuild(), std::make_unique<HashBuildSink>(state, *join), out);
+            buildPipelines(join->getProbe(), std::make_unique<HashProbeStage>(state, *join, std::move(consumer)), out);
+            return;
+        }
+    }
+    if (auto* aggregate = dynamic_cast<HashAggregateOperator*>(op)) {
+        buildPipelines(aggregate->getInput(), std::make_unique<AggregateSink>(*aggregate), out);
+        out.push_back({aggregate, false, std::move(consumer)});
+        return;
+    }
+    out.push_back({op, true, std::move(consumer)}); // Adapter: pull the operator itself
+}
+
+// Runs an operator tree with the push engine. All pipelines run in open(); next() hands
+// out the collected result.
+class PipelineOperator : public Operator {
+public:
+    explicit PipelineOperator(std::unique_ptr<Operator> root) : root_(std::move(root)) {}
+
+    void open() override {
+        rows_.clear();
+        pos_ = 0;
+        std::vector<Pipeline> pipelines;
+        buildPipelines(root_.get(), std::make_unique<pipeline_detail::CollectSink>(rows_), pipelines);
+        for (size_t i = 0; i < pipelines.size(); ++i) {
+            std::cout << "[Pipeline] " << i + 1 << "/" << pipelines.size() << ": " << sourceName(pipelines[i])
+                      << " -> " << pipelines[i].chain->describe() << std::endl;
+        }
+        for (auto& pipeline : pipelines) pipeline.run();
+    }
+
+    bool next(Tuple& tuple) override {
+        if (pos_ >= rows_.size()) return false;
+        tuple = std::move(rows_[pos_++]);
+        return true;
+    }
+
+    void close() override { rows_.clear(); }
+    const Schema& getSchema() const override { return root_->getSchema(); }
+    Operator* getRoot() const { return root_.get(); }
+
+private:
+    static std::string sourceName(const Pipeline& pipeline) {
+        if (auto* scan = dynamic_cast<ScanOperator*>(pipeline.source)) return "Scan(" + scan->getAlias() + ")";
+        if (dynamic_cast<HashAggregateOperator*>(pipeline.source)) return "AggregateResults";
+        if (dynamic_cast<FusedPipelineOperator*>(pipeline.source)) return "FusedPipeline";
+        return "Operator";
+    }
+
+    std::unique_ptr<Operator> root_;
+    TupleBatch rows_;
+    size_t pos_ = 0;
+};
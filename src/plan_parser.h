@@ -2,14 +2,23 @@
 
 #include "operator.h"
 #include "expression.h"
+#include "late_materialization.h"
+#include "merge_join.h"
+#include "aggregate.h"
+#include "set_ops.h"
+#include "pipeline.h"
+#include "fused_pipeline.h"
+#include "codegen.h"
 #include <nlohmann/json.hpp>
 #include <set> // Added for predicate pushdown helpers
+#include <map>
 
 using json = nlohmann::json;
 
 // Forward declarations because parsePlan and parseExpression can call each other.
-std::unique_ptr<Expression> parseExpression(const json& exprJson);
-std::unique_ptr<Operator> parsePlan(const json& planJson, Catalog& catalog, const std::string& dataDir);
+// The optional ParameterSet collects {"param": ...} placeholders for prepared plans.
+std::unique_ptr<Expression> parseExpression(const json& exprJson, ParameterSet* params = nullptr);
+std::unique_ptr<Operator> parsePlan(const json& planJson, Catalog& catalog, const std::string& dataDir, ParameterSet* params = nullptr);
 
 // --- HELPER FUNCTIONS FOR PREDICATE PUSHDOWN ---
 
@@ -33,9 +42,30 @@ inline bool isSubsetOf(const std::set<std::string>& predicateCols, const std::se
     return true;
 }
 
+// Hands a Select predicate to the scan it filters (looking through any Selects stacked
+// in between), so the scan can skip blocks using its zone maps. The walk stops at a
+// Sample: it picks rows by their position in its input, so pruning below it would make
+// the same seed select different rows.
+inline void registerPruningPredicate(Operator* input, const Expression& predicate) {
+    while (auto* select = dynamic_cast<SelectOperator*>(input)) input = select->getInput();
+    if (auto* scan = dynamic_cast<ScanOperator*>(input)) {
+        scan->addPruningPredicate(predicate);
+    }
+}
+
+
+// Sets "compile": true on every Project of a plan ("engine": "compiled").
+inline void markForCompilation(json& planJson) {
+    if (planJson.is_object()) {
+        if (planJson.contains("op") && planJson["op"] == "Project") planJson["compile"] = true;
+        for (auto& item : planJson.items()) markForCompilation(item.value());
+    } else if (planJson.is_array()) {
+        for (auto& item : planJson) markForCompilation(item);
+    }
+}
 
 // Parses an expression object from the JSON plan.
-inline std::unique_ptr<Expression> parseExpression(const json& exprJson) {
+inline std::unique_ptr<Expression> parseExpression(const json& exprJson, ParameterSet* params) {
     if (exprJson.contains("const")) {
         const auto& type = exprJson["type"];
         if (type == "int") return std::make_unique<ConstantExpression>(exprJson["const"].get<int>());
@@ -43,100 +73,179 @@ inline std::unique_ptr<Expression> parseExpression(const json& exprJson) {
         if (type == "string") return std::make_unique<ConstantExpression>(exprJson["const"].get<std::string>());
         if (type == "bool") return std::make_unique<ConstantExpression>(exprJson["const"].get<bool>());
     }
+    if (exprJson.contains("param")) {
+        // A placeholder such as {"param": "year", "type": "int"}, bound at execution time.
+        std::string name = exprJson["param"];
+        if (!params) {
+            throw std::runtime_error("Parameter '" + name + "' used outside of a prepared plan.");
+        }
+        return std::make_unique<ParameterExpression>(params->declare(name, stringToType(exprJson["type"])));
+    }
     if (exprJson.contains("col")) {
         return std::make_unique<ColumnRefExpression>(exprJson["col"]);
     }
     if (exprJson.contains("op")) {
         std::string op = exprJson["op"];
         if (op == "NOT") {
-            return std::make_unique<NotExpression>(parseExpression(exprJson["expr"]));
+            return std::make_unique<NotExpression>(parseExpression(exprJson["expr"], params));
+        }
+        if (op == "IS_NULL" || op == "IS_NOT_NULL") {
+            return std::make_unique<NullTestExpression>(parseExpression(exprJson["expr"], params), op == "IS_NOT_NULL");
         }
         // If it's not NOT, it must be a binary expression
         return std::make_unique<BinaryExpression>(
             op,
-            parseExpression(exprJson["left"]),
-            parseExpression(exprJson["right"])
+            parseExpression(exprJson["left"], params),
+            parseExpression(exprJson["right"], params)
         );
     }
     throw std::runtime_error("Invalid expression JSON");
 }
 
 // Parses the main query plan object to build the operator tree.
-inline std::unique_ptr<Operator> parsePlan(const json& planJson, Catalog& catalog, const std::string& dataDir) {
+inline std::unique_ptr<Operator> parsePlan(const json& planJson, Catalog& catalog, const std::string& dataDir, ParameterSet* params) {
     std::string op = planJson["op"];
 
+    // "engine": "push" runs this subtree with the push-based pipeline engine (pipeline.h);
+    // "compiled" compiles every Project pipeline in it to native code (codegen.h).
+    if (planJson.contains("engine")) {
+        std::string engine = planJson["engine"];
+        if (engine != "push" && engine != "pull" && engine != "compiled") throw std::runtime_error("Unknown engine: " + engine);
+        json inner = planJson;
+        inner.erase("engine");
+        if (engine == "compiled") markForCompilation(inner);
+        auto root = parsePlan(inner, catalog, dataDir, params);
+        if (engine != "push") return root;
+        return std::make_unique<PipelineOperator>(std::move(root));
+    }
+
     // A local lambda to handle parsing any kind of join.
     // This avoids code duplication since a join can be a top-level operator
     // or exist underneath a Select operator.
     auto parseJoin = [&](const json& joinJson) -> std::unique_ptr<Operator> {
-        std::string method = "nested_loop"; // Default join method
+        // "type" is "inner" (the default); "left", "right" or "full" for outer joins; or
+        // "semi"/"anti" to return the left tuples that have (or do not have) a match, like
+        // EXISTS / IN and NOT EXISTS / NOT IN.
+        std::string type = joinJson.value("type", "inner");
+        static const std::map<std::string, JoinType> joinTypes = {
+            {"inner", JoinType::INNER}, {"left", JoinType::LEFT}, {"right", JoinType::RIGHT}, {"full", JoinType::FULL}};
+        bool semiOrAnti = type == "semi" || type == "anti";
+        if (!semiOrAnti && !joinTypes.count(type)) {
+            throw std::runtime_error("Unknown join type: " + type);
+        }
+        JoinType joinType = semiOrAnti ? JoinType::INNER : joinTypes.at(type);
+
+        std::string method = type == "inner" ? "nested_loop" : "hash"; // Default join method
         if (joinJson.contains("method")) {
             method = joinJson["method"];
         }
 
-        if (method == "hash") {
-            std::cout << "[Planner] Using Hash Join." << std::endl;
+        // Parses an equi-join condition into (left key, right key), whichever way round the
+        // plan writes it.
+        auto parseEquiKeys = [&](const Operator& left, const Operator& right, const std::string& what) {
             const auto& condJson = joinJson["condition"];
             if (!condJson.contains("op") || condJson["op"] != "EQ") {
-                throw std::runtime_error("Hash join only supports equality predicates.");
+                throw std::runtime_error(what + " only supports equality predicates.");
             }
+            auto leftKey = parseExpression(condJson["left"], params);
+            auto rightKey = parseExpression(condJson["right"], params);
 
-            auto left = parsePlan(joinJson["left"], catalog, dataDir);
-            auto right = parsePlan(joinJson["right"], catalog, dataDir);
-            
-            auto leftKey = parseExpression(condJson["left"]);
-            auto rightKey = parseExpression(condJson["right"]);
-            
             // Check which key belongs to which side
-            auto leftSchemaCols = getSchemaColumnNames(left->getSchema());
+            auto leftSchemaCols = getSchemaColumnNames(left.getSchema());
             std::set<std::string> leftKeyCols, rightKeyCols;
             leftKey->collectColumnRefs(leftKeyCols);
             rightKey->collectColumnRefs(rightKeyCols);
-            
-            if (isSubsetOf(leftKeyCols, leftSchemaCols) && isSubsetOf(rightKeyCols, getSchemaColumnNames(right->getSchema()))) {
-                 return std::make_unique<HashJoinOperator>(std::move(left), std::move(right), std::move(leftKey), std::move(rightKey));
-            } else if (isSubsetOf(rightKeyCols, leftSchemaCols) && isSubsetOf(leftKeyCols, getSchemaColumnNames(right->getSchema()))) {
-                 // The keys were swapped in the plan (e.g., r.key = l.key), so we swap them back for the operator.
-                 return std::make_unique<HashJoinOperator>(std::move(left), std::move(right), std::move(rightKey), std::move(leftKey));
-            } else {
-                 throw std::runtime_error("Hash join predicate columns do not align with join inputs.");
+
+            if (isSubsetOf(leftKeyCols, leftSchemaCols) && isSubsetOf(rightKeyCols, getSchemaColumnNames(right.getSchema()))) {
+                return std::make_pair(std::move(leftKey), std::move(rightKey));
+            } else if (isSubsetOf(rightKeyCols, leftSchemaCols) && isSubsetOf(leftKeyCols, getSchemaColumnNames(right.getSchema()))) {
+                // The keys were swapped in the plan (e.g., r.key = l.key), so we swap them back for the operator.
+                return std::make_pair(std::move(rightKey), std::move(leftKey));
+            }
+            throw std::runtime_error(what + " predicate columns do not align with join inputs.");
+        };
+
+        if (semiOrAnti) {
+            bool anti = type == "anti";
+            if (method != "hash" && method != "merge") {
+                throw std::runtime_error("Semi and anti joins support the hash and merge methods only.");
+            }
+            auto left = parsePlan(joinJson["left"], catalog, dataDir, params);
+            auto right = parsePlan(joinJson["right"], catalog, dataDir, params);
+            auto keys = parseEquiKeys(*left, *right, method == "hash" ? "Hash join" : "Merge join");
+            if (method == "hash") {
+                std::cout << "[Planner] Using Hash " << (anti ? "Anti" : "Semi") << " Join." << std::endl;
+                return std::make_unique<HashSemiJoinOperator>(std::move(left), std::move(right), std::move(keys.first), std::move(keys.second), anti);
             }
+            std::cout << "[Planner] Using Merge " << (anti ? "Anti" : "Semi") << " Join." << std::endl;
+            return std::make_unique<MergeSemiJoinOperator>(std::move(left), std::move(right), std::move(keys.first), std::move(keys.second), anti);
+        }
+
+        std::string outer = joinType == JoinType::INNER ? "" : " (" + type + " outer)";
+        if (method == "hash") {
+            std::cout << "[Planner] Using Hash Join" << outer << "." << std::endl;
+            auto left = parsePlan(joinJson["left"], catalog, dataDir, params);
+            auto right = parsePlan(joinJson["right"], catalog, dataDir, params);
+            auto keys = parseEquiKeys(*left, *right, "Hash join");
+            return std::make_unique<HashJoinOperator>(std::move(left), std::move(right), std::move(keys.first), std::move(keys.second), joinType);
+        }
+
+        if (method == "merge") {
+            std::cout << "[Planner] Using Sort-Merge Join" << outer << "." << std::endl;
+            auto left = parsePlan(joinJson["left"], catalog, dataDir, params);
+            auto right = parsePlan(joinJson["right"], catalog, dataDir, params);
+            auto keys = parseEquiKeys(*left, *right, "Merge join");
+            return std::make_unique<SortMergeJoinOperator>(std::move(left), std::move(right), std::move(keys.first), std::move(keys.second), joinType);
+        }
+
+        if (joinType != JoinType::INNER) {
+            throw std::runtime_error("Outer joins support the hash and merge methods only.");
         }
         
         if (method == "block_nested_loop") {
             std::cout << "[Planner] Using Block Nested-Loop Join." << std::endl;
-            auto left = parsePlan(joinJson["left"], catalog, dataDir);
-            auto right = parsePlan(joinJson["right"], catalog, dataDir);
-            auto condition = parseExpression(joinJson["condition"]);
+            auto left = parsePlan(joinJson["left"], catalog, dataDir, params);
+            auto right = parsePlan(joinJson["right"], catalog, dataDir, params);
+            auto condition = parseExpression(joinJson["condition"], params);
             return std::make_unique<BlockNestedLoopJoinOperator>(std::move(left), std::move(right), std::move(condition));
         }
         
         // Default to original Nested-Loop Join
         std::cout << "[Planner] Using Nested-Loop Join." << std::endl;
-        auto left = parsePlan(joinJson["left"], catalog, dataDir);
-        auto right = parsePlan(joinJson["right"], catalog, dataDir);
-        auto condition = parseExpression(joinJson["condition"]);
+        auto left = parsePlan(joinJson["left"], catalog, dataDir, params);
+        auto right = parsePlan(joinJson["right"], catalog, dataDir, params);
+        auto condition = parseExpression(joinJson["condition"], params);
         return std::make_unique<NestedLoopJoinOperator>(std::move(left), std::move(right), std::move(condition));
     };
 
     if (op == "Scan") {
         std::string table = planJson["table"];
         std::string alias = planJson["as"];
-        std::string tablePath = dataDir + "/" + table;
+        std::string tablePath = resolveTableFile(dataDir + "/" + table);
         return std::make_unique<ScanOperator>(tablePath, alias, catalog);
     }
     if (op == "Select") {
         const auto& inputJson = planJson["input"];
         // --- PREDICATE PUSHDOWN LOGIC ---
         // Check if the input is a join, which is our optimization opportunity.
-        if (inputJson.contains("op") && inputJson["op"] == "Join") {
-            auto predicate = parseExpression(planJson["predicate"]);
+        std::string joinType = inputJson.contains("op") && inputJson["op"] == "Join" ? inputJson.value("type", "inner") : "";
+        if (joinType == "semi" || joinType == "anti") {
+            // Semi and anti joins only return left columns, so the filter always belongs on
+            // the left input; keep the join itself as planned.
+            std::cout << "[Optimizer] Pushing predicate to LEFT side of join." << std::endl;
+            json newJoinJson = inputJson;
+            newJoinJson["left"] = {{"op", "Select"}, {"predicate", planJson["predicate"]}, {"input", inputJson["left"]}};
+            return parseJoin(newJoinJson);
+        }
+        // Outer joins keep the Select above them (see the fallback below).
+        if (joinType == "inner") {
+            auto predicate = parseExpression(planJson["predicate"], params);
             std::set<std::string> predicateCols;
             predicate->collectColumnRefs(predicateCols);
 
             // Parse the join's children to inspect their schemas.
-            auto left = parsePlan(inputJson["left"], catalog, dataDir);
-            auto right = parsePlan(inputJson["right"], catalog, dataDir);
+            auto left = parsePlan(inputJson["left"], catalog, dataDir, params);
+            auto right = parsePlan(inputJson["right"], catalog, dataDir, params);
             
             auto leftSchemaCols = getSchemaColumnNames(left->getSchema());
             auto rightSchemaCols = getSchemaColumnNames(right->getSchema());
@@ -147,6 +256,7 @@ inline std::unique_ptr<Operator> parsePlan(const json& planJson, Catalog& catalo
             // Apply the optimization if the predicate only uses columns from the left.
             if (pushToLeft) {
                 std::cout << "[Optimizer] Pushing predicate to LEFT side of join." << std::endl;
+                registerPruningPredicate(left.get(), *predicate);
                 auto newLeft = std::make_unique<SelectOperator>(std::move(left), std::move(predicate));
                 // Re-assemble the join on top of the new, filtered input.
                 // We must use our new parseJoin lambda here to respect the chosen join method.
@@ -155,7 +265,7 @@ inline std::unique_ptr<Operator> parsePlan(const json& planJson, Catalog& catalo
                 // The "left" and "right" in the json are now irrelevant because we pass the operators directly,
                 // but the "method" and "condition" are still needed.
                 auto newRight = std::move(right);
-                auto condition = parseExpression(inputJson["condition"]);
+                auto condition = parseExpression(inputJson["condition"], params);
 
                 // This part is a bit tricky: we must manually reconstruct the correct join type
                 // since we already have the operator inputs.
@@ -173,9 +283,10 @@ inline std::unique_ptr<Operator> parsePlan(const json& planJson, Catalog& catalo
             // Apply the optimization if the predicate only uses columns from the right.
             if (pushToRight) {
                  std::cout << "[Optimizer] Pushing predicate to RIGHT side of join." << std::endl;
+                 registerPruningPredicate(right.get(), *predicate);
                  auto newRight = std::make_unique<SelectOperator>(std::move(right), std::move(predicate));
                  auto newLeft = std::move(left);
-                 auto condition = parseExpression(inputJson["condition"]);
+                 auto condition = parseExpression(inputJson["condition"], params);
                  
                  std::string method = "nested_loop";
                  if (inputJson.contains("method")) method = inputJson["method"];
@@ -188,27 +299,97 @@ inline std::unique_ptr<Operator> parsePlan(const json& planJson, Catalog& catalo
             // If predicate uses columns from both sides, it can't be pushed.
             // Build the Select on top of the Join as originally planned.
             auto join = parseJoin(inputJson);
-            return std::make_unique<SelectOperator>(std::move(join), parseExpression(planJson["predicate"]));
+            return std::make_unique<SelectOperator>(std::move(join), parseExpression(planJson["predicate"], params));
         }
         
         // --- Fallback for non-join inputs (original behavior) ---
-        auto input = parsePlan(planJson["input"], catalog, dataDir);
-        auto predicate = parseExpression(planJson["predicate"]);
+        auto input = parsePlan(planJson["input"], catalog, dataDir, params);
+        auto predicate = parseExpression(planJson["predicate"], params);
+        registerPruningPredicate(input.get(), *predicate);
         return std::make_unique<SelectOperator>(std::move(input), std::move(predicate));
     }
     if (op == "Project") {
-        auto input = parsePlan(planJson["input"], catalog, dataDir);
+        auto input = parsePlan(planJson["input"], catalog, dataDir, params);
         std::vector<ProjectOperator::ProjExpr> projExprs;
         for (const auto& exprNode : planJson["exprs"]) {
-            projExprs.push_back({exprNode["as"], parseExpression(exprNode["expr"])});
+            projExprs.push_back({exprNode["as"], parseExpression(exprNode["expr"], params)});
+        }
+        auto project = std::make_unique<ProjectOperator>(std::move(input), std::move(projExprs));
+        planLateMaterialization(*project);
+        if (planJson.value("compile", false)) {
+            if (auto compiled = planCompiledPipeline(project)) return compiled;
         }
-        return std::make_unique<ProjectOperator>(std::move(input), std::move(projExprs));
+        // Common Scan -> Select -> [HashProbe ->] Project shapes run as one compiled loop
+        // (fused_pipeline.h) unless the plan says "fuse": false.
+        if (!planJson.value("fuse", true)) return project;
+        return planFusedPipeline(std::move(project));
     }
     if (op == "Join") {
         return parseJoin(planJson);
     }
+    if (op == "Aggregate") {
+        auto input = parsePlan(planJson["input"], catalog, dataDir, params);
+        std::vector<std::string> groupBy;
+        if (planJson.contains("group_by")) {
+            for (const auto& col : planJson["group_by"]) groupBy.push_back(col.get<std::string>());
+        }
+        static const std::map<std::string, AggFn> functions = {
+            {"count", AggFn::COUNT}, {"sum", AggFn::SUM}, {"min", AggFn::MIN}, {"max", AggFn::MAX}, {"avg", AggFn::AVG},
+            {"approx_count_distinct", AggFn::APPROX_COUNT_DISTINCT}, {"approx_quantile", AggFn::APPROX_QUANTILE}};
+        std::vector<AggregateSpec> aggregates;
+        for (const auto& aggJson : planJson["aggregates"]) {
+            std::string fn = aggJson["fn"];
+            auto it = functions.find(fn);
+            if (it == functions.end()) throw std::runtime_error("Unknown aggregate function: " + fn);
+            AggregateSpec spec;
+            spec.fn = it->second;
+            spec.alias = aggJson.value("as", fn);
+            if (aggJson.contains("expr")) {
+                spec.expr = parseExpression(aggJson["expr"], params);
+            } else if (spec.fn == AggFn::COUNT) {
+                spec.fn = AggFn::COUNT_STAR;
+            } else {
+                throw std::runtime_error("Aggregate '" + fn + "' needs an \"expr\".");
+            }
+            if (spec.fn == AggFn::APPROX_QUANTILE) {
+                spec.quantile = aggJson.value("q", 0.5);
+                if (spec.quantile < 0.0 || spec.quantile > 1.0) throw std::runtime_error("approx_quantile \"q\" must be between 0 and 1.");
+            }
+            aggregates.push_back(std::move(spec));
+        }
+        size_t budget = HashAggregateOperator::kDefaultMemoryBudget;
+        if (planJson.contains("memory_mb")) budget = static_cast<size_t>(planJson["memory_mb"].get<double>() * 1048576.0);
+        return std::make_unique<HashAggregateOperator>(std::move(input), std::move(groupBy), std::move(aggregates), budget);
+    }
+    if (op == "Distinct" || op == "Union" || op == "UnionAll" || op == "Intersect" || op == "Except") {
+        std::string method = planJson.value("method", "hash");
+        if (method != "hash" && method != "sort") throw std::runtime_error("Unknown " + op + " method: " + method);
+        bool useSort = method == "sort";
+        if (op == "Distinct") {
+            return std::make_unique<DistinctOperator>(parsePlan(planJson["input"], catalog, dataDir, params), useSort);
+        }
+        auto left = parsePlan(planJson["left"], catalog, dataDir, params);
+        auto right = parsePlan(planJson["right"], catalog, dataDir, params);
+        if (op == "UnionAll" || (op == "Union" && planJson.value("all", false))) {
+            return std::make_unique<UnionAllOperator>(std::move(left), std::move(right));
+        }
+        SetOpKind kind = op == "Union" ? SetOpKind::UNION : op == "Intersect" ? SetOpKind::INTERSECT : SetOpKind::EXCEPT;
+        return std::make_unique<SetOperator>(std::move(left), std::move(right), kind, useSort);
+    }
+    if (op == "Sample") {
+        // {"op": "Sample", "method": "bernoulli" | "block", "percent": 1, "seed": 42, "input": ...}
+        std::string method = planJson.value("method", "bernoulli");
+        if (method != "bernoulli" && method != "block") throw std::runtime_error("Unknown Sample method: " + method);
+        double percent = planJson["percent"].get<double>();
+        if (percent < 0.0 || percent > 100.0) throw std::runtime_error("Sample \"percent\" must be between 0 and 100.");
+        uint64_t seed = planJson.value("seed", uint64_t(0));
+        auto input = parsePlan(planJson["input"], catalog, dataDir, params);
+        return std::make_unique<SampleOperator>(std::move(input),
+                                                method == "block" ? SampleOperator::Method::BLOCK : SampleOperator::Method::BERNOULLI,
+                                                percent / 100.0, seed);
+    }
     if (op == "Limit") {
-        auto input = parsePlan(planJson["input"], catalog, dataDir);
+        auto input = parsePlan(planJson["input"], catalog, dataDir, params);
         int limit = planJson["limit"];
         return std::make_unique<LimitOperator>(std::move(input), limit);
     }
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "executor.h"
+#include <mutex>
+
+/*
+    Prepared plans. A plan containing {"param": ..., "type": ...} placeholders is parsed and
+    planned once; each execution only binds new parameter values and re-runs the existing
+    operator tree (open/next/close), so the hash tables, buffers and schemas built by the
+    operators are reused instead of being rebuilt from JSON for every request.
+
+    One operator tree can only run one query at a time, so a PreparedPlan keeps a small
+    pool of instances and parses another one only when all of them are busy.
+*/
+
+// Converts a JSON parameter value to the type the placeholder was declared with.
+inline Value jsonToParameterValue(const json& val, DataType type, const std::string& name) {
+    switch (type) {
+        case DataType::INT:
+            if (val.is_number_integer()) return val.get<int>();
+            break;
+        case DataType::FLOAT:
+            if (val.is_number()) return val.get<float>();
+            break;
+        case DataType::STRING:
+            if (val.is_string()) return val.get<std::string>();
+            break;
+        case DataType::BOOL:
+            if (val.is_boolean()) return val.get<bool>();
+            break;
+    }
+    throw std::runtime_error("Value for parameter '" + name + "' has the wrong type.");
+}
+
+class PreparedPlan {
+public:
+    PreparedPlan(const json& planJson, Catalog& catalog, const std::string& dataDir)
+        : planJson_(planJson), catalog_(catalog), dataDir_(dataDir) {
+        // Parse the first instance right away so errors in the plan surface at prepare time.
+        idle_.push_back(makeInstance());
+        for (const auto& entry : idle_.back()->params.slots()) {
+            paramTypes_[entry.first] = entry.second->type;
+        }
+    }
+
+    const json& plan() const { return planJson_; }
+    const std::map<std::string, DataType>& parameters() const { return paramTypes_; }
+
+    // Runs the plan with the given {"name": value, ...} bindings.
+    QueryResult execute(const json& bindings) {
+        // If binding or execution throws, the instance (whose operators may be half-open)
+        // is simply dropped instead of going back to the pool.
+        std::unique_ptr<Instance> instance = acquire();
+        bind(*instance, bindings);
+        QueryResult result = runOperator(*instance->root);
+        release(std::move(instance));
+        return result;
+    }
+
+private:
+    struct Instance {
+        ParameterSet params;
+        std::unique_ptr<Operator> root;
+    };
+
+    std::unique_ptr<Instance> makeInstance() {
+        auto instance = std::make_unique<Instance>();
+        instance->root = parsePlan(planJson_, catalog_, dataDir_, &instance->params);
+        return instance;
+    }
+
+    std::unique_ptr<Instance> acquire() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!idle_.empty()) {
+                auto instance = std::move(idle_.back());
+                idle_.pop_back();
+                return instance;
+            }
+        }
+        return makeInstance();
+    }
+
+    void release(std::unique_ptr<Instance> instance) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        idle_.push_back(std::move(instance));
+    }
+
+    static void bind(Instance& instance, const json& bindings) {
+        for (const auto& entry : instance.params.slots()) {
+            ParameterSlot& slot = *entry.second;
+            if (!bindings.is_object() || !bindings.contains(slot.name)) {
+                throw std::runtime_error("Missing value for parameter '" + slot.name + "'.");
+            }
+            slot.value = jsonToParameterValue(bindings[slot.name], slot.type, slot.name);
+            slot.bound = true;
+        }
+    }
+
+    json planJson_;
+    Catalog& catalog_;
+    std::string dataDir_;
+    std::map<std::string, DataType> paramTypes_;
+
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Instance>> idle_;
+};
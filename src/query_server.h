@@ -0,0 +1,338 @@
+#pragma once
+
+#include "executor.h"
+#include "prepared_plan.h"
+#include "result_cache.h"
+#include "shared_scan.h"
+#include "table_cache.h"
+#include "thread_pool.h"
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <istream>
+#include <mutex>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+    Long-running server mode. The server loads the catalog once, keeps parsed tables in a
+    TableCache (tables too big for it are read through shared scans) and answers JSON requests, one per line:
+
+        {"op": "Scan", ...}                    a bare plan
+        {"id": 7, "plan": {...}}               a plan with an id echoed back in the reply
+        {"cmd": "stats"}                       cache and query counters
+        {"cmd": "prepare", "name": "q", "plan": {...}}        parse and plan once
+        {"cmd": "execute", "name": "q", "params": {...}}      run a prepared plan
+        {"cmd": "deallocate", "name": "q"}                    forget a prepared plan
+
+    Every request gets exactly one JSON line back, holding the whole result. Requests are
+    executed concurrently on a thread pool, so replies may come back in a different order
+    than the requests were sent; use "id" to match them up.
+
+    A plan or execute request with "stream": N is answered in several lines instead, each
+    carrying the request's "id": {"columns": [...]} once the query has started, then
+    {"rows": [...]} with up to N rows at a time as the rows are produced, and last a line
+    with "ok", "row_count" and "elapsed_ms" (or "ok": false and "error"). Lines of
+    different streams may interleave. The reply without "stream" is still built in full
+    before it is written.
+
+    Identical plans over unchanged files are answered from the ResultCache without running
+    them; such replies carry "cached": true.
+*/
+struct ServerOptions {
+    size_t threads = 1;
+    size_t tableCacheBytes = size_t(1) << 30;
+    size_t resultCacheBytes = size_t(64) << 20;
+    std::string resultCacheDir; // Empty: results are only kept in memory
+};
+
+class QueryServer {
+public:
+    QueryServer(const std::string& dataDir, const ServerOptions& options)
+        : dataDir_(dataDir), tableCache_(options.tableCacheBytes),
+          resultCache_(options.resultCacheBytes, options.resultCacheDir), pool_(options.threads) {
+        catalog_.loadSchemas(dataDir_);
+        // A zero budget turns the cache off; every scan then goes through shared scans.
+        if (options.tableCacheBytes > 0) catalog_.setTableCache(&tableCache_);
+        catalog_.setSharedScanManager(&sharedScans_);
+    }
+
+    // Writes one reply line (without its newline); returns false once the client is gone.
+    using ReplySink = std::function<bool(const std::string&)>;
+
+    // Handles a single request line and writes its JSON reply, or the lines of a streamed
+    // reply, to send.
+    void handleRequest(const std::string& line, const ReplySink& send) {
+        json reply;
+        try {
+            json request = json::parse(line);
+            if (request.contains("id")) reply["id"] = request["id"];
+            size_t streamRows = 0;
+            if (request.contains("stream")) {
+                if (!request["stream"].is_number_unsigned() || request["stream"].get<size_t>() == 0) {
+                    throw std::runtime_error("\"stream\" must be a positive number of rows.");
+                }
+                streamRows = request["stream"].get<size_t>();
+            }
+
+            if (request.contains("cmd")) {
+                handleCommand(request, reply, streamRows, send);
+            } else {
+                const json& plan = request.contains("plan") ? request["plan"] : request;
+                if (streamRows > 0) streamPlan(plan, reply, streamRows, send);
+                else reply.update(runCached(plan, reply));
+                queriesServed_++;
+            }
+            reply["ok"] = true;
+        } catch (const std::exception& e) {
+            reply["ok"] = false;
+            reply["error"] = e.what();
+        }
+        send(reply.dump());
+    }
+
+
+    json stats() const {
+        json s;
+        s["queries_served"] = queriesServed_.load();
+        s["table_cache_hits"] = tableCache_.hits();
+        s["table_cache_misses"] = tableCache_.misses();
+        s["table_cache_bytes"] = tableCache_.usedBytes();
+        s["result_cache"] = resultCache_.stats();
+        return s;
+    }
+
+    // Line protocol over a pair of streams (stdin/stdout). Each request is handed to the
+    // thread pool and its reply is written as soon as it finishes.
+    void serveStream(std::istream& in, std::ostream& out) {
+        std::mutex outMutex;
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.empty()) continue;
+            pool_.submit([this, line, &out, &outMutex] {
+                handleRequest(line, [&out, &outMutex](const std::string& reply) {
+                    std::lock_guard<std::mutex> lock(outMutex);
+                    out << reply << std::endl;
+                    return true;
+                });
+            });
+        }
+        pool_.waitIdle();
+    }
+
+    // Same line protocol over a Unix domain socket. Each client connection is served by one
+    // pool thread, so up to numThreads clients are answered at the same time.
+    void serveSocket(const std::string& socketPath) {
+        int listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listenFd < 0) throw std::runtime_error("Could not create socket.");
+
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (socketPath.size() >= sizeof(addr.sun_path)) {
+            ::close(listenFd);
+            throw std::runtime_error("Socket path too long: " + socketPath);
+        }
+        std::strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+        ::unlink(socketPath.c_str());
+
+        if (::bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || ::listen(listenFd, 64) < 0) {
+            ::close(listenFd);
+            throw std::runtime_error("Could not listen on socket: " + socketPath);
+        }
+        std::cerr << "[Server] Listening on " << socketPath << std::endl;
+
+        while (true) {
+            int clientFd = ::accept(listenFd, nullptr, nullptr);
+            if (clientFd < 0) continue;
+            pool_.submit([this, clientFd] { serveClient(clientFd); });
+        }
+    }
+
+private:
+    void handleCommand(const json& request, json& reply, size_t streamRows, const ReplySink& send) {
+        std::string cmd = request["cmd"];
+        if (cmd == "stats") {
+            reply["stats"] = stats();
+        } else if (cmd == "prepare") {
+            std::string name = request["name"];
+            auto prepared = std::make_shared<PreparedPlan>(request["plan"], catalog_, dataDir_);
+            reply["prepared"] = name;
+            reply["params"] = json::object();
+            for (const auto& param : prepared->parameters()) {
+                reply["params"][param.first] = typeToString(param.second);
+            }
+            std::lock_guard<std::mutex> lock(preparedMutex_);
+            prepared_[name] = std::move(prepared);
+        } else if (cmd == "execute") {
+            std::shared_ptr<PreparedPlan> prepared = findPrepared(request["name"]);
+            json bindings = request.contains("params") ? request["params"] : json::object();
+            json result = runCached(prepared->plan(), reply, [&] { return prepared->execute(bindings); }, bindings.dump());
+            if (streamRows > 0) streamJsonResult(result, reply, streamRows, send);
+            else reply.update(std::move(result));
+            queriesServed_++;
+        } else if (cmd == "deallocate") {
+            std::lock_guard<std::mutex> lock(preparedMutex_);
+            prepared_.erase(request["name"].get<std::string>());
+        } else {
+            throw std::runtime_error("Unknown command: " + cmd);
+        }
+    }
+
+    std::shared_ptr<PreparedPlan> findPrepared(const std::string& name) {
+        std::lock_guard<std::mutex> lock(preparedMutex_);
+        auto it = prepared_.find(name);
+        if (it == prepared_.end()) throw std::runtime_error("No prepared plan named '" + name + "'.");
+        return it->second;
+    }
+
+    std::string resultCacheKey(const json& plan, const std::string& paramsKey) const {
+        return makeResultCacheKey(plan, dataDir_, catalog_) + "params " + paramsKey + "\n";
+    }
+
+    // Runs a plan and sends its rows as they are produced, streamRows at a time. The rows
+    // are still collected for the result cache when it is on.
+    void streamPlan(const json& plan, json& reply, size_t streamRows, const ReplySink& send) {
+        auto start = std::chrono::steady_clock::now();
+        std::string key;
+        if (resultCache_.enabled()) {
+            key = resultCacheKey(plan, "");
+            if (auto cached = resultCache_.lookup(key)) {
+                reply["cached"] = true;
+                json result = resultToJson(*cached);
+                result["elapsed_ms"] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                streamJsonResult(result, reply, streamRows, send);
+                return;
+            }
+        }
+
+        auto root = parsePlan(plan, catalog_, dataDir_);
+        root->open();
+        QueryResult result;
+        result.schema = root->getSchema();
+        json header = streamLine(reply);
+        header["columns"] = json::array();
+        for (const auto& col : result.schema.getColumns()) header["columns"].push_back(col.name);
+        sendOrAbort(send, header);
+
+        json chunk = streamLine(reply);
+        chunk["rows"] = json::array();
+        size_t rowCount = 0;
+        Tuple tuple;
+        while (root->next(tuple)) {
+            chunk["rows"].push_back(rowToJson(tuple));
+            rowCount++;
+            if (!key.empty()) result.rows.push_back(tuple);
+            if (chunk["rows"].size() == streamRows) {
+                sendOrAbort(send, chunk);
+                chunk["rows"] = json::array();
+            }
+        }
+        root->close();
+        if (!chunk["rows"].empty()) sendOrAbort(send, chunk);
+
+        result.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (!key.empty()) resultCache_.insert(key, result);
+        reply["row_count"] = rowCount;
+        reply["elapsed_ms"] = result.elapsedMs;
+    }
+
+    // Sends an already materialized result (see resultToJson) in the streamed form; the
+    // row count and time are left in reply for the last line.
+    static void streamJsonResult(json& result, json& reply, size_t streamRows, const ReplySink& send) {
+        json header = streamLine(reply);
+        header["columns"] = std::move(result["columns"]);
+        sendOrAbort(send, header);
+        const json& rows = result["rows"];
+        for (size_t begin = 0; begin < rows.size(); begin += streamRows) {
+            json chunk = streamLine(reply);
+            chunk["rows"] = json::array();
+            for (size_t i = begin; i < std::min(rows.size(), begin + streamRows); ++i) chunk["rows"].push_back(rows[i]);
+            sendOrAbort(send, chunk);
+        }
+        reply["row_count"] = result["row_count"];
+        reply["elapsed_ms"] = result["elapsed_ms"];
+    }
+
+    // The start of a streamed line: only the request's id; the rest of reply goes last.
+    static json streamLine(const json& reply) {
+        json line = json::object();
+        if (reply.contains("id")) line["id"] = reply["id"];
+        return line;
+    }
+
+    static void sendOrAbort(const ReplySink& send, const json& line) {
+        if (!send(line.dump())) throw std::runtime_error("Client disconnected.");
+    }
+
+    json runCached(const json& plan, json& reply) {
+        return runCached(plan, reply, [&] { return executePlan(plan, catalog_, dataDir_); }, "");
+    }
+
+    // Runs a query through the result cache when it is enabled. paramsKey distinguishes
+    // executions of one prepared plan with different bindings.
+    template <typename Run>
+    json runCached(const json& plan, json& reply, Run run, const std::string& paramsKey) {
+        if (!resultCache_.enabled()) {
+            return resultToJson(run());
+        }
+        auto start = std::chrono::steady_clock::now();
+        std::string key = resultCacheKey(plan, paramsKey);
+        if (auto cached = resultCache_.lookup(key)) {
+            cached->elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            reply["cached"] = true;
+            return resultToJson(*cached);
+        }
+        QueryResult result = run();
+        resultCache_.insert(key, result);
+        return resultToJson(result);
+    }
+
+    void serveClient(int fd) {
+        std::string buffer;
+        char chunk[4096];
+        while (true) {
+            ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0) break;
+            buffer.append(chunk, static_cast<size_t>(n));
+
+            size_t newline;
+            while ((newline = buffer.find('\n')) != std::string::npos) {
+                std::string line = buffer.substr(0, newline);
+                buffer.erase(0, newline + 1);
+                if (line.empty()) continue;
+                bool connected = true;
+                handleRequest(line, [fd, &connected](const std::string& reply) {
+                    connected = connected && sendAll(fd, reply + "\n");
+                    return connected;
+                });
+                if (!connected) {
+                    ::close(fd);
+                    return;
+                }
+            }
+        }
+        ::close(fd);
+    }
+
+    static bool sendAll(int fd, const std::string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) return false;
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    std::string dataDir_;
+    Catalog catalog_;
+    TableCache tableCache_;
+    ResultCache resultCache_;
+    SharedScanManager sharedScans_;
+    ThreadPool pool_;
+    std::atomic<size_t> queriesServed_{0};
+
+    std::mutex preparedMutex_;
+    std::unordered_map<std::string, std::shared_ptr<PreparedPlan>> prepared_;
+};
@@ -0,0 +1,247 @@
+#pragma once
+
+#include "executor.h"
+#include "serialize.h"
+#include "table_cache.h"
+#include <filesystem>
+#include <fstream>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+/*
+    Caches complete query results. The cache key is the normalized plan text plus the
+    version (mtime, size and a checksum of the first and last few KB) of every file the
+    plan scans, so editing a CSV automatically invalidates every result that read it.
+
+    Results are stored in the compact binary form from serialize.h under an LRU byte
+    budget. When a directory is given, results are also written there so they survive
+    a restart of the server.
+*/
+
+// Finds every table a plan scans by walking its JSON.
+inline void collectScannedTables(const json& planJson, std::set<std::string>& tables) {
+    if (planJson.is_object()) {
+        if (planJson.contains("op") && planJson["op"] == "Scan" && planJson.contains("table")) {
+            tables.insert(planJson["table"].get<std::string>());
+        }
+        for (const auto& item : planJson.items()) collectScannedTables(item.value(), tables);
+    } else if (planJson.is_array()) {
+        for (const auto& item : planJson) collectScannedTables(item, tables);
+    }
+}
+
+// Cheap content fingerprint: hashes the first and last 4KB of the file. Catches files
+// rewritten with the same size within the mtime resolution without reading all of it.
+inline uint64_t sampledFileChecksum(const std::string& path, std::uintmax_t size) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) throw std::runtime_error("Cannot open data file: " + path);
+    const size_t sample = 4096;
+    char buffer[sample];
+    file.read(buffer, sample);
+    uint64_t hash = fnv1a64(buffer, static_cast<size_t>(file.gcount()));
+    if (size > sample) {
+        file.clear();
+        file.seekg(static_cast<std::streamoff>(size - std::min<std::uintmax_t>(size, sample)));
+        file.read(buffer, sample);
+        hash = fnv1a64(buffer, static_cast<size_t>(file.gcount()), hash);
+    }
+    return hash;
+}
+
+// Builds the full cache key for a plan: normalized plan text followed by one line per
+// scanned file with its version. nlohmann::json keeps object keys sorted, so dump()
+// already normalizes key order and whitespace.
+// A partitioned table contributes one line per file, so adding, removing or changing any
+// of its files changes the key.
+inline std::string makeResultCacheKey(const json& planJson, const std::string& dataDir, const Catalog& catalog) {
+    std::ostringstream key;
+    key << planJson.dump() << "\n";
+    std::set<std::string> tables;
+    collectScannedTables(planJson, tables);
+    for (const auto& table : tables) {
+        std::vector<std::string> paths;
+        if (const PartitionSpec* spec = catalog.getPartitionSpec(table)) {
+            for (const auto& file : listPartitionFiles(*spec, catalog.getSchema(table), dataDir)) paths.push_back(file.path);
+        } else {
+            paths.push_back(resolveTableFile(dataDir + "/" + table));
+        }
+        for (const auto& path : paths) {
+            FileVersion version = getFileVersion(path);
+            key << path << " " << version.mtime.time_since_epoch().count() << " " << version.size
+                << " " << sampledFileChecksum(path, version.size) << "\n";
+        }
+    }
+    return key.str();
+}
+
+class ResultCache {
+public:
+    // A budget of 0 disables the in-memory cache; diskDir may be empty.
+    ResultCache(size_t budgetBytes, const std::string& diskDir = "")
+        : budgetBytes_(budgetBytes), diskDir_(diskDir) {
+        if (!diskDir_.empty()) std::filesystem::create_directories(diskDir_);
+    }
+
+    bool enabled() const { return budgetBytes_ > 0 || !diskDir_.empty(); }
+
+    std::optional<QueryResult> lookup(const std::string& key) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = index_.find(key);
+            if (it != index_.end()) {
+                lru_.splice(lru_.begin(), lru_, it->second); // Mark as most recently used
+                hits_++;
+                return decode(it->second->blob);
+            }
+        }
+        if (!diskDir_.empty()) {
+            std::string blob;
+            if (readFromDisk(key, blob)) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                hits_++;
+                diskHits_++;
+                insertLocked(key, blob);
+                return decode(blob);
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        misses_++;
+        return std::nullopt;
+    }
+
+    // Failing to persist the result to disk is logged and otherwise ignored: the query
+    // itself has already succeeded.
+    void insert(const std::string& key, const QueryResult& result) {
+        std::string blob = encode(result);
+        if (!diskDir_.empty()) {
+            try {
+                writeToDisk(key, blob);
+            } catch (const std::exception& e) {
+                std::cerr << "[ResultCache] Could not write a result to '" << diskDir_ << "': " << e.what() << std::endl;
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        insertLocked(key, blob);
+    }
+
+    json stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        json s;
+        s["hits"] = hits_;
+        s["misses"] = misses_;
+        s["disk_hits"] = diskHits_;
+        s["evictions"] = evictions_;
+        s["entries"] = index_.size();
+        s["bytes"] = usedBytes_;
+        return s;
+    }
+
+private:
+    struct Entry {
+        std::string key;
+        std::string blob;
+    };
+
+    static std::string encode(const QueryResult& result) {
+        std::string blob;
+        BinaryWriter writer(blob);
+        writer.writeSchema(result.schema);
+        writer.writeU64(result.rows.size());
+        for (const auto& row : result.rows) writer.writeTuple(row);
+        return blob;
+    }
+
+    static QueryResult decode(const std::string& blob) {
+        BinaryReader reader(blob);
+        QueryResult result;
+        result.schema = reader.readSchema();
+        uint64_t n = reader.readU64();
+        result.rows.resize(n);
+        for (auto& row : result.rows) reader.readTuple(row);
+        return result;
+    }
+
+    void insertLocked(const std::string& key, const std::string& blob) {
+        size_t bytes = key.size() + blob.size();
+        if (bytes > budgetBytes_) return; // Never fits; disk copy (if any) is still kept.
+        auto it = index_.find(key);
+        if (it != index_.end()) {
+            usedBytes_ -= it->second->key.size() + it->second->blob.size();
+            lru_.erase(it->second);
+            index_.erase(it);
+        }
+        lru_.push_front({key, blob});
+        index_[key] = lru_.begin();
+        usedBytes_ += bytes;
+        while (usedBytes_ > budgetBytes_ && !lru_.empty()) {
+            auto& victim = lru_.back();
+            usedBytes_ -= victim.key.size() + victim.blob.size();
+            index_.erase(victim.key);
+            lru_.pop_back();
+            evictions_++;
+        }
+    }
+
+    std::string diskPath(const std::string& key) const {
+        std::ostringstream name;
+        name << std::hex << fnv1a64(key.data(), key.size()) << ".qprc";
+        return (std::filesystem::path(diskDir_) / name.str()).string();
+    }
+
+    // On disk a result file holds the full key followed by the blob, so a hash
+    // collision is detected instead of returning someone else's result. A write that
+    // fails (e.g. a full disk) throws and leaves no file behind.
+    void writeToDisk(const std::string& key, const std::string& blob) {
+        std::string contents;
+        BinaryWriter writer(contents);
+        writer.writeString(key);
+        writer.writeString(blob);
+        std::string path = diskPath(key);
+        std::string tmpPath = path + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+        std::error_code ec;
+        {
+            std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+            out.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+            out.close();
+            if (!out) {
+                std::filesystem::remove(tmpPath, ec);
+                throw std::runtime_error("writing '" + tmpPath + "' failed");
+            }
+        }
+        std::filesystem::rename(tmpPath, path, ec); // Readers never see a half-written file.
+        if (ec) {
+            std::error_code ignored;
+            std::filesystem::remove(tmpPath, ignored);
+            throw std::runtime_error("renaming '" + tmpPath + "' failed: " + ec.message());
+        }
+    }
+
+    bool readFromDisk(const std::string& key, std::string& blob) const {
+        std::ifstream in(diskPath(key), std::ios::binary);
+        if (!in.is_open()) return false;
+        std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        try {
+            BinaryReader reader(contents);
+            if (reader.readString() != key) return false;
+            blob = reader.readString();
+            return true;
+        } catch (const std::exception&) {
+            return false; // Truncated or foreign file, treat as a miss.
+        }
+    }
+
+    size_t budgetBytes_;
+    std::string diskDir_;
+    mutable std::mutex mutex_;
+    std::list<Entry> lru_; // Most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+    size_t usedBytes_ = 0;
+    size_t hits_ = 0;
+    size_t misses_ = 0;
+    size_t diskHits_ = 0;
+    size_t evictions_ = 0;
+};
@@ -0,0 +1,176 @@
+#pragma once
+
+#include "csv_quotes.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+/*
+    Table sampling (the Sample plan node). Whether a row or block is in the sample depends
+    only on the seed and its position, never on timing or read order, so the same seed
+    always gives the same sample.
+
+    Block sampling of a plain CSV file does not read the skipped parts at all: the file is
+    split into byte ranges of kSampleBlockBytes and only the chosen ranges are read, each
+    producing the lines that start inside it (the last one is read past the range end to
+    finish it). Cached tables skip whole columnar blocks instead.
+*/
+
+// Whether item `index` is in a sample of the given fraction, for this seed.
+inline bool sampleKeep(uint64_t seed, uint64_t index, double fraction) {
+    // splitmix64 of (seed, index), turned into a uniform double in [0, 1).
+    uint64_t z = seed * 0x9e3779b97f4a7c15ULL + index + 0x632be59bd9b4e019ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= z >> 31;
+    return static_cast<double>(z >> 11) * (1.0 / 9007199254740992.0) < fraction;
+}
+
+// Reads the lines of the sampled byte ranges of a plain (uncompressed) CSV file. The
+// header line is read and dropped on open.
+class BlockSampleReader {
+public:
+    static constexpr size_t kSampleBlockBytes = size_t(64) << 10;
+
+    BlockSampleReader(const std::string& path, double fraction, uint64_t seed) : path_(path) {
+        fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0) throw std::runtime_error("Cannot open data file: " + path);
+        struct stat st;
+        if (fstat(fd_, &st) != 0) {
+            ::close(fd_);
+            throw std::runtime_error("Cannot stat data file: " + path);
+        }
+        fileSize_ = static_cast<uint64_t>(st.st_size);
+
+        // The data starts after the header line.
+        bufferStart_ = 0;
+        buffer_.clear();
+        size_t newline;
+        while ((newline = buffer_.find('\n')) == std::string::npos && readMore()) {}
+        dataStart_ = newline == std::string::npos ? fileSize_ : newline + 1;
+
+        uint64_t blocks = (fileSize_ - dataStart_ + kSampleBlockBytes - 1) / kSampleBlockBytes;
+        for (uint64_t b = 0; b < blocks; ++b) {
+            if (sampleKeep(seed, b, fraction)) sampled_.push_back(b);
+        }
+        totalBlocks_ = static_cast<size_t>(blocks);
+        buffer_.clear();
+        pos_ = 0;
+        blockEnd_ = 0;
+    }
+
+    ~BlockSampleReader() { ::close(fd_); }
+
+    BlockSampleReader(const BlockSampleReader&) = delete;
+    BlockSampleReader& operator=(const BlockSampleReader&) = delete;
+
+    size_t sampledBlocks() const { return sampled_.size(); }
+    size_t totalBlocks() const { return totalBlocks_; }
+
+    // Next line (without its '\n') starting inside a sampled range; false at the end.
+    // Like LineReader, a record with newlines inside quotes is returned whole.
+    bool getline(std::string& line) {
+        while (bufferStart_ + pos_ >= blockEnd_) {
+            if (nextBlock_ >= sampled_.size()) return false;
+            startBlock(sampled_[nextBlock_++]);
+        }
+        line.clear();
+        size_t lines = 0;
+        while (true) {
+            size_t newline;
+            while ((newline = buffer_.find('\n', pos_)) == std::string::npos && readMore()) {}
+            if (newline == std::string::npos) newline = buffer_.size(); // Last line without '\n'
+            line.append(buffer_, pos_, newline - pos_);
+            pos_ = newline + 1;
+            if (pos_ > buffer_.size() || !csvQuoteOpen(line)) return true; // Done, or end of file
+            if (++lines == kMaxCsvRecordLines) {
+                warnUnterminatedCsvRecord();
+                line.clear(); // A blank line, which the scan skips
+                return true;
+            }
+            line.push_back('\n');
+        }
+    }
+
+private:
+    // Reads byte range b, starting one byte early so that a line starting exactly at the
+    // range start is recognised; lines that began in the previous range are skipped.
+    void startBlock(uint64_t b) {
+        uint64_t start = dataStart_ + b * kSampleBlockBytes;
+        blockEnd_ = std::min<uint64_t>(start + kSampleBlockBytes, fileSize_);
+        bufferStart_ = b == 0 ? start : start - 1;
+        buffer_.clear();
+        readMore(static_cast<size_t>(blockEnd_ - bufferStart_));
+        pos_ = 0;
+        if (b == 0) return;
+        size_t newline = buffer_.find('\n');
+        if (newline == std::string::npos) {
+            // One line spans the whole range, so no line starts in it.
+            bufferStart_ = blockEnd_;
+            buffer_.clear();
+            return;
+        }
+        pos_ = newline + 1;
+        skipQuotedTails();
+    }
+
+    // A range may also start inside a quoted field with newlines that began in an earlier
+    // range. The quote state there is unknown without reading from the start of the file,
+    // so this guesses: a line that would leave the quoted field it started in, and whose
+    // first quote is followed by ',' or the line end, is the tail of a record and is skipped.
+    void skipQuotedTails() {
+        while (bufferStart_ + pos_ < blockEnd_) {
+            size_t newline;
+            while ((newline = buffer_.find('\n', pos_)) == std::string::npos && readMore()) {}
+            if (newline == std::string::npos) newline = buffer_.size();
+            const char* line = buffer_.data() + pos_;
+            size_t length = newline - pos_;
+            const char* quote = static_cast<const char*>(std::memchr(line, '"', length));
+            if (!quote || csv_detail::endsInsideQuotes(line, length, true)) return;
+            size_t after = static_cast<size_t>(quote - line) + 1;
+            if (after < length && line[after] != ',') return;
+            pos_ = newline + 1;
+        }
+    }
+
+    // Appends up to `wanted` more bytes of the file to the buffer; false at the end of the file.
+    bool readMore(size_t wanted = kLineTailBytes) {
+        uint64_t offset = bufferStart_ + buffer_.size();
+        if (offset >= fileSize_) return false;
+        size_t length = static_cast<size_t>(std::min<uint64_t>(wanted, fileSize_ - offset));
+        size_t old = buffer_.size();
+        buffer_.resize(old + length);
+        size_t got = 0;
+        while (got < length) {
+            ssize_t n = pread(fd_, &buffer_[old + got], length - got, static_cast<off_t>(offset + got));
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) throw std::runtime_error("Read error in " + path_ + ": " + std::strerror(errno));
+            if (n == 0) break;
+            got += static_cast<size_t>(n);
+        }
+        buffer_.resize(old + got);
+        return got > 0;
+    }
+
+    static constexpr size_t kLineTailBytes = 4096; // Read step while finishing a line
+
+    std::string path_;
+    int fd_ = -1;
+    uint64_t fileSize_ = 0;
+    uint64_t dataStart_ = 0;
+    size_t totalBlocks_ = 0;
+    std::vector<uint64_t> sampled_; // Range indexes in the sample, ascending
+    size_t nextBlock_ = 0;
+
+    std::string buffer_;       // File bytes from bufferStart_ on
+    uint64_t bufferStart_ = 0;
+    size_t pos_ = 0;           // Start of the next line within buffer_
+    uint64_t blockEnd_ = 0;    // Lines must start before this file offset
+};
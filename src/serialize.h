@@ -0,0 +1,120 @@
+#pragma once
+
+#include "types.h"
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+/*
+    A compact binary encoding for Values, Tuples and Schemas. Each value is written as a
+    one byte type tag followed by its payload in host byte order (ints and floats are 4
+    bytes, strings are a 4 byte length plus the characters, NULL has no payload). It is
+    only meant to be read back by this program, e.g. for cached query results or spilled
+    aggregation state.
+*/
+
+class BinaryWriter {
+public:
+    explicit BinaryWriter(std::string& out) : out_(out) {}
+
+    void writeU8(uint8_t v) { out_.push_back(static_cast<char>(v)); }
+    void writeU32(uint32_t v) { writeRaw(&v, sizeof(v)); }
+    void writeU64(uint64_t v) { writeRaw(&v, sizeof(v)); }
+    void writeF64(double v) { writeRaw(&v, sizeof(v)); }
+    void writeBytes(const void* data, size_t size) { writeRaw(data, size); } // No length prefix
+    void writeString(const std::string& s) {
+        writeU32(static_cast<uint32_t>(s.size()));
+        out_.append(s);
+    }
+
+    void writeValue(const Value& val) {
+        writeU8(static_cast<uint8_t>(val.index()));
+        if (auto* i = std::get_if<int>(&val)) writeRaw(i, sizeof(int));
+        else if (auto* f = std::get_if<float>(&val)) writeRaw(f, sizeof(float));
+        else if (auto* s = std::get_if<std::string>(&val)) writeString(*s);
+        else if (auto* b = std::get_if<bool>(&val)) writeU8(*b ? 1 : 0);
+        // NULL is just its tag.
+    }
+
+    void writeTuple(const Tuple& tuple) {
+        writeU32(static_cast<uint32_t>(tuple.size()));
+        for (const auto& val : tuple) writeValue(val);
+    }
+
+    void writeSchema(const Schema& schema) {
+        const auto& cols = schema.getColumns();
+        writeU32(static_cast<uint32_t>(cols.size()));
+        for (const auto& col : cols) {
+            writeString(col.name);
+            writeU8(static_cast<uint8_t>(col.type));
+        }
+    }
+
+private:
+    void writeRaw(const void* data, size_t size) { out_.append(static_cast<const char*>(data), size); }
+    std::string& out_;
+};
+
+class BinaryReader {
+public:
+    BinaryReader(const char* data, size_t size) : data_(data), size_(size) {}
+    explicit BinaryReader(const std::string& in) : BinaryReader(in.data(), in.size()) {}
+
+    bool atEnd() const { return pos_ >= size_; }
+
+    uint8_t readU8() { uint8_t v; readRaw(&v, sizeof(v)); return v; }
+    uint32_t readU32() { uint32_t v; readRaw(&v, sizeof(v)); return v; }
+    uint64_t readU64() { uint64_t v; readRaw(&v, sizeof(v)); return v; }
+    double readF64() { double v; readRaw(&v, sizeof(v)); return v; }
+    void readBytes(void* out, size_t size) { readRaw(out, size); }
+    std::string readString() {
+        uint32_t len = readU32();
+        need(len);
+        std::string s(data_ + pos_, len);
+        pos_ += len;
+        return s;
+    }
+
+    Value readValue() {
+        switch (readU8()) {
+            case 0: { int v; readRaw(&v, sizeof(v)); return v; }
+            case 1: { float v; readRaw(&v, sizeof(v)); return v; }
+            case 2: return readString();
+            case 3: return readU8() != 0;
+            case 4: return nullValue();
+        }
+        throw std::runtime_error("Corrupt binary data: unknown value tag.");
+    }
+
+    void readTuple(Tuple& tuple) {
+        uint32_t n = readU32();
+        tuple.clear();
+        tuple.reserve(n);
+        for (uint32_t i = 0; i < n; ++i) tuple.push_back(readValue());
+    }
+
+    Schema readSchema() {
+        Schema schema;
+        uint32_t n = readU32();
+        for (uint32_t i = 0; i < n; ++i) {
+            std::string name = readString();
+            schema.addColumn(name, static_cast<DataType>(readU8()));
+        }
+        return schema;
+    }
+
+private:
+    void need(size_t n) const {
+        if (pos_ + n > size_) throw std::runtime_error("Corrupt binary data: unexpected end of buffer.");
+    }
+    void readRaw(void* out, size_t n) {
+        need(n);
+        std::memcpy(out, data_ + pos_, n);
+        pos_ += n;
+    }
+
+    const char* data_;
+    size_t size_;
+    size_t pos_ = 0;
+};
@@ -0,0 +1,271 @@
+#pragma once
+
+#include "operator.h"
+#include "hash_table.h"
+#include <algorithm>
+#include <iterator>
+
+/*
+    DISTINCT and the set operations UNION [ALL], INTERSECT and EXCEPT. Rows are compared as
+    whole tuples, and (as in SQL) NULLs count as equal to each other here. Both inputs of a
+    set operation must have the same number of columns; the output takes the left schema.
+
+    UNION ALL just streams the left input and then the right one, keeping no state. The
+    others remove duplicates. By default ("method": "hash") this is done with a TupleSet,
+    the same flat open-addressing layout as the join hash table, and rows come out in input
+    order as soon as they are known to qualify. With "method": "sort" both inputs are read in
+    full, sorted and merged instead: no hash table, and the result comes out in sorted order.
+*/
+
+enum class SetOpKind { UNION, INTERSECT, EXCEPT };
+
+inline const char* setOpName(SetOpKind kind) {
+    switch (kind) {
+        case SetOpKind::UNION: return "Union";
+        case SetOpKind::INTERSECT: return "Intersect";
+        case SetOpKind::EXCEPT: return "Except";
+    }
+    return "?";
+}
+
+namespace set_detail {
+
+// Reads an input in full, sorted and without duplicates.
+inline std::vector<Tuple> readSortedDistinct(Operator& input) {
+    std::vector<Tuple> rows;
+    input.open();
+    Tuple tuple;
+    while (input.next(tuple)) rows.push_back(std::move(tuple));
+    input.close();
+    if (!std::is_sorted(rows.begin(), rows.end())) std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    return rows;
+}
+
+inline void checkCompatible(const Schema& left, const Schema& right, SetOpKind kind) {
+    if (left.getColumns().size() != right.getColumns().size()) {
+        throw std::runtime_error(std::string(setOpName(kind)) + " inputs have different column counts (" +
+                                 std::to_string(left.getColumns().size()) + " vs " +
+                                 std::to_string(right.getColumns().size()) + ").");
+    }
+    // The output column takes the left type, so STRING and BOOL only match themselves.
+    // INT and FLOAT may mix, as a Project reports any computed column as FLOAT.
+    auto family = [](DataType type) { return type == DataType::FLOAT ? DataType::INT : type; };
+    const auto leftColumns = left.getColumns();
+    const auto rightColumns = right.getColumns();
+    for (size_t i = 0; i < leftColumns.size(); ++i) {
+        if (family(leftColumns[i].type) != family(rightColumns[i].type)) {
+            throw std::runtime_error(std::string(setOpName(kind)) + " column " + std::to_string(i + 1) + " has type " +
+                                     typeToString(leftColumns[i].type) + " on the left ('" + leftColumns[i].name +
+                                     "') but " + typeToString(rightColumns[i].type) + " on the right ('" +
+                                     rightColumns[i].name + "').");
+        }
+    }
+}
+
+} // namespace set_detail
+
+// --- Distinct Operator ---
+class DistinctOperator : public Operator {
+public:
+    DistinctOperator(std::unique_ptr<Operator> input, bool useSort = false)
+        : input_(std::move(input)), useSort_(useSort) {}
+
+    void open() override {
+        seen_.clear();
+        sorted_.clear();
+        pos_ = 0;
+        if (useSort_) {
+            sorted_ = set_detail::readSortedDistinct(*input_);
+            std::cout << "[Distinct] Sorted input down to " << sorted_.size() << " distinct rows." << std::endl;
+            return;
+        }
+        input_->open();
+    }
+
+    bool next(Tuple& tuple) override {
+        if (useSort_) {
+            if (pos_ >= sorted_.size()) return false;
+            tuple = std::move(sorted_[pos_++]);
+            return true;
+        }
+        while (input_->next(tuple)) {
+            if (seen_.insert(tuple)) return true;
+        }
+        return false;
+    }
+
+    void close() override {
+        if (!useSort_) input_->close();
+        seen_.clear();
+        sorted_.clear();
+    }
+
+    const Schema& getSchema() const override { return input_->getSchema(); }
+    Operator* getInput() const { return input_.get(); }
+
+private:
+    std::unique_ptr<Operator> input_;
+    bool useSort_;
+    TupleSet seen_;
+    std::vector<Tuple> sorted_;
+    size_t pos_ = 0;
+};
+
+// --- Union All Operator ---
+// Concatenation of both inputs. Each input is opened only when it is reached and closed
+// as soon as it runs out, so nothing is buffered and the two sides are independent.
+class UnionAllOperator : public Operator {
+public:
+    UnionAllOperator(std::unique_ptr<Operator> left, std::unique_ptr<Operator> right)
+        : left_(std::move(left)), right_(std::move(right)) {
+        set_detail::checkCompatible(left_->getSchema(), right_->getSchema(), SetOpKind::UNION);
+    }
+
+    void open() override {
+        left_->open();
+        side_ = 0;
+    }
+
+    bool next(Tuple& tuple) override {
+        if (side_ == 0) {
+            if (left_->next(tuple)) return true;
+            left_->close();
+            right_->open();
+            side_ = 1;
+        }
+        if (side_ == 1) {
+            if (right_->next(tuple)) return true;
+            right_->close();
+            side_ = 2;
+        }
+        return false;
+    }
+
+    void close() override {
+        if (side_ == 0) left_->close();
+        if (side_ == 1) right_->close();
+        side_ = 2;
+    }
+
+    const Schema& getSchema() const override { return left_->getSchema(); }
+    Operator* getLeft() const { return left_.get(); }
+    Operator* getRight() const { return right_.get(); }
+
+private:
+    std::unique_ptr<Operator> left_;
+    std::unique_ptr<Operator> right_;
+    int side_ = 2; // 0 = reading left, 1 = reading right, 2 = done
+};
+
+// --- Set Operator (UNION / INTERSECT / EXCEPT) ---
+// Hash method: UNION streams both sides through one set of rows already returned.
+// INTERSECT and EXCEPT first load the right side into a set, then stream the left side,
+// checking each row against it and against the rows already returned.
+class SetOperator : public Operator {
+public:
+    SetOperator(std::unique_ptr<Operator> left, std::unique_ptr<Operator> right, SetOpKind kind, bool useSort = false)
+        : left_(std::move(left)), right_(std::move(right)), kind_(kind), useSort_(useSort) {
+        set_detail::checkCompatible(left_->getSchema(), right_->getSchema(), kind_);
+    }
+
+    void open() override {
+        emitted_.clear();
+        rightRows_.clear();
+        sorted_.clear();
+        pos_ = 0;
+        if (useSort_) {
+            mergeSorted();
+            return;
+        }
+        if (kind_ != SetOpKind::UNION) {
+            right_->open();
+            Tuple tuple;
+            while (right_->next(tuple)) rightRows_.insert(tuple);
+            right_->close();
+            std::cout << "[SetOp] " << setOpName(kind_) << " built a set of " << rightRows_.size()
+                      << " distinct right rows." << std::endl;
+        }
+        left_->open();
+        side_ = 0;
+    }
+
+    bool next(Tuple& tuple) override {
+        if (useSort_) {
+            if (pos_ >= sorted_.size()) return false;
+            tuple = std::move(sorted_[pos_++]);
+            return true;
+        }
+        if (side_ == 0) {
+            while (left_->next(tuple)) {
+                if (kind_ == SetOpKind::INTERSECT && !rightRows_.contains(tuple)) continue;
+                if (kind_ == SetOpKind::EXCEPT && rightRows_.contains(tuple)) continue;
+                if (emitted_.insert(tuple)) return true;
+            }
+            left_->close();
+            side_ = 2;
+            if (kind_ == SetOpKind::UNION) {
+                right_->open();
+                side_ = 1;
+            }
+        }
+        if (side_ == 1) {
+            while (right_->next(tuple)) {
+                if (emitted_.insert(tuple)) return true;
+            }
+            right_->close();
+            side_ = 2;
+        }
+        return false;
+    }
+
+    void close() override {
+        if (side_ == 0) left_->close();
+        if (side_ == 1) right_->close();
+        side_ = 2;
+        emitted_.clear();
+        rightRows_.clear();
+        sorted_.clear();
+    }
+
+    const Schema& getSchema() const override { return left_->getSchema(); }
+    Operator* getLeft() const { return left_.get(); }
+    Operator* getRight() const { return right_.get(); }
+    SetOpKind getKind() const { return kind_; }
+
+private:
+    // Sort method: both sides sorted and de-duplicated, then merged.
+    void mergeSorted() {
+        std::vector<Tuple> left = set_detail::readSortedDistinct(*left_);
+        std::vector<Tuple> right = set_detail::readSortedDistinct(*right_);
+        auto out = std::back_inserter(sorted_);
+        switch (kind_) {
+            case SetOpKind::UNION:
+                std::set_union(std::make_move_iterator(left.begin()), std::make_move_iterator(left.end()),
+                               std::make_move_iterator(right.begin()), std::make_move_iterator(right.end()), out);
+                break;
+            case SetOpKind::INTERSECT:
+                std::set_intersection(std::make_move_iterator(left.begin()), std::make_move_iterator(left.end()),
+                                      right.begin(), right.end(), out);
+                break;
+            case SetOpKind::EXCEPT:
+                std::set_difference(std::make_move_iterator(left.begin()), std::make_move_iterator(left.end()),
+                                    right.begin(), right.end(), out);
+                break;
+        }
+        std::cout << "[SetOp] " << setOpName(kind_) << " merged " << left.size() << " and " << right.size()
+                  << " sorted distinct rows into " << sorted_.size() << "." << std::endl;
+        side_ = 2;
+    }
+
+    std::unique_ptr<Operator> left_;
+    std::unique_ptr<Operator> right_;
+    SetOpKind kind_;
+    bool useSort_;
+
+    TupleSet emitted_;   // Rows already returned
+    TupleSet rightRows_; // INTERSECT / EXCEPT: distinct rows of the right input
+    std::vector<Tuple> sorted_;
+    size_t pos_ = 0;
+    int side_ = 2; // 0 = reading left, 1 = reading right (UNION), 2 = done
+};
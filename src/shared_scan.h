@@ -0,0 +1,269 @@
+#pragma once
+
+#include "csv.h"
+#include "line_reader.h"
+#include "table_cache.h"
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+/*
+    Shared (circular) scans. When several queries scan the same uncached file at the same
+    time, they attach to one SharedScan instead of each opening the file. A single producer
+    thread reads and parses the file in fixed-size blocks and publishes them into a small
+    window; every attached consumer reads the blocks from that window.
+
+    The scan is circular: when the producer reaches the end of the file it starts again at
+    the top, so a consumer that joins in the middle keeps going through the end, wraps
+    around and finishes once it has seen every block exactly once. A consumer that falls too
+    far behind the window does not hold the others back; the blocks it missed simply come
+    around again on the next pass.
+*/
+
+struct SharedBatch {
+    size_t blockIndex = 0; // Position of this block in the file (0, 1, 2, ...)
+    std::vector<Tuple> rows;
+};
+
+class SharedScan {
+public:
+    SharedScan(const std::string& path, const Schema& schema, const FileVersion& version,
+               size_t blockRows = 4096, size_t windowBlocks = 16)
+        : path_(path), schema_(schema), version_(version), blockRows_(blockRows), windowBlocks_(windowBlocks) {
+        file_.open(path_); // Throws if the file cannot be opened.
+        producer_ = std::thread([this] { produceLoop(); });
+    }
+
+    ~SharedScan() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        needData_.notify_all();
+        producer_.join();
+    }
+
+    const FileVersion& version() const { return version_; }
+
+    // Registers a new consumer. Returns false when the calling thread is already reading this
+    // scan (e.g. a self-join inside one query); that consumer would block itself, so the
+    // caller should fall back to a private scan.
+    bool attach(size_t& consumerId) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& entry : consumers_) {
+            if (entry.second.thread == std::this_thread::get_id()) return false;
+        }
+        consumerId = nextConsumerId_++;
+        Consumer& consumer = consumers_[consumerId];
+        consumer.thread = std::this_thread::get_id();
+        consumer.cursor = windowStart_; // Reuse whatever is still in the window.
+        needData_.notify_all();
+        return true;
+    }
+
+    void detach(size_t consumerId) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        consumers_.erase(consumerId);
+    }
+
+    // Returns the next block this consumer has not seen yet, or nullptr once it has seen
+    // the whole table.
+    std::shared_ptr<const SharedBatch> nextBatch(size_t consumerId) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        Consumer& consumer = consumers_.at(consumerId);
+        while (true) {
+            if (totalBlocksKnown_ && consumer.seenCount == totalBlocks_) return nullptr;
+            if (error_) std::rethrow_exception(error_);
+
+            // Blocks that already fell out of the window will come around again.
+            if (consumer.cursor < windowStart_) consumer.cursor = windowStart_;
+
+            if (consumer.cursor < nextSeq_) {
+                auto batch = window_[consumer.cursor - windowStart_];
+                consumer.cursor++;
+                if (batch->blockIndex >= consumer.seen.size()) consumer.seen.resize(batch->blockIndex + 1, false);
+                if (consumer.seen[batch->blockIndex]) continue;
+                consumer.seen[batch->blockIndex] = true;
+                consumer.seenCount++;
+                return batch;
+            }
+
+            // We are at the head of the scan: wake the producer and wait for the next block.
+            needData_.notify_all();
+            dataReady_.wait(lock);
+        }
+    }
+
+private:
+    struct Consumer {
+        std::thread::id thread;
+        uint64_t cursor = 0; // Sequence number of the next published block to look at
+        std::vector<bool> seen;
+        size_t seenCount = 0;
+    };
+
+    // The producer only runs while some consumer is close enough to the head of the scan
+    // to need a new block soon; otherwise it sleeps.
+    bool someoneNeedsData() const {
+        if (totalBlocksKnown_ && totalBlocks_ == 0) return false; // Empty table, nothing to produce.
+        for (const auto& entry : consumers_) {
+            const Consumer& c = entry.second;
+            bool finished = totalBlocksKnown_ && c.seenCount == totalBlocks_;
+            if (!finished && c.cursor + windowBlocks_ > nextSeq_) return true;
+        }
+        return false;
+    }
+
+    void produceLoop() {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                needData_.wait(lock, [this] { return stopping_ || someoneNeedsData(); });
+                if (stopping_) return;
+            }
+
+            auto batch = std::make_shared<SharedBatch>();
+            try {
+                readBlock(*batch);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                error_ = std::current_exception();
+                dataReady_.notify_all();
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (batch->rows.empty() && totalBlocksKnown_ && totalBlocks_ == 0) {
+                dataReady_.notify_all(); // Lets waiting consumers notice the table is empty.
+                continue;
+            }
+            window_.push_back(std::move(batch));
+            nextSeq_++;
+            while (window_.size() > windowBlocks_) {
+                window_.pop_front();
+                windowStart_++;
+            }
+            dataReady_.notify_all();
+        }
+    }
+
+    // Parses the next block of rows, wrapping around to the top of the file at the end.
+    void readBlock(SharedBatch& batch) {
+        if (!headerSkipped_) {
+            std::string header;
+            file_.getline(header);
+            headerSkipped_ = true;
+        }
+
+        std::string line;
+        Tuple tuple;
+        const auto& cols = schema_.getColumns();
+        while (batch.rows.size() < blockRows_) {
+            if (!file_.getline(line)) {
+                if (!batch.rows.empty()) break; // Publish the last, partial block first.
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (!totalBlocksKnown_) {
+                        totalBlocks_ = nextBlock_;
+                        totalBlocksKnown_ = true;
+                    }
+                    if (totalBlocks_ == 0) return;
+                }
+                // Wrap around to the first data row.
+                file_.rewind();
+                std::string header;
+                file_.getline(header);
+                nextBlock_ = 0;
+                continue;
+            }
+            if (parseCsvLine(line, cols, tuple)) {
+                batch.rows.push_back(tuple);
+            }
+        }
+        batch.blockIndex = nextBlock_++;
+    }
+
+    std::string path_;
+    Schema schema_;
+    FileVersion version_;
+    size_t blockRows_;
+    size_t windowBlocks_;
+
+    // Producer-only state.
+    LineReader file_;
+    bool headerSkipped_ = false;
+    size_t nextBlock_ = 0;
+
+    // Shared state, guarded by mutex_.
+    std::mutex mutex_;
+    std::condition_variable needData_;
+    std::condition_variable dataReady_;
+    std::deque<std::shared_ptr<const SharedBatch>> window_;
+    uint64_t windowStart_ = 0; // Sequence number of window_.front()
+    uint64_t nextSeq_ = 0;     // Sequence number the next published block will get
+    std::unordered_map<size_t, Consumer> consumers_;
+    size_t nextConsumerId_ = 0;
+    size_t totalBlocks_ = 0;
+    bool totalBlocksKnown_ = false;
+    bool stopping_ = false;
+    std::exception_ptr error_;
+
+    std::thread producer_;
+};
+
+// A consumer's handle on a SharedScan. Detaches automatically when destroyed.
+class SharedScanCursor {
+public:
+    SharedScanCursor(std::shared_ptr<SharedScan> scan, size_t consumerId)
+        : scan_(std::move(scan)), consumerId_(consumerId) {}
+    ~SharedScanCursor() { scan_->detach(consumerId_); }
+
+    SharedScanCursor(const SharedScanCursor&) = delete;
+    SharedScanCursor& operator=(const SharedScanCursor&) = delete;
+
+    std::shared_ptr<const SharedBatch> nextBatch() { return scan_->nextBatch(consumerId_); }
+
+private:
+    std::shared_ptr<SharedScan> scan_;
+    size_t consumerId_;
+};
+
+// Hands out cursors on one SharedScan per table file. The manager only keeps weak
+// references: a scan (and its producer thread) goes away when its last cursor is
+// destroyed, and the next query on the file starts a new one.
+class SharedScanManager {
+public:
+    // Returns a cursor on the shared scan of this file, or nullptr when the caller should do
+    // a private scan instead.
+    std::unique_ptr<SharedScanCursor> attach(const std::string& path, const Schema& schema) {
+        FileVersion version = getFileVersion(path);
+        std::shared_ptr<SharedScan> scan;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            // Forget the entries of finished scans.
+            for (auto it = scans_.begin(); it != scans_.end();) {
+                if (it->second.expired()) it = scans_.erase(it);
+                else ++it;
+            }
+            auto& slot = scans_[path];
+            scan = slot.lock();
+            if (!scan || scan->version() != version) {
+                // No scan of this file running, or the file changed: start a new circular
+                // scan. Consumers of the old one keep it alive until they finish.
+                scan = std::make_shared<SharedScan>(path, schema, version);
+                slot = scan;
+            }
+        }
+        size_t consumerId;
+        if (!scan->attach(consumerId)) return nullptr;
+        return std::make_unique<SharedScanCursor>(scan, consumerId);
+    }
+
+private:
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::weak_ptr<SharedScan>> scans_;
+};
@@ -0,0 +1,225 @@
+#pragma once
+
+#include "hash_table.h" // hashValue
+#include "serialize.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+/*
+    Fixed-size summaries behind the approximate aggregates. Both can be updated one value
+    at a time, merged with another sketch of the same kind (partial aggregates from another
+    thread or from a spill file) and written to and read back from a BinaryWriter. Their
+    memory does not grow with the number of values, only with the number of groups.
+
+    HyperLogLog (approx_count_distinct): 2^kPrecision one-byte registers. A value's hash
+    picks a register by its top bits, and the register keeps the largest count of leading
+    zeros seen in the remaining bits. The harmonic mean of the registers estimates the
+    number of distinct values with a standard error of about 1.04 / sqrt(2^kPrecision),
+    i.e. 1.6%, from a handful up to billions of values.
+
+    t-digest (approx_quantile): values are buffered and then merged into at most about
+    kCompression weighted centroids, kept sorted by mean. Centroids near the tails are kept
+    small (the arcsine scale function), so extreme quantiles like p99 stay accurate while
+    the middle is summarized more coarsely. A quantile is read off by interpolating between
+    neighbouring centroid means.
+*/
+
+class HyperLogLog {
+public:
+    static constexpr int kPrecision = 12;
+    static constexpr size_t kRegisters = size_t(1) << kPrecision;
+
+    HyperLogLog() : registers_(kRegisters, 0) {}
+
+    void add(const Value& val) {
+        uint64_t h = hashValue(val);
+        size_t index = static_cast<size_t>(h >> (64 - kPrecision));
+        uint64_t rest = h << kPrecision;
+        uint8_t rank = rest == 0 ? static_cast<uint8_t>(64 - kPrecision + 1) : static_cast<uint8_t>(__builtin_clzll(rest) + 1);
+        if (rank > registers_[index]) registers_[index] = rank;
+    }
+
+    void merge(const HyperLogLog& other) {
+        for (size_t i = 0; i < kRegisters; ++i) registers_[i] = std::max(registers_[i], other.registers_[i]);
+    }
+
+    // Ertl's improved estimator ("New cardinality estimation algorithms for HyperLogLog
+    // sketches", 2017): works from the histogram of register values and, unlike the
+    // classic formula, needs no switch to linear counting or bias tables for small counts.
+    uint64_t estimate() const {
+        constexpr int q = 64 - kPrecision;
+        const double m = static_cast<double>(kRegisters);
+        int histogram[q + 2] = {0};
+        for (uint8_t r : registers_) histogram[r]++;
+        double z = m * tau(1.0 - histogram[q + 1] / m);
+        for (int k = q; k >= 1; --k) z = 0.5 * (z + histogram[k]);
+        z += m * sigma(histogram[0] / m);
+        return static_cast<uint64_t>(m * m / (2.0 * std::log(2.0)) / z + 0.5);
+    }
+
+    void write(BinaryWriter& out) const { out.writeBytes(registers_.data(), registers_.size()); }
+    void read(BinaryReader& in) { in.readBytes(registers_.data(), registers_.size()); }
+
+    static constexpr size_t memoryBytes() { return sizeof(HyperLogLog) + kRegisters; }
+
+private:
+    static double sigma(double x) {
+        if (x == 1.0) return std::numeric_limits<double>::infinity();
+        double y = 1.0, z = x, previous;
+        do {
+            x *= x;
+            previous = z;
+            z += x * y;
+            y += y;
+        } while (z != previous);
+        return z;
+    }
+
+    static double tau(double x) {
+        if (x == 0.0 || x == 1.0) return 0.0;
+        double y = 1.0, z = 1.0 - x, previous;
+        do {
+            x = std::sqrt(x);
+            previous = z;
+            y *= 0.5;
+            z -= (1.0 - x) * (1.0 - x) * y;
+        } while (z != previous);
+        return z / 3.0;
+    }
+
+    std::vector<uint8_t> registers_;
+};
+
+class TDigest {
+public:
+    static constexpr double kCompression = 100.0;
+    static constexpr size_t kMaxCentroids = 2 * static_cast<size_t>(kCompression);
+    static constexpr size_t kBufferSize = 128; // Values added before they are merged in
+
+    TDigest() {
+        centroids_.reserve(kMaxCentroids);
+        buffer_.reserve(kBufferSize);
+    }
+
+    void add(double x) {
+        buffer_.push_back(x);
+        if (buffer_.size() >= kBufferSize) compress({});
+    }
+
+    void merge(const TDigest& other) {
+        std::vector<Centroid> incoming = other.centroids_;
+        for (double x : other.buffer_) incoming.push_back({x, 1.0});
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+        compress(std::move(incoming));
+    }
+
+    bool empty() const { return centroids_.empty() && buffer_.empty(); }
+
+    // Estimated value at quantile q in [0, 1]; the digest must not be empty.
+    double quantile(double q) {
+        compress({});
+        double total = 0.0;
+        for (const auto& c : centroids_) total += c.weight;
+        double rank = std::clamp(q, 0.0, 1.0) * total;
+
+        // Each centroid's mean sits at the middle of its weight; the minimum and maximum
+        // anchor both ends.
+        double prevRank = 0.0, prevValue = min_;
+        double seen = 0.0;
+        for (const auto& c : centroids_) {
+            double center = seen + c.weight / 2.0;
+            if (rank <= center) return interpolate(prevRank, prevValue, center, c.mean, rank);
+            prevRank = center;
+            prevValue = c.mean;
+            seen += c.weight;
+        }
+        return interpolate(prevRank, prevValue, total, max_, rank);
+    }
+
+    void write(BinaryWriter& out) const {
+        out.writeU32(static_cast<uint32_t>(centroids_.size()));
+        for (const auto& c : centroids_) {
+            out.writeF64(c.mean);
+            out.writeF64(c.weight);
+        }
+        out.writeU32(static_cast<uint32_t>(buffer_.size()));
+        for (double x : buffer_) out.writeF64(x);
+        out.writeF64(min_);
+        out.writeF64(max_);
+    }
+
+    void read(BinaryReader& in) {
+        centroids_.resize(in.readU32());
+        if (centroids_.size() > kMaxCentroids) throw std::runtime_error("Corrupt t-digest: too many centroids.");
+        for (auto& c : centroids_) {
+            c.mean = in.readF64();
+            c.weight = in.readF64();
+        }
+        buffer_.resize(in.readU32());
+        if (buffer_.size() > kBufferSize) throw std::runtime_error("Corrupt t-digest: buffer too large.");
+        for (double& x : buffer_) x = in.readF64();
+        min_ = in.readF64();
+        max_ = in.readF64();
+    }
+
+    static constexpr size_t memoryBytes() {
+        return sizeof(TDigest) + kMaxCentroids * sizeof(double) * 2 + kBufferSize * sizeof(double);
+    }
+
+private:
+    struct Centroid {
+        double mean;
+        double weight;
+    };
+
+    static double interpolate(double r0, double v0, double r1, double v1, double rank) {
+        if (r1 <= r0) return v1;
+        return v0 + (v1 - v0) * (rank - r0) / (r1 - r0);
+    }
+
+    // Scale function: centroids may only span one unit of k, which is finer near q = 0 and 1.
+    static double scale(double q) { return kCompression / (2.0 * M_PI) * std::asin(2.0 * q - 1.0); }
+
+    // Merges the buffer and the given centroids into the existing centroids.
+    void compress(std::vector<Centroid> incoming) {
+        if (buffer_.empty() && incoming.empty()) return;
+        for (double x : buffer_) incoming.push_back({x, 1.0});
+        buffer_.clear();
+        for (const auto& c : incoming) {
+            min_ = std::min(min_, c.mean);
+            max_ = std::max(max_, c.mean);
+        }
+        incoming.insert(incoming.end(), centroids_.begin(), centroids_.end());
+        std::sort(incoming.begin(), incoming.end(), [](const Centroid& a, const Centroid& b) { return a.mean < b.mean; });
+
+        double total = 0.0;
+        for (const auto& c : incoming) total += c.weight;
+
+        centroids_.clear();
+        Centroid current = incoming[0];
+        double before = 0.0; // Weight of the centroids already emitted
+        double kLeft = scale(0.0);
+        for (size_t i = 1; i < incoming.size(); ++i) {
+            const Centroid& c = incoming[i];
+            double qRight = std::min(1.0, (before + current.weight + c.weight) / total);
+            if (scale(qRight) - kLeft <= 1.0) {
+                current.weight += c.weight;
+                current.mean += (c.mean - current.mean) * c.weight / current.weight;
+                continue;
+            }
+            centroids_.push_back(current);
+            before += current.weight;
+            kLeft = scale(before / total);
+            current = c;
+        }
+        centroids_.push_back(current);
+    }
+
+    std::vector<Centroid> centroids_; // Sorted by mean
+    std::vector<double> buffer_;
+    double min_ = std::numeric_limits<double>::infinity();
+    double max_ = -std::numeric_limits<double>::infinity();
+};
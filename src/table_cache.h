@@ -0,0 +1,171 @@
+#pragma once
+
+#include "columnar.h"
+#include "csv.h"
+#include "line_reader.h"
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+/*
+    Keeps parsed tables resident in memory between queries. A table is loaded from its
+    CSV file into a ColumnarTable the first time a scan asks for it and is reused until
+    the file on disk changes (different mtime or size) or it is evicted to stay within
+    the memory budget. This is what makes the server and batch modes fast: only the
+    first query over a table pays for the file read and parse.
+*/
+
+// Identifies one version of a file on disk.
+struct FileVersion {
+    std::filesystem::file_time_type mtime;
+    std::uintmax_t size = 0;
+
+    bool operator==(const FileVersion& other) const { return mtime == other.mtime && size == other.size; }
+    bool operator!=(const FileVersion& other) const { return !(*this == other); }
+};
+
+inline FileVersion getFileVersion(const std::string& path) {
+    FileVersion version;
+    version.mtime = std::filesystem::last_write_time(path);
+    version.size = std::filesystem::file_size(path);
+    return version;
+}
+
+// Reads a whole CSV file into a ColumnarTable using the catalog schema.
+inline std::shared_ptr<ColumnarTable> loadColumnarTable(const std::string& path, const Schema& schema) {
+    LineReader file(path); // Throws if the file cannot be opened.
+    auto table = std::make_shared<ColumnarTable>(schema);
+    const auto& cols = schema.getColumns();
+
+    std::string line;
+    file.getline(line); // Skip the header row.
+    Tuple tuple;
+    while (file.getline(line)) {
+        if (parseCsvLine(line, cols, tuple)) {
+            table->appendRow(tuple);
+        }
+    }
+    table->finalize();
+    return table;
+}
+
+class TableCache {
+public:
+    explicit TableCache(size_t budgetBytes = size_t(1) << 30) : budgetBytes_(budgetBytes) {}
+
+    // Returns the cached table for a file, loading it if needed. Returns nullptr when the
+    // table does not fit in the budget; the caller should then scan the file directly.
+    // Concurrent callers asking for the same table wait on a single load. A load that
+    // finishes after the file changed again still answers its own callers, but leaves the
+    // entry of the newer version alone.
+    std::shared_ptr<const ColumnarTable> get(const std::string& path, const Schema& schema) {
+        FileVersion version = getFileVersion(path);
+        std::promise<std::shared_ptr<const ColumnarTable>> promise;
+        uint64_t generation;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            auto it = entries_.find(path);
+            if (it != entries_.end() && it->second.version == version) {
+                it->second.lastUse = ++clock_;
+                hits_++;
+                auto future = it->second.table;
+                // Wait for the load (if it is still running) outside the lock.
+                lock.unlock();
+                return future.get();
+            }
+            if (it != entries_.end()) {
+                // The file changed on disk, forget the stale copy.
+                usedBytes_ -= it->second.bytes;
+                entries_.erase(it);
+            }
+            misses_++;
+            Entry entry;
+            entry.version = version;
+            entry.table = promise.get_future().share();
+            entry.lastUse = ++clock_;
+            entry.generation = generation = ++generations_;
+            entries_.emplace(path, std::move(entry));
+        }
+
+        std::shared_ptr<const ColumnarTable> table;
+        try {
+            table = loadColumnarTable(path, schema);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (ownEntry(path, generation)) entries_.erase(path);
+            promise.set_exception(std::current_exception());
+            throw;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        Entry* entry = ownEntry(path, generation);
+        size_t bytes = table->memoryBytes();
+        if (bytes > budgetBytes_) {
+            std::cerr << "[TableCache] '" << path << "' (" << bytes << " bytes) exceeds the cache budget, not caching." << std::endl;
+            // Keep the empty entry so later scans of this version skip straight to the file.
+            if (entry) entry->loaded = true;
+            promise.set_value(nullptr);
+            return nullptr;
+        }
+        if (!entry) {
+            // The file changed while it was being parsed; the entry belongs to a newer load.
+            std::cerr << "[TableCache] '" << path << "' changed while loading, not caching this version." << std::endl;
+            promise.set_value(table);
+            return table;
+        }
+        std::cerr << "[TableCache] Cached '" << path << "': " << table->rowCount() << " rows in " << bytes << " bytes." << std::endl;
+        entry->bytes = bytes;
+        entry->loaded = true;
+        usedBytes_ += bytes;
+        evictUntilWithinBudget(path);
+        promise.set_value(table);
+        return table;
+    }
+
+    size_t hits() const { std::lock_guard<std::mutex> lock(mutex_); return hits_; }
+    size_t misses() const { std::lock_guard<std::mutex> lock(mutex_); return misses_; }
+    size_t usedBytes() const { std::lock_guard<std::mutex> lock(mutex_); return usedBytes_; }
+
+private:
+    struct Entry {
+        FileVersion version;
+        std::shared_future<std::shared_ptr<const ColumnarTable>> table;
+        size_t bytes = 0;
+        uint64_t lastUse = 0;
+        bool loaded = false; // False while the first scan is still parsing the file
+        uint64_t generation = 0; // Tells the load that created the entry from later ones
+    };
+
+    // The entry for path if it is still the one created by the given load.
+    Entry* ownEntry(const std::string& path, uint64_t generation) {
+        auto it = entries_.find(path);
+        return it != entries_.end() && it->second.generation == generation ? &it->second : nullptr;
+    }
+
+    // Drops the least recently used tables (never the one just loaded) until we fit.
+    void evictUntilWithinBudget(const std::string& keep) {
+        while (usedBytes_ > budgetBytes_) {
+            auto victim = entries_.end();
+            for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+                if (it->first == keep || !it->second.loaded || it->second.bytes == 0) continue; // Skip ourselves, loads in flight and oversized markers
+                if (victim == entries_.end() || it->second.lastUse < victim->second.lastUse) victim = it;
+            }
+            if (victim == entries_.end()) return;
+            std::cerr << "[TableCache] Evicting '" << victim->first << "'." << std::endl;
+            usedBytes_ -= victim->second.bytes;
+            entries_.erase(victim);
+        }
+    }
+
+    size_t budgetBytes_;
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+    size_t usedBytes_ = 0;
+    uint64_t clock_ = 0;
+    uint64_t generations_ = 0;
+    size_t hits_ = 0;
+    size_t misses_ = 0;
+};
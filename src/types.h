@@ -5,12 +5,18 @@
 #include <variant>
 #include <unordered_map>
 #include <iostream>
+#include <type_traits>
 
 /*
     This file is basically for representing data in memory. This shows what a single value looks like as well as how rows and tables schema look as well.
 */
 
-using Value = std::variant<int, float, std::string, bool>;
+// std::monostate is SQL NULL. It comes last so the other alternatives keep their index
+// (serialized values and encodings depend on it).
+using Value = std::variant<int, float, std::string, bool, std::monostate>;
+
+inline Value nullValue() { return std::monostate{}; }
+inline bool isNull(const Value& val) { return std::holds_alternative<std::monostate>(val); }
 
 // A Tuple is just a list of Values
 using Tuple = std::vector<Value>;
@@ -76,14 +82,20 @@ private:
 
 // ADD THIS TO THE END OF src/types.h
 
-// Helper function to print a single Value variant.
-inline void printValue(const Value& val) {
+// Writes a single Value variant as text; NULL is written as "NULL".
+inline void writeValue(std::ostream& out, const Value& val) {
     // std::visit is a clean way to handle all types in a variant.
-    std::visit([](auto&& arg) {
-        std::cout << arg;
+    std::visit([&out](auto&& arg) {
+        if constexpr (std::is_same_v<std::decay_t<decltype(arg)>, std::monostate>) out << "NULL";
+        else out << arg;
     }, val);
 }
 
+// Helper function to print a single Value variant.
+inline void printValue(const Value& val) {
+    writeValue(std::cout, val);
+}
+
 // Helper function to print a whole tuple using its schema to label the columns.
 inline void printTuple(const Tuple& tuple, const Schema& schema) {
     const auto& cols = schema.getColumns();
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "columnar.h"
+#include "expression.h"
+
+/*
+    Zone maps. Every cached table records min/max (and null count) per column for each
+    block of kZoneBlockRows rows. A Select predicate of the form "column <op> constant"
+    sitting directly on top of a scan is handed to the scan as a ZonePredicate; before
+    reading a block, the scan checks the block's min/max and skips the whole block when no
+    row in it can satisfy the predicate. The Select above still evaluates every row that is
+    read, so skipping only ever has to be conservative.
+*/
+
+struct ZonePredicate {
+    size_t column = 0;             // Index into the scan's schema
+    std::string op;                // EQ, NEQ, LT, LTE, GT, GTE with the column on the left
+    const Expression* constant = nullptr; // Constant or parameter, evaluated at open()
+};
+
+// Mirrors an operator for when the constant is on the left (5 < x becomes x > 5).
+inline std::string flipComparison(const std::string& op) {
+    if (op == "LT") return "GT";
+    if (op == "LTE") return "GTE";
+    if (op == "GT") return "LT";
+    if (op == "GTE") return "LTE";
+    return op; // EQ and NEQ are symmetric
+}
+
+// Recognizes "column <op> constant" (or "constant <op> column") over the given schema.
+inline bool extractZonePredicate(const Expression& expr, const Schema& schema, ZonePredicate& out) {
+    auto* binary = dynamic_cast<const BinaryExpression*>(&expr);
+    if (!binary) return false;
+    const std::string& op = binary->getOp();
+    if (op != "EQ" && op != "NEQ" && op != "LT" && op != "LTE" && op != "GT" && op != "GTE") return false;
+
+    auto* leftCol = dynamic_cast<const ColumnRefExpression*>(&binary->getLeft());
+    auto* rightCol = dynamic_cast<const ColumnRefExpression*>(&binary->getRight());
+    const ColumnRefExpression* col = nullptr;
+    if (leftCol && binary->getRight().isConstant()) {
+        col = leftCol;
+        out.op = op;
+        out.constant = &binary->getRight();
+    } else if (rightCol && binary->getLeft().isConstant()) {
+        col = rightCol;
+        out.op = flipComparison(op);
+        out.constant = &binary->getLeft();
+    } else {
+        return false;
+    }
+
+    for (const auto& info : schema.getColumns()) {
+        if (info.name == col->getColumnName()) {
+            out.column = info.index;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Returns false only when no value in [zone.min, zone.max] can satisfy "value <op> c".
+// Follows BinaryExpression's rules: EQ/NEQ compare Values exactly, the ordering
+// comparisons compare numbers as doubles (anything else is left to the evaluator).
+inline bool zoneMayMatch(const ColumnStats& zone, const std::string& op, const Value& c) {
+    if (!zone.hasValues) return false; // Block has no non-null values at all.
+
+    if (op == "EQ" || op == "NEQ") {
+        if (zone.min.index() != c.index()) return true; // Mixed types, don't guess.
+        if (op == "EQ") return !(c < zone.min) && !(zone.max < c);
+        return !(zone.min == c && zone.max == c);
+    }
+
+    if (!is_numeric(zone.min) || !is_numeric(c)) return true;
+    double lo = to_double(zone.min);
+    double hi = to_double(zone.max);
+    double v = to_double(c);
+    if (op == "LT") return lo < v;
+    if (op == "LTE") return lo <= v;
+    if (op == "GT") return hi > v;
+    if (op == "GTE") return hi >= v;
+    return true;
+}
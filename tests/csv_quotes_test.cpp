@@ -0,0 +1,76 @@
+// Regression tests for quote handling in CSV records (src/csv_quotes.h) and the line
+// readers that glue records with newlines inside quotes back together.
+#include "csv.h"
+#include "line_reader.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(cond)                                                                   \
+    do {                                                                              \
+        if (!(cond)) {                                                                \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK failed: " #cond << std::endl; \
+            failures++;                                                               \
+        }                                                                             \
+    } while (0)
+
+static std::vector<std::string> fields(const std::string& line) {
+    std::vector<std::string> out;
+    forEachCsvField(line, [&](size_t begin, size_t end) {
+        bool quoted = end > begin && line[begin] == '"';
+        out.push_back(quoted ? unquoteCsvField(line.data() + begin, line.data() + end) : line.substr(begin, end - begin));
+        return true;
+    });
+    return out;
+}
+
+static std::vector<std::string> readRecords(const std::string& contents) {
+    std::string path = "csv_quotes_test.tmp.csv";
+    std::ofstream(path) << contents;
+    std::vector<std::string> records;
+    LineReader reader(path);
+    std::string line;
+    while (reader.getline(line)) records.push_back(line);
+    std::remove(path.c_str());
+    return records;
+}
+
+int main() {
+    // A quote in the middle of an unquoted field is a literal character.
+    CHECK(!csvQuoteOpen("2,Bo\"b,Canada,false,80.00"));
+    CHECK((fields("2,Bo\"b,Canada,false,80.00") == std::vector<std::string>{"2", "Bo\"b", "Canada", "false", "80.00"}));
+    CHECK((fields("1,x\"y,\"a,b\"") == std::vector<std::string>{"1", "x\"y", "a,b"}));
+
+    // Quoted fields, the "" escape, and a newline inside quotes.
+    CHECK((fields("\"Korea, Republic of\",\"say \"\"hi\"\"\",\"\"") == std::vector<std::string>{"Korea, Republic of", "say \"hi\"", ""}));
+    CHECK(csvQuoteOpen("1,\"two"));
+    CHECK(!csvQuoteOpen("1,\"two\nlines\",3"));
+    CHECK(!csvQuoteOpen("1,\"a\"\"\""));
+    CHECK(csvQuoteOpen("1,\"a\"\""));
+
+    // The same past the first 64-byte block.
+    std::string pad(70, 'x');
+    CHECK((fields(pad + ",a\"b," + pad) == std::vector<std::string>{pad, "a\"b", pad}));
+    CHECK((fields(pad + ",\"c," + pad + "\",d") == std::vector<std::string>{pad, "c," + pad, "d"}));
+
+    // A stray quote does not glue the following rows onto its record.
+    auto rows = readRecords("1,Al,USA,true,10.00\n2,Bo\"b,Canada,false,80.00\n3,Cy,USA,true,5.00\n"
+                            "4,\"Di\nna\",UK,true,1.00\n5,Ed,USA,false,2.00\n");
+    CHECK(rows.size() == 5);
+    if (rows.size() == 5) CHECK(rows[3] == "4,\"Di\nna\",UK,true,1.00");
+
+    // An unterminated quote is dropped after kMaxCsvRecordLines lines, not the whole file.
+    std::string contents = "1,\"open,USA\n";
+    for (size_t i = 0; i < kMaxCsvRecordLines + 20; ++i) contents += std::to_string(i + 2) + ",Ann,USA\n";
+    rows = readRecords(contents);
+    CHECK(rows.size() == 21); // The open line and the next kMaxCsvRecordLines - 1 are dropped
+    if (!rows.empty()) CHECK(rows.back() == std::to_string(kMaxCsvRecordLines + 21) + ",Ann,USA");
+
+    if (failures) std::cerr << failures << " check(s) failed" << std::endl;
+    else std::cout << "csv_quotes_test passed" << std::endl;
+    return failures ? 1 : 0;
+}